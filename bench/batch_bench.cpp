@@ -0,0 +1,110 @@
+// Compares evaluating an expression over columns of a million rows
+// with the batch evaluator against running the VM (or the JIT, where it
+// compiles the expression natively) once per row.
+// Build with CMAKE_BUILD_TYPE=Release.
+//
+//     batch_bench [rows] [expression over a, b, c, d]
+
+#include "mycomp/ast.hpp"
+#include "mycomp/batch.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/jit.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/vm.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+using namespace mycomp;
+
+namespace {
+
+template<typename F>
+double best_seconds(F&& f) {
+    double best = 1e100;
+    for(int i = 0; i < 3; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    std::string_view code = argc > 2 ? argv[2] : "a * b + c > d";
+
+    std::mt19937_64 rng(42);
+    std::vector<double> columns[4];
+    for(auto& column : columns) {
+        for(std::size_t i = 0; i < rows; i++)
+            column.push_back(double(rng() % 2000) / 100 - 10);
+    }
+    std::vector<Parameter> params{{"a", ValueType::REAL}, {"b", ValueType::REAL}, {"c", ValueType::REAL}, {"d", ValueType::REAL}};
+    std::vector<BatchColumn> batch_columns(std::begin(columns), std::end(columns));
+
+    AstArena arena;
+    auto expr = parse_expr(code, arena);
+    auto batch = batch_compile(*expr, params);
+    auto jit = jit_compile(*expr, params);
+    auto program = compile_expression(*expr, params);
+    if(batch.resultType() != ValueType::REAL && batch.resultType() != ValueType::BOOL) {
+        fmt::print(stderr, "The expression must be REAL or BOOL\n");
+        return 1;
+    }
+    bool real = batch.resultType() == ValueType::REAL;
+
+    // Results as doubles, so that they can be compared
+    std::vector<double> out_real(rows), expected(rows);
+    std::unique_ptr<bool[]> out_bool(new bool[rows]);
+    auto run_batch = [&] {
+        if(real)
+            batch(batch_columns, out_real);
+        else
+            batch(batch_columns, std::span(out_bool.get(), rows));
+    };
+
+    Vm vm;
+    std::vector<Slot> args(4);
+    auto run_rows = [&] {
+        for(std::size_t row = 0; row < rows; row++) {
+            for(std::size_t i = 0; i < 4; i++)
+                args[i].real = columns[i][row];
+            if(jit.isNative()) {
+                expected[row] = jit(args).real;
+            } else {
+                auto value = vm.run(program, args);
+                expected[row] = real ? std::get<double>(value) : std::get<bool>(value);
+            }
+        }
+    };
+
+    run_batch();
+    run_rows();
+    for(std::size_t row = 0; row < rows; row++) {
+        if((real ? out_real[row] : out_bool[row]) != expected[row]) {
+            fmt::print(stderr, "Batch and row results disagree!\n");
+            return 1;
+        }
+    }
+
+    auto batch_time = best_seconds(run_batch);
+    auto row_time = best_seconds(run_rows);
+    auto rows_per_ns = [&](double seconds) { return double(rows) / (seconds * 1e9); };
+    fmt::print("rows: {}, expression: {}, vectorized: {}\n", rows, code, batch.isVectorized());
+    fmt::print("{} per row: {:.3f} rows/ns\n", jit.isNative() ? "JIT" : "VM ", rows_per_ns(row_time));
+    fmt::print("batch:      {:.3f} rows/ns\n", rows_per_ns(batch_time));
+    fmt::print("speedup: {:.2f}x\n", row_time / batch_time);
+}
@@ -0,0 +1,383 @@
+// Throughput of the lexer and the AST on generated sources.
+// Build with CMAKE_BUILD_TYPE=Release and run e.g.
+//
+//     bench --sizes=1K,1M,64M --kinds=identifiers,comments --out=results.json
+//
+// Every measurement is the best of --repeat runs. The results are printed
+// and, with --out, written as JSON so that runs can be compared over time.
+
+#include "corpus.hpp"
+
+#include "mycomp/ast.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+#include "mycomp/lex.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/token_stream.hpp"
+
+#include <fmt/core.h>
+#include <fmt/os.h>
+
+#include <magic_enum.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::atomic<std::uint64_t> allocations{0};
+
+}
+
+// Counting every allocation of the process.
+// GCC cannot see that these are a matching pair and warns about free()
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* res = std::malloc(size == 0 ? 1 : size))
+        return res;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+using namespace mycomp;
+using namespace mycomp::bench;
+using enum AstNodeType;
+using enum TokenType;
+
+namespace {
+
+// Linux only: the peak resident set size can be reset through /proc/self/clear_refs
+void reset_peak_rss() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+std::size_t peak_rss_bytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+        if(line.starts_with("VmHWM:"))
+            return std::stoull(line.substr(6)) * 1024;
+    return 0;
+}
+
+struct Measurement {
+    double seconds = 1e100;
+    std::uint64_t allocations = 0;
+    std::size_t peak_rss = 0;
+};
+
+template<typename F>
+Measurement measure(int repeat, F&& f) {
+    Measurement res;
+    for(int i = 0; i < repeat; i++) {
+        reset_peak_rss();
+        auto allocs_before = allocations.load();
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        res.seconds = std::min(res.seconds, elapsed.count());
+        res.allocations = allocations.load() - allocs_before;
+        res.peak_rss = std::max(res.peak_rss, peak_rss_bytes());
+    }
+    return res;
+}
+
+
+// A tree with one node per token: every 64 tokens become the value of a declaration,
+// as a balanced tree of binary expressions over literals.
+struct AstFromTokens {
+    std::span<const Token> tokens;
+    AstArena* arena;
+
+    template<AstNodeType type>
+    auto node(AstNodeBody<type> body) {
+        return arena ? make_ast_node(*arena, std::move(body)) : make_ast_node(std::move(body));
+    }
+
+    ExprPtr expr(std::size_t begin, std::size_t end) {
+        if(end - begin == 1)
+            return node(AstNodeBody<LITERAL_EXPR>{.body = tokens[begin]});
+        auto mid = begin + (end - begin) / 2;
+        auto lhs = expr(begin, mid);
+        return node(AstNodeBody<BINARY_EXPR>{.op = Token{PLUS, 0, 0}, .lhs = std::move(lhs), .rhs = expr(mid, end)});
+    }
+
+    ModulePtr build(std::unique_ptr<AstArena> owned_arena) {
+        std::vector<DeclPtr> decls;
+        for(std::size_t begin = 0; begin < tokens.size(); begin += 64)
+            decls.push_back(node(AstNodeBody<VARIABLE_DECL>{
+                .name = Token{IDENTIFIER, 0, 0, std::string("decl")},
+                .type = nullptr,
+                .value = expr(begin, std::min(begin + 64, tokens.size()))
+            }));
+        return make_ast_node(AstNodeBody<MODULE>{.arena = std::move(owned_arena), .decls = std::move(decls)});
+    }
+};
+
+struct NodeCounter : StaticAstVisitor<NodeCounter> {
+    std::size_t nodes = 0;
+
+    template<AstNodeType type>
+    void visit(const AstNodeBody<type>& body) {
+        nodes++;
+        visitChildren(body);
+    }
+};
+
+
+struct Options {
+    std::vector<std::size_t> sizes = {1 << 10, 1 << 16, 1 << 20, 1 << 24};
+    std::vector<CorpusKind> kinds = {
+        CorpusKind::IDENTIFIERS, CorpusKind::NUMBERS, CorpusKind::COMMENTS, CorpusKind::STRINGS, CorpusKind::MIXED,
+        CorpusKind::PROGRAM
+    };
+    std::uint64_t seed = 1;
+    int repeat = 3;
+    std::size_t ast_max_size = std::size_t{1} << 26;
+    std::optional<std::string> out;
+};
+
+std::optional<std::size_t> parse_size(std::string_view str) {
+    std::size_t multiplier = 1;
+    if(!str.empty()) {
+        switch(str.back()) {
+        case 'K': multiplier = std::size_t{1} << 10; break;
+        case 'M': multiplier = std::size_t{1} << 20; break;
+        case 'G': multiplier = std::size_t{1} << 30; break;
+        default: break;
+        }
+        if(multiplier != 1)
+            str.remove_suffix(1);
+    }
+    std::size_t res = 0;
+    if(str.empty() || !std::ranges::all_of(str, [](char c) { return c >= '0' && c <= '9'; }))
+        return {};
+    for(char c : str)
+        res = res * 10 + static_cast<std::size_t>(c - '0');
+    return res * multiplier;
+}
+
+template<typename F>
+bool parse_list(std::string_view list, F&& parse_elem) {
+    while(!list.empty()) {
+        auto comma = list.find(',');
+        if(!parse_elem(list.substr(0, comma)))
+            return false;
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+    return true;
+}
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options res;
+    for(int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto eq = arg.find('=');
+        if(!arg.starts_with("--") || eq == std::string_view::npos)
+            return {};
+        auto key = arg.substr(2, eq - 2), value = arg.substr(eq + 1);
+
+        bool ok = true;
+        if(key == "sizes") {
+            res.sizes.clear();
+            ok = parse_list(value, [&](std::string_view elem) {
+                auto size = parse_size(elem);
+                if(size)
+                    res.sizes.push_back(*size);
+                return size.has_value();
+            });
+        } else if(key == "kinds") {
+            res.kinds.clear();
+            ok = parse_list(value, [&](std::string_view elem) {
+                auto kind = parse_corpus_kind(elem);
+                if(kind)
+                    res.kinds.push_back(*kind);
+                return kind.has_value();
+            });
+        } else if(key == "seed") {
+            auto seed = parse_size(value);
+            ok = seed.has_value();
+            res.seed = seed.value_or(0);
+        } else if(key == "repeat") {
+            auto repeat = parse_size(value);
+            ok = repeat.has_value() && *repeat > 0;
+            res.repeat = static_cast<int>(repeat.value_or(1));
+        } else if(key == "ast-max-size") {
+            auto size = parse_size(value);
+            ok = size.has_value();
+            res.ast_max_size = size.value_or(0);
+        } else if(key == "out") {
+            res.out = std::string(value);
+        } else {
+            ok = false;
+        }
+        if(!ok)
+            return {};
+    }
+    return res;
+}
+
+
+std::string lex_json(const Measurement& m, std::size_t bytes, std::size_t tokens) {
+    return fmt::format(
+        R"({{"seconds": {}, "bytes_per_second": {}, "tokens_per_second": {}, "allocations_per_token": {}, "peak_rss_bytes": {}}})",
+        m.seconds,
+        double(bytes) / m.seconds,
+        double(tokens) / m.seconds,
+        double(m.allocations) / double(std::max<std::size_t>(tokens, 1)),
+        m.peak_rss
+    );
+}
+
+std::string run_case(const Options& options, CorpusKind kind, std::size_t size) {
+    auto code = generate_corpus(kind, size, options.seed);
+    auto mb = double(code.size()) / double(1 << 20);
+
+    std::size_t tokens = 0;
+    auto next = measure(options.repeat, [&] {
+        tokens = 0;
+        Lexer lexer(code);
+        while(lexer.next())
+            tokens++;
+    });
+    auto vec = measure(options.repeat, [&] {
+        auto res = lex(code);
+        tokens = res.size();
+    });
+    auto compact = measure(options.repeat, [&] {
+        auto res = lex_compact(code);
+        tokens = res.size();
+    });
+    auto spans = measure(options.repeat, [&] {
+        auto res = lex_spans(code);
+        tokens = res.size();
+    });
+
+    fmt::print(
+        "{:>12} {:>10} bytes {:>9} tokens | next {:8.1f} MB/s {:5.2f} allocs/token | lex {:8.1f} MB/s"
+        " | lex_compact {:8.1f} MB/s | lex_spans {:8.1f} MB/s\n",
+        corpus_kind_name(kind), code.size(), tokens,
+        mb / next.seconds, double(next.allocations) / double(std::max<std::size_t>(tokens, 1)),
+        mb / vec.seconds, mb / compact.seconds, mb / spans.seconds
+    );
+
+    auto res = fmt::format(
+        R"({{"corpus": "{}", "bytes": {}, "tokens": {}, "next": {}, "lex": {}, "lex_compact": {}, "lex_spans": {})",
+        corpus_kind_name(kind), code.size(), tokens,
+        lex_json(next, code.size(), tokens),
+        lex_json(vec, code.size(), tokens),
+        lex_json(compact, code.size(), tokens),
+        lex_json(spans, code.size(), tokens)
+    );
+
+    if(kind == CorpusKind::PROGRAM) {
+        std::size_t nodes = 0;
+        auto parsed = measure(options.repeat, [&] {
+            auto module = parse(code);
+            NodeCounter counter;
+            counter.visitNode(*module);
+            nodes = counter.nodes;
+        });
+        fmt::print(
+            "{:>12} {:>10} nodes (parse) | parse {:8.1f} MB/s | {:4.2f}x the time of the next() loop\n",
+            "", nodes, mb / parsed.seconds, parsed.seconds / next.seconds
+        );
+        res += fmt::format(R"(, "parse": {{"nodes": {}, "lex": {}}})", nodes, lex_json(parsed, code.size(), tokens));
+    }
+
+    if(code.size() <= options.ast_max_size) {
+        auto token_vec = lex(code);
+        for(bool use_arena : {false, true}) {
+            Measurement build, visit, destroy;
+            std::size_t nodes = 0;
+            for(int i = 0; i < options.repeat; i++) {
+                ModulePtr module;
+                auto b = measure(1, [&] {
+                    auto arena = use_arena ? std::make_unique<AstArena>() : nullptr;
+                    AstFromTokens builder{.tokens = token_vec, .arena = arena.get()};
+                    module = builder.build(std::move(arena));
+                });
+                auto v = measure(1, [&] {
+                    NodeCounter counter;
+                    counter.visitNode(*module);
+                    nodes = counter.nodes;
+                });
+                auto d = measure(1, [&] {
+                    module.reset();
+                });
+                if(b.seconds < build.seconds) build = b;
+                if(v.seconds < visit.seconds) visit = v;
+                if(d.seconds < destroy.seconds) destroy = d;
+            }
+
+            fmt::print(
+                "{:>12} {:>10} nodes ({}) | build {:8.3f} ms | visit {:8.3f} ms | destroy {:8.3f} ms\n",
+                "", nodes, use_arena ? "arena" : "heap",
+                build.seconds * 1e3, visit.seconds * 1e3, destroy.seconds * 1e3
+            );
+            res += fmt::format(
+                R"(, "ast_{}": {{"nodes": {}, "build_seconds": {}, "build_allocations": {}, "visit_seconds": {}, "destroy_seconds": {}, "peak_rss_bytes": {}}})",
+                use_arena ? "arena" : "heap", nodes,
+                build.seconds, build.allocations, visit.seconds, destroy.seconds, build.peak_rss
+            );
+        }
+    }
+    return res + "}";
+}
+
+}
+
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+    if(!options) {
+        fmt::print(stderr,
+            "Usage: {} [--sizes=1K,1M,...] [--kinds=identifiers,numbers,comments,strings,mixed,program]\n"
+            "       [--seed=N] [--repeat=N] [--ast-max-size=64M] [--out=results.json]\n",
+            argv[0]
+        );
+        return 1;
+    }
+
+    std::vector<std::string> results;
+    for(auto kind : options->kinds)
+        for(auto size : options->sizes)
+            results.push_back(run_case(*options, kind, size));
+
+    if(options->out) {
+        auto out = fmt::output_file(*options->out);
+        out.print(R"({{"seed": {}, "repeat": {}, "results": [)", options->seed, options->repeat);
+        for(std::size_t i = 0; i < results.size(); i++)
+            out.print("{}\n    {}", i == 0 ? "" : ",", results[i]);
+        out.print("\n]}}\n");
+    }
+}
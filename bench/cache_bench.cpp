@@ -0,0 +1,73 @@
+// Compares a cold build of many small modules, which parses them and fills
+// the compile cache, with a warm one, which finds them all in the cache.
+// Build with CMAKE_BUILD_TYPE=Release.
+//
+//     cache_bench [modules] [bytes per module] [cache directory]
+
+#include "corpus.hpp"
+
+#include "mycomp/compile_cache.hpp"
+#include "mycomp/parser.hpp"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace mycomp;
+using namespace mycomp::bench;
+
+namespace {
+
+template<typename F>
+double seconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::size_t modules = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+    std::size_t size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8192;
+    std::filesystem::path dir = argc > 3 ? argv[3] : std::filesystem::temp_directory_path() / "mycomp_cache_bench";
+
+    std::vector<std::string> sources;
+    for(std::size_t i = 0; i < modules; i++)
+        sources.push_back(generate_corpus(CorpusKind::PROGRAM, size, i));
+    std::filesystem::remove_all(dir);
+
+    auto parsing = seconds([&] {
+        for(const auto& source : sources)
+            parse(source);
+    });
+    auto cold = seconds([&] {
+        CompileCache cache(dir, std::uint64_t(1) << 32);
+        for(const auto& source : sources)
+            cache.parse(source);
+    });
+    CompileCache cache(dir, std::uint64_t(1) << 32);
+    auto warm = seconds([&] {
+        for(const auto& source : sources)
+            cache.parse(source);
+    });
+    std::size_t nodes = 0;
+    auto in_place = seconds([&] {
+        for(const auto& source : sources)
+            nodes += cache.find(source)->ast().nodes().size();
+    });
+
+    fmt::print("{} modules of {} bytes, {} nodes\n", modules, size, nodes);
+    fmt::print("parse only:            {:8.1f} ms\n", parsing * 1e3);
+    fmt::print("cold (parse + store):  {:8.1f} ms\n", cold * 1e3);
+    fmt::print("warm (unflatten):      {:8.1f} ms\n", warm * 1e3);
+    fmt::print("warm (read in place):  {:8.1f} ms\n", in_place * 1e3);
+    std::filesystem::remove_all(dir);
+}
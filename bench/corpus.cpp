@@ -0,0 +1,205 @@
+#include "corpus.hpp"
+
+#include <fmt/core.h>
+#include <magic_enum.hpp>
+
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace mycomp::bench {
+
+namespace {
+
+struct Generator {
+    std::mt19937_64 rng;
+    std::string out;
+
+    std::size_t below(std::size_t n) {
+        return std::uniform_int_distribution<std::size_t>(0, n - 1)(rng);
+    }
+
+    void identifier() {
+        static constexpr std::array<std::string_view, 12> parts = {
+            "value", "count", "index", "buffer", "total", "node",
+            "left", "right", "offset", "size", "tmp", "result"
+        };
+        out += parts[below(parts.size())];
+        for(auto n = below(3); n > 0; n--) {
+            out += '_';
+            out += parts[below(parts.size())];
+        }
+        if(below(2))
+            out += fmt::format("{}", below(100));
+    }
+
+    void number() {
+        switch(below(4)) {
+        case 0:
+            out += fmt::format("{}", below(1000));
+            break;
+        case 1:
+            out += fmt::format("{}", rng() >> 8);
+            break;
+        case 2:
+            out += fmt::format("{}.{}", below(10000), below(1000));
+            break;
+        default:
+            out += fmt::format("{}.{}e-{}", 1 + below(9), below(100000), below(30));
+            break;
+        }
+    }
+
+    void string_literal(std::size_t length) {
+        static constexpr std::string_view alphabet = "abcdefghijklmnopqrstuvwxyz ,.;:!?0123456789";
+        out += '"';
+        for(std::size_t i = 0; i < length; i++)
+            out += alphabet[below(alphabet.size())];
+        out += '"';
+    }
+
+    void binary_op() {
+        static constexpr std::array<std::string_view, 8> ops = {" + ", " - ", " * ", " / ", " == ", " != ", " < ", " > "};
+        out += ops[below(ops.size())];
+    }
+
+    void identifier_line() {
+        out += "    var ";
+        identifier();
+        out += " = ";
+        for(auto n = 1 + below(5); n > 0; n--) {
+            identifier();
+            binary_op();
+        }
+        identifier();
+        out += ";\n";
+    }
+
+    void number_line() {
+        out += "    ";
+        for(int i = 0; i < 8; i++) {
+            number();
+            out += ", ";
+        }
+        number();
+        out += ";\n";
+    }
+
+    void comment_block() {
+        out += "/*****************************************************************\n";
+        for(auto n = 1 + below(6); n > 0; n--)
+            out += " * generated section, do not edit by hand. see the generator  *\n";
+        out += " *****************************************************************/\n";
+        for(auto n = below(4); n > 0; n--)
+            out += "// ---------------------------------------------------------------\n";
+        out += "            ";
+        identifier_line();
+    }
+
+    void expression(int depth) {
+        switch(depth == 0 ? below(2) : below(6)) {
+        case 0:
+            identifier();
+            break;
+        case 1:
+            number();
+            break;
+        case 2:
+        case 3:
+            out += '(';
+            expression(depth - 1);
+            binary_op();
+            expression(depth - 1);
+            out += ')';
+            break;
+        case 4:
+            out += "if ";
+            expression(depth - 1);
+            out += " {\n        var int ";
+            identifier();
+            out += " = ";
+            expression(depth - 1);
+            out += ";\n        ";
+            identifier();
+            out += " = ";
+            expression(depth - 1);
+            out += ";\n        ";
+            expression(depth - 1);
+            out += "\n    } else {\n        return ";
+            expression(depth - 1);
+            out += "\n    }";
+            break;
+        default:
+            out += below(2) ? "-" : "!";
+            expression(depth - 1);
+            break;
+        }
+    }
+
+    void program_decl() {
+        out += "var int ";
+        identifier();
+        out += " = ";
+        expression(4);
+        out += ";\n";
+    }
+
+    void string_line() {
+        out += "    var ";
+        identifier();
+        out += " = ";
+        string_literal(64 + below(1024));
+        out += ";\n";
+    }
+};
+
+}
+
+std::string generate_corpus(CorpusKind kind, std::size_t size, std::uint64_t seed) {
+    Generator gen{.rng = std::mt19937_64(seed), .out = {}};
+    gen.out.reserve(size + 2048);
+    while(gen.out.size() < size) {
+        auto line_kind = kind == CorpusKind::MIXED ? static_cast<CorpusKind>(gen.below(4)) : kind;
+        switch(line_kind) {
+        case CorpusKind::IDENTIFIERS:
+            gen.identifier_line();
+            break;
+        case CorpusKind::NUMBERS:
+            gen.number_line();
+            break;
+        case CorpusKind::COMMENTS:
+            gen.comment_block();
+            break;
+        case CorpusKind::STRINGS:
+            gen.string_line();
+            break;
+        case CorpusKind::PROGRAM:
+            gen.program_decl();
+            break;
+        case CorpusKind::MIXED:
+            break;
+        }
+    }
+    return std::move(gen.out);
+}
+
+std::string corpus_kind_name(CorpusKind kind) {
+    std::string res(magic_enum::enum_name(kind));
+    for(auto& c : res)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return res;
+}
+
+std::optional<CorpusKind> parse_corpus_kind(std::string_view name) {
+    for(auto kind : magic_enum::enum_values<CorpusKind>())
+        if(corpus_kind_name(kind) == name)
+            return kind;
+    return {};
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace mycomp::bench {
+
+enum class CorpusKind {
+    IDENTIFIERS, // declarations and expressions over long names
+    NUMBERS,     // data tables of natural and real numbers
+    COMMENTS,    // banners of line and block comments around sparse code
+    STRINGS,     // long string literals
+    MIXED,       // all of the above, interleaved
+    PROGRAM      // declarations with nested blocks and ifs, which also parse
+};
+
+// Deterministic: the same kind, size and seed always give the same bytes.
+// The result lexes without errors and is about `size` bytes long.
+std::string generate_corpus(CorpusKind kind, std::size_t size, std::uint64_t seed);
+
+// Lowercase names, as used on the command line and in the results
+std::string corpus_kind_name(CorpusKind kind);
+std::optional<CorpusKind> parse_corpus_kind(std::string_view name);
+
+}
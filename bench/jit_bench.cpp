@@ -0,0 +1,115 @@
+// Compares the JIT against the bytecode VM on a generated arithmetic
+// expression over four REAL or INT parameters, evaluated for many arguments.
+// Build with CMAKE_BUILD_TYPE=Release.
+//
+//     jit_bench [operators] [calls] [int]
+
+#include "mycomp/ast.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/jit.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/vm.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace mycomp;
+
+namespace {
+
+struct ExprGenerator {
+    std::mt19937_64 rng;
+    bool real;
+
+    // An expression with about `ops` operators. Reals are only divided
+    // by constants around 1, so that they stay finite.
+    std::string expr(int ops) {
+        if(ops == 0)
+            return rng() % 3 ? fmt::format("p{}", rng() % 4) : constant();
+        if(rng() % 8 == 0)
+            return fmt::format("-{}", expr(ops - 1));
+        auto lhs = static_cast<int>(rng() % static_cast<unsigned>(ops));
+        auto op = rng() % 3;
+        if(real && op == 2)
+            return fmt::format("({} / {})", expr(ops - 1), constant());
+        static constexpr const char* operators[] = {"+", "-", "*"};
+        return fmt::format("({} {} {})", expr(lhs), operators[op], expr(ops - 1 - lhs));
+    }
+
+    std::string constant() {
+        return real ? fmt::format("{}.{}", 1, rng() % 10) : fmt::format("{}", rng() % 10);
+    }
+};
+
+template<typename F>
+double best_seconds(int runs, F&& f) {
+    double best = 1e100;
+    for(int i = 0; i < 3; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for(int j = 0; j < runs; j++)
+            f(j);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best / runs;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int ops = argc > 1 ? std::atoi(argv[1]) : 40;
+    int calls = argc > 2 ? std::atoi(argv[2]) : 100000;
+    bool real = !(argc > 3 && std::strcmp(argv[3], "int") == 0);
+    auto type = real ? ValueType::REAL : ValueType::INT;
+
+    ExprGenerator gen{.rng = std::mt19937_64(42), .real = real};
+    auto code = gen.expr(ops);
+    std::vector<Parameter> params{{"p0", type}, {"p1", type}, {"p2", type}, {"p3", type}};
+
+    std::vector<Slot> args;
+    for(int i = 0; i < 4 * 1024; i++)
+        args.push_back(real ? Slot{.real = double(gen.rng() % 1000) / 500} : Slot{.integer = std::int64_t(gen.rng() % 1000)});
+    auto args_of = [&](int call) {
+        return std::span<const Slot>(args).subspan(static_cast<std::size_t>(call % 1024) * 4, 4);
+    };
+
+    AstArena arena;
+    auto expr = parse_expr(code, arena);
+    auto program = compile_expression(*expr, params);
+    auto compile_start = std::chrono::steady_clock::now();
+    auto function = jit_compile(*expr, params);
+    std::chrono::duration<double> compile_time = std::chrono::steady_clock::now() - compile_start;
+
+    Vm vm;
+    for(int i = 0; i < 1024; i++) {
+        auto expected = vm.run(program, args_of(i));
+        auto actual = function(args_of(i));
+        if(real ? Value(actual.real) != expected : Value(actual.integer) != expected) {
+            fmt::print(stderr, "JIT and VM disagree!\n");
+            return 1;
+        }
+    }
+
+    volatile std::int64_t sink = 0;
+    auto vm_time = best_seconds(calls, [&](int i) {
+        auto value = vm.run(program, args_of(i));
+        sink = sink + static_cast<std::int64_t>(value.index());
+    });
+    auto jit_time = best_seconds(calls, [&](int i) { sink = sink + function(args_of(i)).integer; });
+
+    fmt::print(
+        "operators: {}, instructions: {}, registers: {}, native: {}, jit compiled in {:.3f} ms\n",
+        ops, program.code.size(), program.register_count, function.isNative(), compile_time.count() * 1e3
+    );
+    fmt::print("bytecode VM: {:.1f} ns/call\n", vm_time * 1e9);
+    fmt::print("JIT:         {:.1f} ns/call\n", jit_time * 1e9);
+    fmt::print("speedup: {:.2f}x\n", vm_time / jit_time);
+}
@@ -0,0 +1,158 @@
+// Compares the virtual AstVisitor against StaticAstVisitor
+// on one large tree. Build with CMAKE_BUILD_TYPE=Release.
+
+#include "mycomp/ast.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+#include "mycomp/ast_visitor.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace mycomp;
+using enum AstNodeType;
+using enum TokenType;
+
+namespace {
+
+struct TreeBuilder {
+    AstArena& arena;
+    std::mt19937_64 rng;
+    std::size_t nodes = 0;
+
+    ExprPtr expr(int depth) {
+        nodes++;
+        if(depth == 0)
+            return make_ast_node(arena, AstNodeBody<LITERAL_EXPR>{.body = Token{NATURAL_NUMBER, 0, 0, rng() % 100}});
+        switch(rng() % 4) {
+        case 0:
+            return make_ast_node(arena, AstNodeBody<UNARY_EXPR>{.op = Token{MINUS, 0, 0}, .expr = expr(depth - 1)});
+        case 1: {
+            auto cond = expr(depth - 1);
+            auto on_true = expr(depth - 1);
+            return make_ast_node(arena, AstNodeBody<IF_EXPR>{
+                .cond = std::move(cond),
+                .on_true = std::move(on_true),
+                .on_false = expr(depth - 1)
+            });
+        }
+        default: {
+            auto lhs = expr(depth - 1);
+            return make_ast_node(arena, AstNodeBody<BINARY_EXPR>{.op = Token{PLUS, 0, 0}, .lhs = std::move(lhs), .rhs = expr(depth - 1)});
+        }
+        }
+    }
+};
+
+ModulePtr make_module(std::size_t decls, int depth, std::size_t& nodes) {
+    auto arena = std::make_unique<AstArena>();
+    TreeBuilder builder{.arena = *arena, .rng = std::mt19937_64(42)};
+    std::vector<DeclPtr> res;
+    for(std::size_t i = 0; i < decls; i++) {
+        builder.nodes++;
+        res.push_back(make_ast_node(*arena, AstNodeBody<VARIABLE_DECL>{
+            .name = Token{IDENTIFIER, 0, 0, std::string("x")},
+            .type = nullptr,
+            .value = builder.expr(depth)
+        }));
+    }
+    nodes = builder.nodes + 1;
+    return make_ast_node(AstNodeBody<MODULE>{.arena = std::move(arena), .decls = std::move(res)});
+}
+
+
+// Both visitors compute the same thing: the number of nodes and the sum of the literals
+
+struct VirtualSum : AstVisitor {
+    std::uint64_t nodes = 0, sum = 0;
+
+    template<typename Ptr>
+    void child(const Ptr& ptr) {
+        if(ptr)
+            ptr->acceptVisitor(*this);
+    }
+
+    void visit(const AstNodeBody<MODULE>& v) override { nodes++; for(auto& d : v.decls) child(d); }
+    void visit(const AstNodeBody<PRIMITIVE_TYPE>&) override { nodes++; }
+    void visit(const AstNodeBody<FUNCTION_DECL>& v) override { nodes++; child(v.type); }
+    void visit(const AstNodeBody<VARIABLE_DECL>& v) override { nodes++; child(v.type); child(v.value); }
+    void visit(const AstNodeBody<ASSIGNMENT_STMT>& v) override { nodes++; child(v.value); }
+    void visit(const AstNodeBody<EXPR_STMT>& v) override { nodes++; child(v.body); }
+    void visit(const AstNodeBody<UNARY_EXPR>& v) override { nodes++; child(v.expr); }
+    void visit(const AstNodeBody<BINARY_EXPR>& v) override { nodes++; child(v.lhs); child(v.rhs); }
+    void visit(const AstNodeBody<COMPOUND_EXPR>& v) override {
+        nodes++;
+        for(auto& e : v.preface)
+            std::visit([this](const auto& ptr) { child(ptr); }, e);
+        child(v.last);
+    }
+    void visit(const AstNodeBody<IF_EXPR>& v) override { nodes++; child(v.cond); child(v.on_true); child(v.on_false); }
+    void visit(const AstNodeBody<RETURN_EXPR>& v) override { nodes++; child(v.result); }
+    void visit(const AstNodeBody<LITERAL_EXPR>& v) override { nodes++; sum += std::get<std::uint64_t>(v.body.payload); }
+};
+
+struct StaticSum : StaticAstVisitor<StaticSum> {
+    std::uint64_t nodes = 0, sum = 0;
+
+    void visit(const AstNodeBody<LITERAL_EXPR>& v) {
+        nodes++;
+        sum += std::get<std::uint64_t>(v.body.payload);
+    }
+    template<AstNodeType type>
+    void visit(const AstNodeBody<type>& v) {
+        nodes++;
+        visitChildren(v);
+    }
+};
+
+template<typename F>
+double best_seconds(int runs, F&& f) {
+    double best = 1e100;
+    for(int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int depth = argc > 1 ? std::atoi(argv[1]) : 14;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    std::size_t nodes = 0;
+    auto module = make_module(64, depth, nodes);
+
+    VirtualSum virtual_sum;
+    auto virtual_time = best_seconds(runs, [&] {
+        virtual_sum = {};
+        module->acceptVisitor(virtual_sum);
+    });
+
+    StaticSum static_sum;
+    auto static_time = best_seconds(runs, [&] {
+        static_sum = {};
+        static_sum.visitNode(*module);
+    });
+
+    if(virtual_sum.nodes != nodes || static_sum.nodes != nodes || virtual_sum.sum != static_sum.sum) {
+        fmt::print(stderr, "Visitors disagree!\n");
+        return 1;
+    }
+
+    fmt::print("nodes: {}\n", nodes);
+    fmt::print("AstVisitor:       {:.3f} ms, {:.2f} ns/node\n", virtual_time * 1e3, virtual_time * 1e9 / double(nodes));
+    fmt::print("StaticAstVisitor: {:.3f} ms, {:.2f} ns/node\n", static_time * 1e3, static_time * 1e9 / double(nodes));
+    fmt::print("speedup: {:.2f}x\n", virtual_time / static_time);
+}
@@ -0,0 +1,256 @@
+// Compares the bytecode VM against a naive interpreter walking the AST,
+// on a generated program of integer and real arithmetic with branches.
+// The language has no loops yet, so the program is run many times instead.
+// Build with CMAKE_BUILD_TYPE=Release.
+//
+//     vm_bench [declarations] [runs]
+
+#include "mycomp/ast.hpp"
+#include "mycomp/ast_visitor.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/vm.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+using namespace mycomp;
+using enum AstNodeType;
+using enum TokenType;
+
+namespace {
+
+// What a first interpreter looks like: virtual calls for every node,
+// values as variants and variables looked up by name in a map per block
+struct TreeInterpreter : AstVisitor {
+    std::vector<std::unordered_map<std::string, Value>> scopes;
+    Value result;
+
+    // Thrown to unwind the tree on `return`
+    struct Return {
+        Value value;
+    };
+
+    Value run(const AstNodeBody<MODULE>& module) {
+        scopes.assign(1, {});
+        try {
+            visit(module);
+        } catch(Return& ret) {
+            return ret.value;
+        }
+        return {};
+    }
+
+    Value eval(const AstNode& node) {
+        node.acceptVisitor(*this);
+        return result;
+    }
+
+    Value& lookup(const Token& name) {
+        const auto& text = std::get<std::string>(name.payload);
+        for(auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+            if(auto found = it->find(text); found != it->end())
+                return found->second;
+        std::abort();
+    }
+
+    void visit(const AstNodeBody<MODULE>& v) override {
+        for(const auto& decl : v.decls)
+            decl->acceptVisitor(*this);
+    }
+    void visit(const AstNodeBody<PRIMITIVE_TYPE>&) override {}
+    void visit(const AstNodeBody<FUNCTION_DECL>&) override {}
+    void visit(const AstNodeBody<VARIABLE_DECL>& v) override {
+        auto value = eval(*v.value);
+        scopes.back()[std::get<std::string>(v.name.payload)] = value;
+    }
+    void visit(const AstNodeBody<ASSIGNMENT_STMT>& v) override {
+        lookup(v.var) = eval(*v.value);
+    }
+    void visit(const AstNodeBody<EXPR_STMT>& v) override {
+        eval(*v.body);
+    }
+    void visit(const AstNodeBody<UNARY_EXPR>& v) override {
+        auto value = eval(*v.expr);
+        if(auto* i = std::get_if<std::int64_t>(&value))
+            result = std::int64_t(0 - std::uint64_t(*i));
+        else if(auto* r = std::get_if<double>(&value))
+            result = -*r;
+        else
+            result = !std::get<bool>(value);
+    }
+    void visit(const AstNodeBody<BINARY_EXPR>& v) override {
+        auto lhs = eval(*v.lhs);
+        auto rhs = eval(*v.rhs);
+        auto op = v.op.tokenType;
+        result = std::visit([op](auto l, auto r) -> Value {
+            using T = decltype(l);
+            if constexpr (!std::is_same_v<T, decltype(r)> || std::is_same_v<T, std::monostate>) {
+                std::abort();
+            } else {
+                if(op == EQUALS)
+                    return l == r;
+                if(op == NOT_EQ)
+                    return l != r;
+                if constexpr (std::is_same_v<T, bool>) {
+                    std::abort();
+                } else {
+                    if(op == LESS_THAN)
+                        return l < r;
+                    if(op == GREATER_THAN)
+                        return l > r;
+                    if constexpr (std::is_same_v<T, std::int64_t>) {
+                        auto a = std::uint64_t(l), b = std::uint64_t(r);
+                        if(op == PLUS)
+                            return std::int64_t(a + b);
+                        if(op == MINUS)
+                            return std::int64_t(a - b);
+                        if(op == STAR)
+                            return std::int64_t(a * b);
+                        return r == -1 ? std::int64_t(0 - a) : l / r;
+                    } else {
+                        if(op == PLUS)
+                            return l + r;
+                        if(op == MINUS)
+                            return l - r;
+                        if(op == STAR)
+                            return l * r;
+                        return l / r;
+                    }
+                }
+            }
+        }, lhs, rhs);
+    }
+    void visit(const AstNodeBody<COMPOUND_EXPR>& v) override {
+        scopes.emplace_back();
+        for(const auto& elem : v.preface)
+            std::visit([this](const auto& ptr) { ptr->acceptVisitor(*this); }, elem);
+        result = v.last ? eval(*v.last) : Value();
+        scopes.pop_back();
+    }
+    void visit(const AstNodeBody<IF_EXPR>& v) override {
+        if(std::get<bool>(eval(*v.cond)))
+            result = eval(*v.on_true);
+        else
+            result = v.on_false ? eval(*v.on_false) : Value();
+    }
+    void visit(const AstNodeBody<RETURN_EXPR>& v) override {
+        throw Return{v.result ? eval(*v.result) : Value()};
+    }
+    void visit(const AstNodeBody<LITERAL_EXPR>& v) override {
+        const auto& tok = v.body;
+        if(tok.tokenType == IDENTIFIER)
+            result = lookup(tok);
+        else if(tok.tokenType == NATURAL_NUMBER)
+            result = std::int64_t(std::get<std::uint64_t>(tok.payload));
+        else if(tok.tokenType == REAL_NUMBER)
+            result = std::get<double>(tok.payload);
+        else
+            result = tok.tokenType == TRUE;
+    }
+};
+
+// Declarations of ints and reals, each computed from the previous ones
+// with a few arithmetic operators, an if and a block with an assignment
+struct ProgramGenerator {
+    std::mt19937_64 rng;
+    std::string out;
+    std::size_t ints = 0, reals = 0;
+
+    std::string var(bool real) {
+        auto count = real ? reals : ints;
+        if(count == 0)
+            return real ? "1.5" : "3";
+        return fmt::format("{}{}", real ? 'r' : 'i', rng() % std::min<std::size_t>(count, 16) + count - std::min<std::size_t>(count, 16));
+    }
+
+    std::string constant(bool real) {
+        return real ? fmt::format("{}.5", rng() % 10) : fmt::format("{}", rng() % 10);
+    }
+
+    // Reals are only multiplied by constants, so that they stay finite
+    std::string term(bool real) {
+        auto res = var(real);
+        for(auto n = 1 + rng() % 3; n > 0; n--) {
+            auto op = rng() % 3;
+            if(real && op == 2)
+                res += fmt::format(" * 0.{}", 1 + rng() % 9);
+            else
+                res += fmt::format(" {} {}", "+-*"[op], rng() % 3 == 0 ? constant(real) : var(real));
+        }
+        return res;
+    }
+
+    void decl(bool real) {
+        auto type = real ? "real" : "int";
+        auto name = fmt::format("{}{}", real ? 'r' : 'i', real ? reals : ints);
+        out += fmt::format(
+            "var {} {} = if {} < {} {{ var {} t = {}; t = t * {}; t - {} }} else {{ {} }};\n",
+            type, name, term(real), term(real), type, term(real), real ? "0.5" : var(real), var(real), term(real)
+        );
+        (real ? reals : ints)++;
+    }
+};
+
+template<typename F>
+double best_seconds(int runs, F&& f) {
+    double best = 1e100;
+    for(int i = 0; i < 3; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for(int j = 0; j < runs; j++)
+            f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best / runs;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int decls = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    ProgramGenerator gen{.rng = std::mt19937_64(42), .out = {}};
+    for(int i = 0; i < decls; i++)
+        gen.decl(i % 4 == 3);
+    gen.out += "var int result = { return i0 + i1 };\n";
+
+    auto module = parse(gen.out);
+    const auto& body = static_cast<const AstNodeConcrete<MODULE>&>(*module).body_;
+
+    auto compile_start = std::chrono::steady_clock::now();
+    auto program = compile(body);
+    std::chrono::duration<double> compile_time = std::chrono::steady_clock::now() - compile_start;
+
+    TreeInterpreter interpreter;
+    Vm vm;
+    bool agree = interpreter.run(body) == vm.run(program);
+    // The variables declared before the return
+    for(const auto& [name, value] : interpreter.scopes.front())
+        agree = agree && value == vm.variable(program, name);
+    if(!agree) {
+        fmt::print(stderr, "Interpreters disagree!\n");
+        return 1;
+    }
+
+    auto tree_time = best_seconds(runs, [&] { interpreter.run(body); });
+    auto vm_time = best_seconds(runs, [&] { vm.run(program); });
+
+    fmt::print(
+        "bytes: {}, instructions: {}, registers: {}, constants: {}, compiled in {:.3f} ms\n",
+        gen.out.size(), program.code.size(), program.register_count, program.constants.size(), compile_time.count() * 1e3
+    );
+    fmt::print("tree interpreter: {:.3f} us/run\n", tree_time * 1e6);
+    fmt::print("bytecode VM:      {:.3f} us/run\n", vm_time * 1e6);
+    fmt::print("speedup: {:.2f}x\n", tree_time / vm_time);
+}
@@ -1,11 +1,17 @@
 #pragma once
 
 #include "lex.hpp"
+#include "utils/apply_enum.hpp"
+#include "utils/arena.hpp"
 #include "utils/specialization_of.hpp"
 
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <new>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace mycomp {
 
@@ -34,6 +40,30 @@ struct AstVisitor;
 struct AstNode {
     virtual void acceptVisitor(AstVisitor& visitor) const = 0;
     virtual ~AstNode() = default;
+
+    // Known without a virtual call, see visit_ast_node in ast_static_visitor.hpp
+    AstNodeType type() const {
+        return type_;
+    }
+
+protected:
+    explicit AstNode(AstNodeType type) : type_(type) {}
+
+private:
+    AstNodeType type_;
+};
+
+// Nodes allocated in an AstArena are destroyed by the arena, not by their owners.
+// Whether a node is in an arena is kept in the pointer that owns it, not read
+// from the node: the arena destroys its nodes in any order, so a child may be
+// gone by the time its parent drops the pointer to it.
+struct AstDeleter {
+    bool in_arena = false;
+
+    void operator()(const AstNode* node) const {
+        if(!in_arena)
+            delete node;
+    }
 };
 
 template<AstNodeType>
@@ -50,10 +80,11 @@ enum class AstCategoryType {
 
 template<AstCategoryType type>
 struct AstCategory : AstNode {
+    using AstNode::AstNode;
 };
 
 template<AstCategoryType type>
-using AstPtr = std::unique_ptr<AstCategory<type>>;
+using AstPtr = std::unique_ptr<AstCategory<type>, AstDeleter>;
 
 using DeclPtr = AstPtr<AstCategoryType::DECLARATION>;
 using StmtPtr = AstPtr<AstCategoryType::STATEMENT>;
@@ -71,22 +102,87 @@ struct AstNodeConcrete :
     void acceptVisitor(AstVisitor& visitor) const final; // defined in ast_visitor.hpp
 
     AstNodeConcrete(AstNodeBody<type> body) :
+        AstCategory<AstNodeBody<type>::category>(type),
         body_(std::move(body))
     {}
 
     AstNodeBody<type> body_;
 };
 
+// The body of a node that is known to be of the type
+template<AstNodeType type>
+AstNodeBody<type>& body_of(AstNode& node) {
+    return static_cast<AstNodeConcrete<type>&>(node).body_;
+}
+
+template<AstNodeType type>
+const AstNodeBody<type>& body_of(const AstNode& node) {
+    return static_cast<const AstNodeConcrete<type>&>(node).body_;
+}
+
+// Bump allocates nodes and destroys all of them at once, when the arena dies.
+// Dropping an AstPtr into the arena does nothing, so the arena has to outlive
+// the tree: a module keeps its arena in AstNodeBody<MODULE>::arena.
+// The nodes are destroyed without regard to which owns which, so AstPtrs to
+// them must come from make_ast_node(arena, ...) or carry AstDeleter{.in_arena = true}.
+// Destroying the arena still calls the destructor of every node, as tokens
+// own the strings in their payloads: it saves the frees, but it is not O(1).
+struct AstArena {
+    AstArena() = default;
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    ~AstArena() {
+        for(auto* node : nodes_)
+            node->~AstNode();
+    }
+
+    template<AstNodeType type>
+    AstNodeConcrete<type>* create(AstNodeBody<type> body) {
+        void* place = arena_.allocate(sizeof(AstNodeConcrete<type>), alignof(AstNodeConcrete<type>));
+        if(nodes_.size() == nodes_.capacity()) // so that push_back cannot throw after construction
+            nodes_.reserve(std::max<std::size_t>(64, nodes_.capacity() * 2));
+        auto* node = ::new(place) AstNodeConcrete<type>{std::move(body)};
+        nodes_.push_back(node);
+        return node;
+    }
+
+    // Takes over the nodes of `other`, e.g. of an arena per thread,
+    // which is left empty. The nodes may own and be owned by nodes of this
+    // arena either way, since AstDeleter does not look at them.
+    void adopt(AstArena& other) {
+        nodes_.reserve(nodes_.size() + other.nodes_.size());
+        arena_.adopt(std::move(other.arena_));
+        nodes_.insert(nodes_.end(), other.nodes_.begin(), other.nodes_.end());
+        other.nodes_.clear();
+    }
+
+    std::size_t size() const {
+        return nodes_.size();
+    }
+
+private:
+    Arena arena_;
+    std::vector<AstNode*> nodes_;
+};
+
 template<AstNodeType type>
 auto make_ast_node(AstNodeBody<type> body) {
     return AstPtr<AstNodeBody<type>::category>(new AstNodeConcrete<type>{std::move(body)});
 }
 
+template<AstNodeType type>
+auto make_ast_node(AstArena& arena, AstNodeBody<type> body) {
+    return AstPtr<AstNodeBody<type>::category>(arena.create(std::move(body)), AstDeleter{.in_arena = true});
+}
+
 
 // MODULE
 
 template<> struct AstNodeBody<AstNodeType::MODULE> {
     static constexpr auto category = AstCategoryType::MODULE;
+    // Declared first, so that it is destroyed after the nodes it owns
+    std::unique_ptr<AstArena> arena = {};
     std::vector<DeclPtr> decls;
 };
 
@@ -154,17 +250,17 @@ template<> struct AstNodeBody<AstNodeType::COMPOUND_EXPR> {
         >
     > preface;
 
-    ExprPtr last;
+    ExprPtr last; // null if the block has no value
 };
 
 template<> struct AstNodeBody<AstNodeType::IF_EXPR> {
     static constexpr auto category = AstCategoryType::EXPRESSION;
-    ExprPtr cond, on_true, on_false;
+    ExprPtr cond, on_true, on_false; // on_false is null without `else`
 };
 
 template<> struct AstNodeBody<AstNodeType::RETURN_EXPR> {
     static constexpr auto category = AstCategoryType::EXPRESSION;
-    ExprPtr result;
+    ExprPtr result; // null for a bare `return`
 };
 
 template<> struct AstNodeBody<AstNodeType::LITERAL_EXPR> {
@@ -172,4 +268,12 @@ template<> struct AstNodeBody<AstNodeType::LITERAL_EXPR> {
     Token body;
 };
 
+
+constexpr AstCategoryType ast_category(AstNodeType type) {
+    constexpr auto categories = apply_enum<AstNodeType>([]<AstNodeType... types>(std::integer_sequence<AstNodeType, types...>) {
+        return std::array{AstNodeBody<types>::category...};
+    });
+    return categories[static_cast<std::size_t>(type)];
+}
+
 }
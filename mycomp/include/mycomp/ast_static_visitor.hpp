@@ -0,0 +1,113 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include "utils/apply_enum.hpp"
+
+#include <concepts>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace mycomp {
+
+namespace detail {
+
+template<typename Node, typename T>
+using ConstLike = std::conditional_t<std::is_const_v<Node>, const T, T>;
+
+}
+
+// Calls f with the body of the node, dispatching on node.type() instead of
+// a virtual call. The comparisons below are compiled into a jump table,
+// and f can be inlined into every case of it.
+// Every call of f has to return the same type, which (if not void) has to be default constructible.
+template<typename Node, typename F>
+requires std::derived_from<std::remove_const_t<Node>, AstNode>
+decltype(auto) visit_ast_node(Node& node, F&& f) {
+    return apply_enum<AstNodeType>([&]<AstNodeType... types>(std::integer_sequence<AstNodeType, types...>) -> decltype(auto) {
+        auto call = [&]<AstNodeType type>(std::integral_constant<AstNodeType, type>) -> decltype(auto) {
+            auto& base = static_cast<detail::ConstLike<Node, AstNode>&>(node);
+            return f(static_cast<detail::ConstLike<Node, AstNodeConcrete<type>>&>(base).body_);
+        };
+        using R = decltype(call(std::integral_constant<AstNodeType, AstNodeType::MODULE>{}));
+
+        if constexpr (std::is_void_v<R>) {
+            ((node.type() == types && (call(std::integral_constant<AstNodeType, types>{}), true)) || ...);
+        } else {
+            R res{};
+            ((node.type() == types && (res = call(std::integral_constant<AstNodeType, types>{}), true)) || ...);
+            return res;
+        }
+    });
+}
+
+
+// A visitor without virtual calls. Derived has to provide
+//     void visit(const AstNodeBody<type>& body)
+// for every type; a template that falls back to visitChildren is the way
+// to handle only some of them:
+//
+//     struct CountLiterals : StaticAstVisitor<CountLiterals> {
+//         void visit(const AstNodeBody<AstNodeType::LITERAL_EXPR>&) { count++; }
+//         template<AstNodeType type>
+//         void visit(const AstNodeBody<type>& body) { visitChildren(body); }
+//         int count = 0;
+//     };
+template<typename Derived>
+struct StaticAstVisitor {
+    void visitNode(const AstNode& node) {
+        visit_ast_node(node, [this](const auto& body) {
+            derived().visit(body);
+        });
+    }
+
+    template<AstCategoryType category>
+    void visitNode(const AstPtr<category>& ptr) {
+        if(ptr)
+            visitNode(*ptr);
+    }
+
+    // Visits the children of the node in the order they are declared in
+    template<AstNodeType type>
+    void visitChildren(const AstNodeBody<type>& body) {
+        using enum AstNodeType;
+        if constexpr (type == MODULE) {
+            for(const auto& decl : body.decls)
+                visitNode(decl);
+        } else if constexpr (type == FUNCTION_DECL) {
+            visitNode(body.type);
+        } else if constexpr (type == VARIABLE_DECL) {
+            visitNode(body.type);
+            visitNode(body.value);
+        } else if constexpr (type == ASSIGNMENT_STMT) {
+            visitNode(body.value);
+        } else if constexpr (type == EXPR_STMT) {
+            visitNode(body.body);
+        } else if constexpr (type == UNARY_EXPR) {
+            visitNode(body.expr);
+        } else if constexpr (type == BINARY_EXPR) {
+            visitNode(body.lhs);
+            visitNode(body.rhs);
+        } else if constexpr (type == COMPOUND_EXPR) {
+            for(const auto& elem : body.preface)
+                std::visit([this](const auto& ptr) { visitNode(ptr); }, elem);
+            visitNode(body.last);
+        } else if constexpr (type == IF_EXPR) {
+            visitNode(body.cond);
+            visitNode(body.on_true);
+            visitNode(body.on_false);
+        } else if constexpr (type == RETURN_EXPR) {
+            visitNode(body.result);
+        } else {
+            static_assert(type == PRIMITIVE_TYPE || type == LITERAL_EXPR, "Unhandled node type");
+        }
+    }
+
+private:
+    Derived& derived() {
+        return static_cast<Derived&>(*this);
+    }
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "vm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <variant>
+#include <vector>
+
+namespace mycomp {
+
+// The values of a parameter, one per row
+using BatchColumn = std::variant<
+    std::span<const std::int64_t>, // INT
+    std::span<const double>,       // REAL
+    std::span<const bool>          // BOOL
+>;
+
+// An expression evaluated over whole columns instead of one row at a time.
+// The expression becomes a list of kernels, each running one operator over
+// a batch of rows in a tight loop. The branches of an `if` run only over
+// the rows their condition selects, listed in a selection vector.
+// Expressions with anything but operators, literals, parameters, `if` with
+// `else` and blocks of variable declarations are run row by row on the VM.
+// Reuses its buffers between calls, so it is not thread-safe.
+struct BatchFunction {
+    static constexpr std::size_t batch_size = 1024;
+
+    BatchFunction(BatchFunction&& other) noexcept;
+    BatchFunction& operator=(BatchFunction&& other) noexcept;
+    ~BatchFunction();
+
+    ValueType resultType() const {
+        return program_.result_type;
+    }
+    bool isVectorized() const {
+        return pipeline_ != nullptr;
+    }
+
+    // Evaluates every row of the columns, which are given for every parameter,
+    // in order, and are as long as `out`. Throws RuntimeException, and
+    // std::invalid_argument for columns or an output of the wrong type or length.
+    void operator()(std::span<const BatchColumn> columns, std::span<std::int64_t> out);
+    void operator()(std::span<const BatchColumn> columns, std::span<double> out);
+    void operator()(std::span<const BatchColumn> columns, std::span<bool> out);
+
+private:
+    friend BatchFunction batch_compile(const AstNode& expr, std::span<const Parameter> params);
+
+    struct Pipeline;
+
+    BatchFunction(Program program, std::span<const Parameter> params);
+
+    void run(std::span<const BatchColumn> columns, void* out, std::size_t rows, ValueType type);
+    void runRows(std::span<const BatchColumn> columns, void* out, std::size_t rows);
+
+    Program program_;
+    std::vector<ValueType> parameter_types_;
+    std::unique_ptr<Pipeline> pipeline_;
+    Vm vm_;
+};
+
+// Type-checks the expression as compile_expression() does and compiles it.
+// Throws CompileException.
+BatchFunction batch_compile(const AstNode& expr, std::span<const Parameter> params);
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mycomp {
+
+// The static type of an expression. NEVER is the type of `return`,
+// which fits wherever a value of any type is expected.
+enum class ValueType : std::uint8_t {
+    UNIT,
+    INT,
+    REAL,
+    BOOL,
+    NEVER
+};
+
+// A register or a constant. Untyped: every opcode knows the types of its operands,
+// and the compiler checks that they are right.
+union Slot {
+    std::int64_t integer;
+    double real;
+    bool boolean;
+};
+
+// a, b and c are registers unless said otherwise.
+// `wide` is the 32-bit operand stored in b and c.
+enum class OpCode : std::uint8_t {
+    LOAD_CONST,    // a = constants[wide]
+    MOVE,          // a = b
+
+    // a = b op c. Integers wrap around on overflow.
+    ADD_INT,
+    SUB_INT,
+    MUL_INT,
+    DIV_INT,       // throws RuntimeException on division by zero
+    ADD_REAL,
+    SUB_REAL,
+    MUL_REAL,
+    DIV_REAL,
+    EQ_INT,
+    NE_INT,
+    LT_INT,
+    GT_INT,
+    EQ_REAL,
+    NE_REAL,
+    LT_REAL,
+    GT_REAL,
+    EQ_BOOL,
+    NE_BOOL,
+
+    // a = op b
+    NEG_INT,
+    NEG_REAL,
+    NOT_BOOL,
+
+    JUMP,          // to the instruction wide
+    JUMP_IF_FALSE, // to the instruction wide if a is false
+    RETURN,        // ends the program with a as the result
+    HALT           // ends the program without a result
+};
+
+struct Instruction {
+    OpCode op;
+    std::uint16_t a = 0, b = 0, c = 0;
+
+    std::uint32_t wide() const {
+        return b | std::uint32_t(c) << 16;
+    }
+    void setWide(std::uint32_t value) {
+        b = static_cast<std::uint16_t>(value);
+        c = static_cast<std::uint16_t>(value >> 16);
+    }
+};
+
+static_assert(sizeof(Instruction) == 8);
+
+struct CompileException {
+    std::size_t begin_pos, end_pos;
+    std::string error;
+};
+
+// Code for the register machine in vm.hpp. Every variable and temporary
+// gets a register of its own, so the code reads and writes registers
+// directly and never moves values to and from a stack.
+struct Program {
+    struct Variable {
+        std::string name;
+        std::uint16_t reg;
+        ValueType type;
+    };
+
+    // Where the instruction at pc came from, for the instructions that may fail
+    struct ErrorSite {
+        std::uint32_t pc;
+        std::size_t begin_pos, end_pos;
+    };
+
+    std::vector<Instruction> code;
+    std::vector<Slot> constants;
+    std::uint32_t register_count = 0;
+    std::uint32_t parameter_count = 0;       // registers that Vm::run fills with arguments
+    ValueType result_type = ValueType::UNIT; // of the value given to RETURN
+    std::vector<Variable> globals;           // declared in the module, in order
+    std::vector<ErrorSite> error_sites;      // sorted by pc
+};
+
+// Compiles the variable declarations of a module, in order. Functions have
+// no bodies yet and are skipped. Types are checked statically: operands of
+// a binary operator have the same type, `if` conditions are BOOL and
+// declarations with a type (int, real or bool) are initialized with it.
+// Throws CompileException, and std::length_error for a module that
+// needs more than 65535 registers.
+Program compile(const AstNodeBody<AstNodeType::MODULE>& module);
+
+// A variable that an expression is compiled over
+struct Parameter {
+    std::string_view name;
+    ValueType type;
+};
+
+// Compiles an expression into a program that returns its value.
+// The parameters get registers 0, 1, ..., which Vm::run fills with its arguments.
+Program compile_expression(const AstNode& expr, std::span<const Parameter> params);
+
+}
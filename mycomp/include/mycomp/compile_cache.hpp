@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ast.hpp"
+#include "flat_ast.hpp"
+#include "serialized_ast.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace mycomp {
+
+// Parsed modules cached on disk, so that a build skips the lexer and the parser
+// for sources that did not change since the last one.
+//
+// Every entry is a serialized AST in a file of its own, named by the XXH64 of
+// the source it was parsed from; the entry records the size and an unseeded
+// XXH64 of the source too, so that a collision of names is a miss and not the
+// AST of another source. Entries are written to a temporary file and renamed
+// into place, so a reader sees a whole entry or none; they are read through a
+// mapping, which stays valid even if the entry is evicted meanwhile.
+// Any number of processes can share the directory: only eviction takes a lock
+// (flock() on a file in it), so that two processes do not both evict.
+//
+// When the entries grow past max_size, the least recently used ones are
+// removed, by modification time, which find() updates on every hit.
+// A CompileCache is used from one thread; threads each have their own.
+struct CompileCache {
+    // Creates the directory if it does not exist.
+    // Throws std::system_error if it cannot be created or read.
+    CompileCache(std::filesystem::path dir, std::uint64_t max_size);
+
+    // The cached form of the source, if any. Entries that cannot be read
+    // (damaged, or of another version) are removed and count as misses,
+    // as do entries of another source under the same name.
+    std::optional<MappedAst> find(std::string_view source);
+    // Throws std::system_error if the entry cannot be written
+    void store(std::string_view source, const FlatAst& ast);
+
+    // The module of the source: unflattened from the cache, or parsed and
+    // stored on a miss. Throws as parse() and store() do.
+    AstPtr<AstCategoryType::MODULE> parse(std::string_view source);
+
+    // Removes the least recently used entries until they take at most 3/4 of
+    // max_size, and temporary files left behind by writers that crashed
+    void evict();
+
+    std::uint64_t hits() const {
+        return hits_;
+    }
+    std::uint64_t misses() const {
+        return misses_;
+    }
+
+private:
+    std::filesystem::path entryPath(std::string_view source) const;
+
+    std::filesystem::path dir_;
+    std::uint64_t max_size_;
+    // Of the entries when they were last listed, plus those stored since;
+    // entries that other processes store are only seen by the next evict()
+    std::uint64_t size_ = 0;
+    std::uint64_t hits_ = 0, misses_ = 0;
+};
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ast.hpp"
+#include "token_stream.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace mycomp {
+
+// Index of a node in FlatAst::nodes()
+enum class FlatNodeId : std::uint32_t {
+    NONE = std::numeric_limits<std::uint32_t>::max()
+};
+
+inline constexpr std::uint32_t no_flat_token = std::numeric_limits<std::uint32_t>::max();
+
+// A node of a FlatAst. What the token and the children mean depends on the type:
+//
+// MODULE           children: first decl in lists(), number of decls
+// PRIMITIVE_TYPE   token: body
+// FUNCTION_DECL    token: name, children: type
+// VARIABLE_DECL    token: name, children: type, value
+// ASSIGNMENT_STMT  token: var, children: value
+// EXPR_STMT        children: body
+// UNARY_EXPR       token: op, children: expr
+// BINARY_EXPR      token: op, children: lhs, rhs
+// COMPOUND_EXPR    children: first preface element in lists(), preface size, last
+// IF_EXPR          children: cond, on_true, on_false
+// RETURN_EXPR      children: result
+// LITERAL_EXPR     token: body
+struct FlatNode {
+    AstNodeType type;
+    std::uint32_t token = no_flat_token; // index into FlatAst::tokens()
+    std::array<std::uint32_t, 3> children = {
+        std::uint32_t(FlatNodeId::NONE),
+        std::uint32_t(FlatNodeId::NONE),
+        std::uint32_t(FlatNodeId::NONE)
+    };
+
+    FlatNodeId child(std::size_t ind) const {
+        return FlatNodeId{children[ind]};
+    }
+
+    bool operator==(const FlatNode&) const = default;
+};
+
+static_assert(sizeof(FlatNode) == 20);
+
+// The data-oriented form of an AST: all the nodes of a module live in one array
+// and refer to each other by 32-bit indices. Children always come before their
+// parents, so a whole-module analysis is a linear scan over nodes(),
+// and the module itself is the last node.
+struct FlatAst {
+    std::span<const FlatNode> nodes() const {
+        return nodes_;
+    }
+    const FlatNode& node(FlatNodeId id) const {
+        return nodes_[static_cast<std::uint32_t>(id)];
+    }
+    // Only a default-constructed FlatAst has no nodes, and then no root
+    FlatNodeId root() const {
+        assert(!nodes_.empty());
+        return FlatNodeId(static_cast<std::uint32_t>(nodes_.size() - 1));
+    }
+
+    // Children of MODULE and COMPOUND_EXPR nodes
+    std::span<const FlatNodeId> list(const FlatNode& node) const {
+        return std::span(lists_).subspan(node.children[0], node.children[1]);
+    }
+
+    const TokenStream& tokens() const {
+        return tokens_;
+    }
+    Token token(const FlatNode& node) const {
+        return tokens_[node.token];
+    }
+
+    bool operator==(const FlatAst& other) const;
+
+private:
+    friend FlatAst flatten(const AstNodeBody<AstNodeType::MODULE>& module);
+    friend std::vector<std::byte> serialize(const FlatAst& ast, std::string_view source);
+
+    std::vector<FlatNode> nodes_;
+    std::vector<FlatNodeId> lists_;
+    TokenStream tokens_;
+};
+
+FlatAst flatten(const AstNodeBody<AstNodeType::MODULE>& module);
+
+// The tree is allocated in an AstArena owned by the returned module.
+// An empty FlatAst gives an empty module.
+AstPtr<AstCategoryType::MODULE> unflatten(const FlatAst& ast);
+
+}
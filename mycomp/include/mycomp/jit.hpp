@@ -0,0 +1,51 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "vm.hpp"
+
+#include <cstddef>
+#include <span>
+
+namespace mycomp {
+
+// An expression compiled to machine code. Only arithmetic is compiled natively:
+// + - * and unary minus over INT or REAL parameters and literals, and / over REAL.
+// Everything else, and everything on machines other than x86-64 or where no
+// executable memory can be mapped, runs on the bytecode VM instead.
+// Move-only: owns the memory the code lives in.
+struct JitFunction {
+    ~JitFunction();
+
+    JitFunction(JitFunction&& other) noexcept;
+    JitFunction& operator=(JitFunction&& other) noexcept;
+
+    ValueType resultType() const {
+        return program_.result_type;
+    }
+    bool isNative() const {
+        return code_ != nullptr;
+    }
+
+    // Takes an argument for every parameter, in order. Throws RuntimeException
+    // from the VM, and std::invalid_argument for a wrong number of arguments.
+    Slot operator()(std::span<const Slot> args) const;
+
+private:
+    friend JitFunction jit_compile(const AstNode& expr, std::span<const Parameter> params);
+
+    JitFunction(Program program, std::size_t parameter_count);
+
+    using Native = void (*)(const Slot* args, Slot* result);
+
+    Program program_;
+    std::size_t parameter_count_;
+    mutable Vm vm_;
+    void* code_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Type-checks the expression as compile_expression() does and compiles it.
+// Throws CompileException.
+JitFunction jit_compile(const AstNode& expr, std::span<const Parameter> params);
+
+}
@@ -1,12 +1,15 @@
 #pragma once
 
 #include "scanner.hpp"
+#include "utils/simd.hpp"
 
 #include <cstdint>
 #include <exception>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -40,7 +43,8 @@ enum class TokenType {
     VAR,
     IF,
     ELSE,
-    RETURN
+    RETURN,
+    ERROR // malformed code, only produced by a Lexer that collects diagnostics
 };
 
 struct Token {
@@ -56,26 +60,128 @@ struct Token {
     bool operator==(const Token&) const = default;
 };
 
+// A token without its payload, which can be decoded from the code on demand
+struct SpanToken {
+    TokenType tokenType;
+    std::size_t begin_pos, end_pos;
+
+    bool operator==(const SpanToken&) const = default;
+};
+
 struct LexException {
     size_t begin_pos, end_pos;
     std::string error;
 };
 
 struct Lexer {
-    Lexer(std::string_view code);
+    Lexer(std::string_view code, SimdLevel simd = detect_simd_level());
+
+    // A lexer that does not throw LexException: errors are appended to `diagnostics`
+    // and produce an ERROR token covering the malformed code, after which lexing goes on.
+    Lexer(std::string_view code, std::vector<LexException>& diagnostics, SimdLevel simd = detect_simd_level());
 
     std::optional<Token> next();
 
+    // Same as next(), but does not copy the text of IDENTIFIER and STRING
+    // tokens into their payload: it can be recovered with token_text().
+    std::optional<Token> nextWithoutText();
+
+    // Same as next(), but only finds the kind and the span of the token:
+    // no text is copied and no number is converted. Numbers that are too large
+    // are only reported when they are decoded.
+    std::optional<SpanToken> nextSpan();
+
+    // Writes the next tokens (as next() would return them) into `out`, and returns
+    // how many were written: fewer than out.size() means that the code has ended.
+    // The string payloads already in `out` are reused, so lexing again and again
+    // into the same buffer does not allocate.
+    std::size_t nextBatch(std::span<Token> out);
+
+    // The lexer keeps no state besides its position, so lexing can be
+    // restarted anywhere a token ends (or at any position that is not inside
+    // a token or a comment) and gives the same tokens from there on.
+    std::size_t pos() const {
+        return s_.ind();
+    }
+    void seek(std::size_t pos) {
+        s_.seek(pos);
+    }
+
 private:
-    void skipWhitespaceAndComments();
-    Token parseNumber();
+    bool nextInto(Token& out);
+    std::optional<Token> lexToken(bool decode_numbers);
+    // Throws the error, or records it and returns an ERROR token from `begin`
+    // to `resume`, where lexing continues
+    [[gnu::cold]] Token fail(LexException error, std::size_t begin, std::size_t resume);
+    // Returns an ERROR token for a malformed comment
+    std::optional<Token> skipWhitespaceAndComments();
+    Token parseNumber(bool decode);
     Token parseString();
     Token parseWord();
     Token parseSpecialToken();
 
     Scanner s_;
+    SimdLevel simd_;
+    std::vector<LexException>* diagnostics_ = nullptr;
 };
 
 std::vector<Token> lex(std::string_view code);
 
+// Same result as lex() (including the LexException thrown for malformed code),
+// computed by lexing chunks of the code on `threads` threads.
+// Chunks are lexed speculatively from line starts, and re-synchronized with the
+// preceding chunk where a line start turned out to be inside a comment or a string.
+std::vector<Token> lex_parallel(std::string_view code, unsigned threads = std::thread::hardware_concurrency());
+
+// Lexes with Lexer::nextSpan(), for consumers that only need kinds and positions
+std::vector<SpanToken> lex_spans(std::string_view code);
+
+// The token as lex() would have returned it.
+// Throws LexException for a number that is too large.
+Token decode(std::string_view code, const SpanToken& token);
+std::uint64_t decode_natural(std::string_view code, const SpanToken& token);
+double decode_real(std::string_view code, const SpanToken& token);
+
+struct LexResult {
+    std::vector<Token> tokens;
+    std::vector<LexException> diagnostics;
+};
+
+// Lexes all of the code, reporting every error instead of stopping at the first one
+LexResult lex_with_diagnostics(std::string_view code);
+
+// Replacement of `removed` bytes at `offset` with `inserted`
+struct TextEdit {
+    std::size_t offset, removed;
+    std::string_view inserted;
+};
+
+// Updates `tokens`, the result of lex() on some code, to be the result of lex()
+// on `new_code`, which is that code with `edit` applied. Only the tokens around
+// the edit are lexed again; the ones after it are shifted.
+// If the new code is malformed, throws LexException and leaves `tokens` unchanged.
+void relex(std::vector<Token>& tokens, std::string_view new_code, const TextEdit& edit);
+
+// The name of an IDENTIFIER or the contents of a STRING (without the quotes),
+// as a view into the code the token was lexed from.
+std::string_view token_text(std::string_view code, const Token& token);
+std::string_view token_text(std::string_view code, const SpanToken& token);
+
+// Returns the position of the first character at or after `pos` that is
+// neither whitespace nor inside a comment. Every SimdLevel gives the same
+// result and throws the same LexException on malformed comments.
+std::size_t skip_whitespace_and_comments(std::string_view code, std::size_t pos, SimdLevel simd);
+
+namespace detail {
+
+// Same as above, but instead of throwing stops at the malformed comment and sets `error`
+std::size_t skip_whitespace_and_comments(
+    std::string_view code,
+    std::size_t pos,
+    SimdLevel simd,
+    std::optional<LexException>& error
+);
+
+}
+
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "lex.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace mycomp {
+
+// A read-only memory mapping of a whole source file.
+// The file is mapped with MADV_SEQUENTIAL, since the lexer reads it front to back once.
+// Throws std::system_error if the file cannot be opened or mapped.
+struct MappedSource {
+    explicit MappedSource(const std::filesystem::path& path);
+    ~MappedSource();
+
+    MappedSource(MappedSource&& other) noexcept;
+    MappedSource& operator=(MappedSource&& other) noexcept;
+
+    std::string_view text() const {
+        return {data_, size_};
+    }
+    std::size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Tokens lexed straight from a mapped file. IDENTIFIER and STRING tokens
+// carry no text of their own (as with Lexer::nextWithoutText()):
+// their text is a view into the mapping, which lives as long as the tokens do.
+struct LexedFile {
+    std::shared_ptr<const MappedSource> source;
+    std::vector<Token> tokens;
+
+    std::string_view text(const Token& token) const {
+        return token_text(source->text(), token);
+    }
+};
+
+// Lexes a file without copying it into memory first.
+// Throws std::system_error on I/O errors and LexException on malformed code.
+LexedFile lex_file(const std::filesystem::path& path);
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ast.hpp"
+#include "lex.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace mycomp {
+
+struct ParseException {
+    std::size_t begin_pos, end_pos;
+    std::string error;
+};
+
+// Parses a module straight from the Lexer, one token of lookahead and no backtracking.
+// The nodes are allocated in an AstArena owned by the module.
+//
+//     module    := decl*
+//     decl      := 'var' type IDENTIFIER '=' expr ';'
+//                | 'fn' type IDENTIFIER '(' ')' ';'
+//     type      := IDENTIFIER
+//     compound  := '{' (item ';')* expr? '}'
+//     item      := decl-without-';' | IDENTIFIER '=' expr | expr
+//     expr      := prefix (binary-op expr)*, by precedence climbing
+//     prefix    := literal | IDENTIFIER | '(' expr ')' | ('-' | '!') prefix | compound
+//                | 'if' expr compound ('else' (compound | if))? | 'return' expr?
+//
+// Binary operators are left associative, from the loosest:
+// == !=, < >, + -, * /.
+// Throws LexException and ParseException.
+ModulePtr parse(std::string_view code);
+
+// The expression alone, for tests and tools; its nodes are allocated in `arena`
+ExprPtr parse_expr(std::string_view code, AstArena& arena);
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ast.hpp"
+#include "utils/task_scheduler.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mycomp {
+
+// Rewrites a module in place and returns whether it changed anything
+using AstPass = std::function<bool(AstNodeBody<AstNodeType::MODULE>&)>;
+
+// Runs passes in the order they were added, all of them again as long as
+// one changes the module, since a pass may open up work for the others
+struct PassManager {
+    struct Statistics {
+        std::string name;
+        std::size_t runs = 0, changes = 0;
+    };
+
+    PassManager& add(std::string name, AstPass pass);
+
+    // Returns whether the module changed. Stops after max_rounds rounds
+    // even if the passes keep changing it.
+    bool run(AstNodeBody<AstNodeType::MODULE>& module, std::size_t max_rounds = 8);
+
+    // For every pass, in order
+    const std::vector<Statistics>& statistics() const {
+        return statistics_;
+    }
+
+private:
+    std::vector<AstPass> passes_;
+    std::vector<Statistics> statistics_;
+};
+
+// Folds operators and ifs over constants with the semantics of the VM
+// (integers wrap around, division by zero is left for run time),
+// and simplifies x + 0, x * 1, x / 1, -(-x), !!x, x == true and the like.
+// Literal nodes are reused where possible, new nodes go to module.arena.
+//
+// Meant for programs that compile: a branch that is folded away
+// takes its compile errors with it.
+bool fold_constants(AstNodeBody<AstNodeType::MODULE>& module);
+
+// The same on the workers of the scheduler: every top-level declaration,
+// and every item of a block with many of them, is folded as a task of its own.
+// The result does not depend on the number of workers. The workers create
+// nodes in arenas of their own, which module.arena takes over at the end.
+bool fold_constants(AstNodeBody<AstNodeType::MODULE>& module, TaskScheduler& scheduler);
+
+// The passes worth running on every module
+PassManager default_passes();
+// The same, running in parallel where they can
+PassManager default_passes(TaskScheduler& scheduler);
+
+}
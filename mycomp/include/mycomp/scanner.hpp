@@ -25,6 +25,9 @@ struct Scanner {
     std::size_t ind() const {
         return ind_;
     }
+    void seek(std::size_t ind) {
+        ind_ = std::min(ind, code_.size());
+    }
     std::string_view raw() const {
         return code_;
     }
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ast.hpp"
+#include "flat_ast.hpp"
+#include "mapped_source.hpp"
+#include "token_stream.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace mycomp {
+
+// Files of an older or newer version are rejected, to be parsed again
+inline constexpr std::uint32_t serialized_ast_version = 2;
+
+// A file that is not a serialized AST of this version, or is damaged
+struct SerializedAstError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// The binary form of a FlatAst, for caching parsed modules on disk:
+// a versioned header, then the nodes, lists and tokens of the FlatAst as they
+// are in memory, then the numbers of the tokens and a table of the names
+// they use. Nodes refer to each other and to tokens by index, and the header
+// locates every section by its offset from the start, so the file can be
+// used straight from memory wherever it is mapped. Written in the byte
+// order of the machine, which the header records.
+// The header also records the size and the XXH64 of the source the AST was
+// parsed from, so that a cache can tell whether it is the AST of a source.
+std::vector<std::byte> serialize(const FlatAst& ast, std::string_view source = {});
+
+// A serialized AST read in place: the accessors are those of FlatAst,
+// and nothing is allocated but the Tokens that token() returns.
+// The bytes must outlive it and be aligned to 8 bytes, as mappings are.
+struct SerializedAst {
+    // Checks the header, and that every index in the nodes and tokens is in
+    // bounds and refers to a node of the right kind, in one pass over them:
+    // every node but the root has exactly one parent, and only `else`, the
+    // value of a block and of `return` may be missing. Throws SerializedAstError.
+    explicit SerializedAst(std::span<const std::byte> bytes);
+
+    std::span<const FlatNode> nodes() const {
+        return nodes_;
+    }
+    const FlatNode& node(FlatNodeId id) const {
+        return nodes_[static_cast<std::uint32_t>(id)];
+    }
+    FlatNodeId root() const {
+        return FlatNodeId(static_cast<std::uint32_t>(nodes_.size() - 1));
+    }
+    std::span<const FlatNodeId> list(const FlatNode& node) const {
+        return lists_.subspan(node.children[0], node.children[1]);
+    }
+
+    std::span<const CompactToken> tokens() const {
+        return tokens_;
+    }
+    Token token(const FlatNode& node) const;
+    // The name of an IDENTIFIER or the contents of a STRING, without a copy
+    std::string_view text(const CompactToken& token) const;
+
+    // Of the source given to serialize()
+    std::uint64_t sourceSize() const {
+        return source_size_;
+    }
+    std::uint64_t sourceHash() const {
+        return source_hash_;
+    }
+
+private:
+    friend std::vector<std::byte> serialize(const FlatAst& ast, std::string_view source);
+
+    struct String {
+        std::uint32_t offset, size;
+    };
+
+    std::span<const FlatNode> nodes_;
+    std::span<const FlatNodeId> lists_;
+    std::span<const CompactToken> tokens_;
+    std::span<const std::uint64_t> numbers_;
+    std::span<const String> strings_;
+    std::string_view chars_;
+    std::uint64_t source_size_ = 0, source_hash_ = 0;
+};
+
+// A serialized AST in a mapped file.
+// Throws std::system_error if the file cannot be read and SerializedAstError.
+struct MappedAst {
+    explicit MappedAst(const std::filesystem::path& path);
+
+    const SerializedAst& ast() const {
+        return ast_;
+    }
+
+private:
+    MappedSource file_;
+    SerializedAst ast_;
+};
+
+// The tree is allocated in an AstArena owned by the returned module
+AstPtr<AstCategoryType::MODULE> unflatten(const SerializedAst& ast);
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "lex.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace mycomp {
+
+// A lexer over input that arrives in chunks, from a file descriptor,
+// a stream or any other source, so that it never has to be in memory at once.
+// Gives the same tokens (with positions counted from the start of the input)
+// and throws the same LexException as lex() on the whole input.
+//
+// Only the current token is kept between chunks, so memory is bounded
+// by the chunk size plus the longest token. Comments may be of any length.
+struct StreamLexer {
+    // Fills the buffer and returns how many bytes were read, 0 at the end of the input
+    using ReadFunction = std::function<std::size_t(std::span<char>)>;
+
+    static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+    explicit StreamLexer(ReadFunction read, std::size_t chunk_size = default_chunk_size);
+    // Throws std::system_error if reading fails
+    explicit StreamLexer(int fd, std::size_t chunk_size = default_chunk_size);
+    explicit StreamLexer(std::istream& in, std::size_t chunk_size = default_chunk_size);
+
+    std::optional<Token> next();
+
+    // Bytes of input held in memory
+    std::size_t memoryUsage() const {
+        return buf_.capacity();
+    }
+
+private:
+    enum class State {
+        CODE,
+        LINE_COMMENT,
+        BLOCK_COMMENT
+    };
+
+    // Drops the input before pos_ and appends the next chunk
+    void fill();
+
+    ReadFunction read_;
+    std::size_t chunk_size_;
+    SimdLevel simd_ = detect_simd_level();
+
+    std::string buf_;
+    std::size_t base_ = 0; // position of buf_[0] in the input
+    std::size_t pos_ = 0;  // in buf_
+    bool eof_ = false;
+
+    // Comments are skipped here when they continue past the buffer
+    State state_ = State::CODE;
+    std::size_t comment_begin_ = 0;
+};
+
+}
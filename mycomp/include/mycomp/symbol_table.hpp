@@ -0,0 +1,49 @@
+#pragma once
+
+#include "utils/arena.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace mycomp {
+
+// Ids are dense and stable: the n-th distinct name gets the id n
+enum class SymbolId : std::uint32_t {};
+
+// Interns identifiers and string literals, so that every distinct name is
+// stored once and names can be compared as integers.
+struct SymbolTable {
+    SymbolId intern(std::string_view name);
+    std::optional<SymbolId> find(std::string_view name) const;
+
+    // Valid for the lifetime of the table
+    std::string_view name(SymbolId id) const {
+        return names_[static_cast<std::uint32_t>(id)];
+    }
+    std::size_t size() const {
+        return names_.size();
+    }
+
+    std::size_t memoryUsage() const;
+
+private:
+    struct Slot {
+        std::uint32_t hash;
+        std::uint32_t id_plus_one; // 0 for an empty slot
+    };
+
+    // The slot holding `name` or the empty slot where it should go
+    std::size_t findSlot(std::string_view name, std::uint64_t hash) const;
+    void grow();
+
+    Arena chars_;
+    std::vector<std::string_view> names_;
+    std::vector<Slot> slots_ = std::vector<Slot>(64); // open addressing, linear probing
+};
+
+// The hash the table uses, exposed for other interning tables
+std::uint64_t hash_bytes(std::string_view bytes);
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "lex.hpp"
+#include "symbol_table.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mycomp {
+
+// A 16 byte token, meant for keeping long token sequences in memory.
+// The payload is an index into the side tables of the owning TokenStream:
+// into its numbers for NATURAL_NUMBER and REAL_NUMBER, a SymbolId
+// for IDENTIFIER and STRING, and unused otherwise.
+struct CompactToken {
+    std::uint32_t begin_pos, end_pos;
+    std::uint32_t payload;
+    TokenType tokenType;
+
+    bool operator==(const CompactToken&) const = default;
+};
+
+static_assert(sizeof(CompactToken) == 16);
+
+// A sequence of CompactTokens together with their payloads.
+// Names are interned into a SymbolTable, which can be shared between streams,
+// so no token allocates on its own.
+struct TokenStream {
+    explicit TokenStream(std::shared_ptr<SymbolTable> symbols = std::make_shared<SymbolTable>()) :
+        symbols_(std::move(symbols))
+    {}
+
+    std::size_t size() const {
+        return tokens_.size();
+    }
+    bool empty() const {
+        return tokens_.empty();
+    }
+    std::span<const CompactToken> tokens() const {
+        return tokens_;
+    }
+
+    // Compatibility accessor: the token as lex() would have returned it
+    Token operator[](std::size_t ind) const;
+    std::vector<Token> toTokens() const;
+
+    const SymbolTable& symbols() const {
+        return *symbols_;
+    }
+
+    SymbolId symbol(const CompactToken& token) const {
+        return SymbolId{token.payload};
+    }
+    std::string_view text(const CompactToken& token) const {
+        return symbols_->name(symbol(token));
+    }
+    std::uint64_t natural(const CompactToken& token) const;
+    double real(const CompactToken& token) const;
+
+    // The name of an IDENTIFIER or the contents of a STRING is taken from the
+    // payload of the token if it has one, as from next(), and from `text`
+    // otherwise, as for tokens from nextWithoutText().
+    // Throws std::length_error for positions past 4 GiB, which do not fit.
+    void push_back(const Token& token, std::string_view text = {});
+    void shrink_to_fit();
+
+    // Bytes owned by the stream and its symbols, for comparing against std::vector<Token>
+    std::size_t memoryUsage() const;
+
+private:
+    std::vector<CompactToken> tokens_;
+    std::vector<std::uint64_t> numbers_; // doubles are stored bitwise
+    std::shared_ptr<SymbolTable> symbols_;
+};
+
+// Same as lex(), but stores the result compactly, interning names into `symbols`.
+// Throws LexException if the code is too large for 32-bit positions.
+TokenStream lex_compact(
+    std::string_view code,
+    std::shared_ptr<SymbolTable> symbols = std::make_shared<SymbolTable>()
+);
+
+}
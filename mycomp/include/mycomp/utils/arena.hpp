@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mycomp {
+
+// A bump allocator: allocations are never freed one by one,
+// all the memory goes away together with the arena.
+// Nothing is ever moved, so pointers into the arena stay valid.
+struct Arena {
+    explicit Arena(std::size_t block_size = 64 * 1024) : block_size_(block_size) {}
+
+    // The memory moves along, and `other` is left empty
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+
+    void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+        auto padding = (align - reinterpret_cast<std::uintptr_t>(curr_) % align) % align;
+        if(padding + size > left_)
+            return allocateSlow(size, align);
+        auto* res = curr_ + padding;
+        curr_ += padding + size;
+        left_ -= padding + size;
+        return res;
+    }
+
+    // Takes over the memory of `other`, which is left empty: what was allocated
+    // there now lives as long as this arena
+    void adopt(Arena&& other);
+
+    // Bytes requested from the system so far
+    std::size_t memoryUsage() const {
+        return used_;
+    }
+
+private:
+    void* allocateSlow(std::size_t size, std::size_t align);
+
+    std::size_t block_size_;
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* curr_ = nullptr;
+    std::size_t left_ = 0;
+    std::size_t used_ = 0;
+};
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace mycomp {
+
+// Character classes as the lexer sees them. They match the "C" locale
+// versions of <cctype>, but are looked up in a constexpr table instead.
+namespace char_class {
+
+enum : std::uint8_t {
+    DIGIT = 1 << 0,      // 0-9
+    HEX_DIGIT = 1 << 1,  // 0-9, a-f, A-F
+    WORD_START = 1 << 2, // a-z, A-Z, _
+    WORD = 1 << 3,       // a-z, A-Z, _, 0-9
+    SPACE = 1 << 4,      // ' ', \t, \n, \v, \f, \r
+    PUNCT = 1 << 5       // printable, but neither alphanumeric nor space
+};
+
+inline constexpr auto table = [] {
+    std::array<std::uint8_t, 256> res{};
+    for(unsigned c = 0; c < 256; c++) {
+        bool digit = c >= '0' && c <= '9';
+        bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        bool hex = digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        bool space = c == ' ' || (c >= '\t' && c <= '\r');
+        bool punct = c > ' ' && c < 0x7f && !digit && !alpha;
+
+        std::uint8_t cls = 0;
+        if(digit) cls |= DIGIT;
+        if(hex) cls |= HEX_DIGIT;
+        if(alpha || c == '_') cls |= WORD_START;
+        if(alpha || digit || c == '_') cls |= WORD;
+        if(space) cls |= SPACE;
+        if(punct) cls |= PUNCT;
+        res[c] = cls;
+    }
+    return res;
+}();
+
+}
+
+constexpr bool has_char_class(char c, std::uint8_t cls) {
+    return (char_class::table[static_cast<unsigned char>(c)] & cls) != 0;
+}
+
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace mycomp {
+
+// XXH64 of the bytes, as specified by xxHash: a fast non-cryptographic hash
+// for content-addressing sources, not for anything an attacker controls.
+// The same bytes and seed give the same hash on every machine.
+std::uint64_t xxh64(std::string_view bytes, std::uint64_t seed = 0);
+
+}
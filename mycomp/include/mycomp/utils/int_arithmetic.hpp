@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+namespace mycomp {
+
+// The semantics of INT that the VM, the batch executor and constant folding
+// share: 64-bit two's complement that wraps around on overflow, as computed
+// in unsigned. Division truncates, and dividing by zero is an error that each
+// of them reports in its own way, so divide() leaves it to the caller.
+namespace int_arithmetic {
+
+constexpr std::int64_t wrap(std::uint64_t value) {
+    return static_cast<std::int64_t>(value);
+}
+
+constexpr std::uint64_t bits(std::int64_t value) {
+    return static_cast<std::uint64_t>(value);
+}
+
+constexpr std::int64_t add(std::int64_t lhs, std::int64_t rhs) {
+    return wrap(bits(lhs) + bits(rhs));
+}
+
+constexpr std::int64_t sub(std::int64_t lhs, std::int64_t rhs) {
+    return wrap(bits(lhs) - bits(rhs));
+}
+
+constexpr std::int64_t mul(std::int64_t lhs, std::int64_t rhs) {
+    return wrap(bits(lhs) * bits(rhs));
+}
+
+constexpr std::int64_t negate(std::int64_t value) {
+    return wrap(0 - bits(value));
+}
+
+// `rhs` must not be 0. -1 is special cased, since the minimum divided by it
+// overflows: it wraps around to the minimum instead.
+constexpr std::int64_t divide(std::int64_t lhs, std::int64_t rhs) {
+    return rhs == -1 ? negate(lhs) : lhs / rhs;
+}
+
+inline constexpr const char* division_by_zero = "Division by zero";
+
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "simd.hpp"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace mycomp {
+
+// 1-based line and column; the column counts bytes
+struct SourceLocation {
+    std::size_t line, column;
+
+    bool operator==(const SourceLocation&) const = default;
+};
+
+// Where every line of a source begins, for turning token and error positions
+// into line and column numbers without rescanning the source.
+// Building it is a vectorized scan for '\n'; lookups are binary searches.
+struct LineIndex {
+    explicit LineIndex(std::string_view code, SimdLevel simd = detect_simd_level());
+
+    std::size_t lineCount() const {
+        return line_starts_.size();
+    }
+
+    // Positions past the end are on the last line
+    SourceLocation location(std::size_t pos) const;
+
+    // The byte range [begin, end) of a line in [1, lineCount()], without its '\n'
+    struct Range {
+        std::size_t begin, end;
+    };
+    Range lineRange(std::size_t line) const;
+
+private:
+    std::vector<std::size_t> line_starts_;
+    std::size_t size_;
+};
+
+}
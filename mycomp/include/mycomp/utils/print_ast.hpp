@@ -2,8 +2,11 @@
 
 #include "../ast_visitor.hpp"
 
+#include <cstdio>
+
 namespace mycomp {
 
-std::unique_ptr<AstVisitor> make_ast_printer();
+// Prints the tree as it is visited, one node or token per line
+std::unique_ptr<AstVisitor> make_ast_printer(std::FILE* out = stdout);
 
 }
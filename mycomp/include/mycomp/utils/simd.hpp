@@ -0,0 +1,26 @@
+#pragma once
+
+// Defined where the SSE4.2 and AVX2 code paths exist. Their functions are
+// marked with MYCOMP_TARGET_SSE42 or MYCOMP_TARGET_AVX2, so that only they are
+// compiled for the instruction set, and are called after detect_simd_level().
+// Files with such paths include <immintrin.h> themselves.
+#if defined(__x86_64__) || defined(__i386__)
+#define MYCOMP_X86 1
+#define MYCOMP_TARGET_SSE42 [[gnu::target("sse4.2")]]
+#define MYCOMP_TARGET_AVX2 [[gnu::target("avx2")]]
+#endif
+
+namespace mycomp {
+
+// Ordered from the weakest to the strongest instruction set,
+// so that levels can be compared with < and >.
+enum class SimdLevel {
+    SCALAR,
+    SSE42,
+    AVX2
+};
+
+// The best level supported by the CPU we are running on. Cached after the first call.
+SimdLevel detect_simd_level();
+
+}
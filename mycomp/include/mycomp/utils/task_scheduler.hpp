@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mycomp {
+
+// A fixed set of worker threads for fork-join parallelism.
+//
+// Every worker has a deque of tasks of its own: it pushes and pops at the back,
+// so it works depth first on what it spawned last, and idle workers steal from
+// the front, where the oldest and largest pieces of work are. The thread that
+// calls parallelFor() from outside is worker 0 and works too, so with one thread
+// everything runs on the caller, in order. Tasks may call parallelFor() again;
+// a worker waiting for its tasks runs other tasks meanwhile.
+//
+// Workers are numbered 0 to workerCount() - 1, so that tasks can use state of
+// their own worker, such as an arena, without locks.
+struct TaskScheduler {
+    // Starts threads - 1 threads besides the caller
+    explicit TaskScheduler(unsigned threads = std::thread::hardware_concurrency());
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    unsigned workerCount() const {
+        return worker_count_;
+    }
+
+    // Calls f(index, worker) for every index in [0, count), in parallel, and
+    // returns when all the calls have. If some of them throw, the exception
+    // of the lowest index is rethrown, whatever the number of threads:
+    // the calls of higher indices are then skipped if they have not started.
+    // From outside the workers, one thread at a time calls it.
+    template<typename F>
+    void parallelFor(std::size_t count, const F& f) {
+        run(count, [](const void* context, std::size_t index, unsigned worker) {
+            (*static_cast<const F*>(context))(index, worker);
+        }, &f);
+    }
+
+private:
+    using Call = void(*)(const void* context, std::size_t index, unsigned worker);
+
+    // The tasks of one parallelFor()
+    struct Group {
+        Call call;
+        const void* context;
+        std::atomic<std::size_t> remaining;
+        std::atomic<std::size_t> error_index;
+        std::exception_ptr error;
+        std::mutex error_mutex;
+    };
+
+    struct Task {
+        Group* group;
+        std::size_t index;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(std::size_t count, Call call, const void* context);
+    bool runOne(unsigned worker);
+    void execute(const Task& task, unsigned worker);
+    void workerLoop(unsigned worker);
+    void wakeAll();
+    void stop();
+
+    unsigned worker_count_;
+    std::unique_ptr<Worker[]> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex external_; // held by outside callers of parallelFor()
+
+    // Idle workers sleep until it changes, which it does whenever tasks are
+    // pushed, a parallelFor() is done, or the workers are stopping
+    std::atomic<std::uint32_t> epoch_{0};
+    std::atomic<bool> stopping_{false};
+};
+
+}
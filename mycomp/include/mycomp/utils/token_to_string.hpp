@@ -1,9 +1,16 @@
 #pragma once
 
 #include "../lex.hpp"
+#include "line_index.hpp"
 
 namespace mycomp {
 
 std::string token_to_string(const Token& token);
 
+// Same, but with the positions as line:column
+std::string token_to_string(const Token& token, const LineIndex& lines);
+
+// "line:column: error"
+std::string lex_error_to_string(const LexException& error, const LineIndex& lines);
+
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace mycomp {
+
+// A value with its type, as it leaves the VM
+using Value = std::variant<
+    std::monostate, // UNIT
+    std::int64_t,
+    double,
+    bool
+>;
+
+struct RuntimeException {
+    std::size_t begin_pos, end_pos;
+    std::string error;
+};
+
+// Runs compiled programs. The registers are kept between runs, so that
+// running a program many times does not allocate.
+struct Vm {
+    // The value given to RETURN, or monostate if the program ran to its end.
+    // Throws RuntimeException.
+    Value run(const Program& program);
+    // For a program from compile_expression, with an argument for every parameter.
+    // Throws std::invalid_argument for a wrong number of arguments.
+    Value run(const Program& program, std::span<const Slot> args);
+
+    // A module variable after the last run of the program.
+    // Throws std::out_of_range for an unknown name.
+    Value variable(const Program& program, std::string_view name) const;
+
+private:
+    std::vector<Slot> registers_;
+};
+
+}
@@ -0,0 +1,594 @@
+#include "mycomp/batch.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+#include "mycomp/utils/int_arithmetic.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace mycomp {
+
+namespace {
+
+using enum AstNodeType;
+using enum TokenType;
+using enum ValueType;
+
+constexpr auto batch_size = BatchFunction::batch_size;
+
+// The rows of a batch an operation runs over: all of them up to `count`
+// if dense, otherwise the first `count` entries of `rows`, in order
+struct Selection {
+    bool dense = true;
+    std::uint32_t count = 0;
+    std::array<std::uint16_t, batch_size> rows;
+};
+
+// What the kernels work on: a pointer to the values of the current batch
+// for every register, and the selections
+struct Frame {
+    std::vector<void*> data;
+    std::vector<Selection> selections;
+
+    template<typename T>
+    T* at(std::uint32_t reg) {
+        return static_cast<T*>(data[reg]);
+    }
+};
+
+struct Step;
+
+using Kernel = void (*)(const Step& step, Frame& frame);
+
+// dst = a op b over the rows of the selection `sel`. A split instead divides
+// `sel` into the rows where a op b holds, `on_true`, and the others, `on_false`.
+struct Step {
+    Kernel kernel;
+    std::uint32_t sel = 0, dst = 0, a = 0, b = 0;
+    std::uint32_t on_true = 0, on_false = 0;
+    std::size_t begin_pos = 0, end_pos = 0; // of the operator, for errors
+};
+
+// The loops are kept plain so that the compiler vectorizes the dense ones
+template<typename Out, typename In, typename Op>
+void binary(const Step& step, Frame& frame) {
+    auto* out = frame.at<Out>(step.dst);
+    const auto* x = frame.at<const In>(step.a);
+    const auto* y = frame.at<const In>(step.b);
+    const auto& sel = frame.selections[step.sel];
+    if(sel.dense) {
+        for(std::uint32_t i = 0; i < sel.count; i++)
+            out[i] = Op::apply(x[i], y[i]);
+    } else {
+        for(std::uint32_t k = 0; k < sel.count; k++) {
+            auto i = sel.rows[k];
+            out[i] = Op::apply(x[i], y[i]);
+        }
+    }
+}
+
+template<typename T, typename Op>
+void unary(const Step& step, Frame& frame) {
+    auto* out = frame.at<T>(step.dst);
+    const auto* x = frame.at<const T>(step.a);
+    const auto& sel = frame.selections[step.sel];
+    if(sel.dense) {
+        for(std::uint32_t i = 0; i < sel.count; i++)
+            out[i] = Op::apply(x[i]);
+    } else {
+        for(std::uint32_t k = 0; k < sel.count; k++) {
+            auto i = sel.rows[k];
+            out[i] = Op::apply(x[i]);
+        }
+    }
+}
+
+// Branch-free: every row is written to both selections, and counted in one
+template<typename T, typename Op>
+void split(const Step& step, Frame& frame) {
+    const auto* x = frame.at<const T>(step.a);
+    const auto* y = frame.at<const T>(step.b);
+    const auto& sel = frame.selections[step.sel];
+    auto& on_true = frame.selections[step.on_true];
+    auto& on_false = frame.selections[step.on_false];
+    std::uint32_t t = 0, f = 0;
+    auto add = [&](std::uint16_t i) {
+        bool cond = Op::apply(x[i], y[i]);
+        on_true.rows[t] = i;
+        on_false.rows[f] = i;
+        t += cond;
+        f += !cond;
+    };
+    if(sel.dense) {
+        for(std::uint32_t i = 0; i < sel.count; i++)
+            add(static_cast<std::uint16_t>(i));
+    } else {
+        for(std::uint32_t k = 0; k < sel.count; k++)
+            add(sel.rows[k]);
+    }
+    on_true.count = t;
+    on_false.count = f;
+    // A branch taken by every row of a dense batch stays dense
+    on_true.dense = sel.dense && f == 0;
+    on_false.dense = sel.dense && t == 0;
+}
+
+// As DIV_INT in the VM: fails on zero, and wraps around for INT64_MIN / -1
+void divide_int(const Step& step, Frame& frame) {
+    auto* out = frame.at<std::int64_t>(step.dst);
+    const auto* x = frame.at<const std::int64_t>(step.a);
+    const auto* y = frame.at<const std::int64_t>(step.b);
+    const auto& sel = frame.selections[step.sel];
+    auto divide = [&](std::uint32_t i) {
+        if(y[i] == 0)
+            throw RuntimeException{.begin_pos = step.begin_pos, .end_pos = step.end_pos, .error = int_arithmetic::division_by_zero};
+        out[i] = int_arithmetic::divide(x[i], y[i]);
+    };
+    if(sel.dense) {
+        for(std::uint32_t i = 0; i < sel.count; i++)
+            divide(i);
+    } else {
+        for(std::uint32_t k = 0; k < sel.count; k++)
+            divide(sel.rows[k]);
+    }
+}
+
+struct Add {
+    static std::int64_t apply(std::int64_t a, std::int64_t b) { return int_arithmetic::add(a, b); }
+    static double apply(double a, double b) { return a + b; }
+};
+struct Sub {
+    static std::int64_t apply(std::int64_t a, std::int64_t b) { return int_arithmetic::sub(a, b); }
+    static double apply(double a, double b) { return a - b; }
+};
+struct Mul {
+    static std::int64_t apply(std::int64_t a, std::int64_t b) { return int_arithmetic::mul(a, b); }
+    static double apply(double a, double b) { return a * b; }
+};
+struct Div {
+    static double apply(double a, double b) { return a / b; }
+};
+struct Equal {
+    template<typename T> static bool apply(T a, T b) { return a == b; }
+};
+struct NotEqual {
+    template<typename T> static bool apply(T a, T b) { return a != b; }
+};
+struct Less {
+    template<typename T> static bool apply(T a, T b) { return a < b; }
+};
+struct Greater {
+    template<typename T> static bool apply(T a, T b) { return a > b; }
+};
+struct Negate {
+    static std::int64_t apply(std::int64_t a) { return int_arithmetic::negate(a); }
+    static double apply(double a) { return -a; }
+};
+struct Not {
+    static bool apply(bool a) { return !a; }
+};
+struct Copy {
+    template<typename T> static T apply(T a) { return a; }
+};
+
+struct BinaryKernel {
+    TokenType token;
+    ValueType operands;
+    ValueType result;
+    Kernel kernel;
+    Kernel split = nullptr; // for comparisons
+};
+
+template<typename T, typename Op>
+constexpr BinaryKernel comparison(TokenType token, ValueType operands) {
+    return {token, operands, BOOL, binary<bool, T, Op>, split<T, Op>};
+}
+
+constexpr BinaryKernel binary_kernels[] = {
+    {PLUS, INT, INT, binary<std::int64_t, std::int64_t, Add>},
+    {MINUS, INT, INT, binary<std::int64_t, std::int64_t, Sub>},
+    {STAR, INT, INT, binary<std::int64_t, std::int64_t, Mul>},
+    {DIV, INT, INT, divide_int},
+    {PLUS, REAL, REAL, binary<double, double, Add>},
+    {MINUS, REAL, REAL, binary<double, double, Sub>},
+    {STAR, REAL, REAL, binary<double, double, Mul>},
+    {DIV, REAL, REAL, binary<double, double, Div>},
+    comparison<std::int64_t, Equal>(EQUALS, INT),
+    comparison<std::int64_t, NotEqual>(NOT_EQ, INT),
+    comparison<std::int64_t, Less>(LESS_THAN, INT),
+    comparison<std::int64_t, Greater>(GREATER_THAN, INT),
+    comparison<double, Equal>(EQUALS, REAL),
+    comparison<double, NotEqual>(NOT_EQ, REAL),
+    comparison<double, Less>(LESS_THAN, REAL),
+    comparison<double, Greater>(GREATER_THAN, REAL),
+    comparison<bool, Equal>(EQUALS, BOOL),
+    comparison<bool, NotEqual>(NOT_EQ, BOOL),
+};
+
+struct UnaryKernel {
+    TokenType token;
+    ValueType operand;
+    Kernel kernel;
+};
+
+constexpr UnaryKernel unary_kernels[] = {
+    {MINUS, INT, unary<std::int64_t, Negate>},
+    {MINUS, REAL, unary<double, Negate>},
+    {NOT, BOOL, unary<bool, Not>},
+};
+
+Kernel copy_kernel(ValueType type) {
+    if(type == INT)
+        return unary<std::int64_t, Copy>;
+    if(type == REAL)
+        return unary<double, Copy>;
+    return unary<bool, Copy>;
+}
+
+// A register holds the values of a batch: of a column, of the output,
+// or of a buffer for temporaries and constants
+struct Register {
+    enum Kind : std::uint8_t {COLUMN, OUTPUT, BUFFER} kind;
+    std::uint32_t index;
+};
+
+struct alignas(64) Buffer {
+    std::byte bytes[batch_size * sizeof(std::int64_t)];
+};
+
+struct PipelineState {
+    std::vector<Step> steps;
+    std::vector<Register> registers;
+    std::vector<Buffer> buffers;
+    Frame frame;
+};
+
+// Thrown when the expression needs the VM
+struct Unsupported {};
+
+// Temporaries are allocated like a stack, as in the bytecode compiler:
+// a buffer is reused once the value in it has been used
+struct PipelineCompiler {
+    PipelineCompiler(PipelineState& pipeline, std::span<const Parameter> params) :
+        pipeline_(pipeline),
+        params_(params)
+    {}
+
+    void compile(const AstNode& expr) {
+        pipeline_.frame.selections.emplace_back();
+        auto output = newRegister({Register::OUTPUT, 0});
+        for(std::size_t i = 0; i < params_.size(); i++)
+            param_regs_.push_back(newRegister({Register::COLUMN, static_cast<std::uint32_t>(i)}));
+        auto res = this->expr(expr, 0, output);
+        if(res.type != INT && res.type != REAL && res.type != BOOL)
+            throw Unsupported{};
+    }
+
+private:
+    struct Operand {
+        ValueType type;
+        std::uint32_t reg;
+    };
+
+    std::uint32_t newRegister(Register reg) {
+        pipeline_.registers.push_back(reg);
+        return static_cast<std::uint32_t>(pipeline_.registers.size() - 1);
+    }
+
+    std::uint32_t newBuffer() {
+        pipeline_.buffers.emplace_back();
+        return newRegister({Register::BUFFER, static_cast<std::uint32_t>(pipeline_.buffers.size() - 1)});
+    }
+
+    std::uint32_t temp() {
+        if(top_ == temps_.size())
+            temps_.push_back(newBuffer());
+        return temps_[top_++];
+    }
+
+    std::uint32_t selection() {
+        pipeline_.frame.selections.emplace_back();
+        return static_cast<std::uint32_t>(pipeline_.frame.selections.size() - 1);
+    }
+
+    void emit(Step step) {
+        pipeline_.steps.push_back(step);
+    }
+
+    // Filled once, with the constant in every row
+    template<typename T>
+    Operand constant(ValueType type, T value, std::uint64_t bits) {
+        auto [it, inserted] = constants_.try_emplace({type, bits}, 0);
+        if(inserted) {
+            it->second = newBuffer();
+            auto& buffer = pipeline_.buffers[pipeline_.registers[it->second].index];
+            std::ranges::fill(std::span(reinterpret_cast<T*>(buffer.bytes), batch_size), value);
+        }
+        return {type, it->second};
+    }
+
+    // Moves the value into dst, if one is given
+    Operand into(Operand value, std::uint32_t sel, std::optional<std::uint32_t> dst) {
+        if(!dst || *dst == value.reg)
+            return value;
+        emit({.kernel = copy_kernel(value.type), .sel = sel, .dst = *dst, .a = value.reg});
+        return {value.type, *dst};
+    }
+
+    Operand expr(const AstNode& node, std::uint32_t sel, std::optional<std::uint32_t> dst) {
+        return visit_ast_node(node, [&](const auto& body) {
+            return expr(body, sel, dst);
+        });
+    }
+
+    Operand expr(const AstNodeBody<LITERAL_EXPR>& body, std::uint32_t sel, std::optional<std::uint32_t> dst) {
+        const auto& tok = body.body;
+        if(tok.tokenType == IDENTIFIER)
+            return into(lookup(std::get<std::string>(tok.payload)), sel, dst);
+        // The literals have been checked by compile_expression()
+        if(tok.tokenType == NATURAL_NUMBER) {
+            auto value = std::get<std::uint64_t>(tok.payload);
+            return into(constant(INT, static_cast<std::int64_t>(value), value), sel, dst);
+        }
+        if(tok.tokenType == REAL_NUMBER) {
+            auto value = std::get<double>(tok.payload);
+            return into(constant(REAL, value, std::bit_cast<std::uint64_t>(value)), sel, dst);
+        }
+        if(tok.tokenType == TRUE || tok.tokenType == FALSE)
+            return into(constant(BOOL, tok.tokenType == TRUE, tok.tokenType == TRUE), sel, dst);
+        throw Unsupported{};
+    }
+
+    Operand expr(const AstNodeBody<UNARY_EXPR>& body, std::uint32_t sel, std::optional<std::uint32_t> dst) {
+        auto reg = dst ? *dst : temp();
+        auto mark = top_;
+        auto operand = expr(*body.expr, sel, {});
+        top_ = mark;
+        for(const auto& op : unary_kernels) {
+            if(op.token == body.op.tokenType && op.operand == operand.type) {
+                emit({.kernel = op.kernel, .sel = sel, .dst = reg, .a = operand.reg});
+                return {operand.type, reg};
+            }
+        }
+        throw Unsupported{};
+    }
+
+    Operand expr(const AstNodeBody<BINARY_EXPR>& body, std::uint32_t sel, std::optional<std::uint32_t> dst) {
+        auto reg = dst ? *dst : temp();
+        auto mark = top_;
+        auto [op, lhs, rhs] = operands(body, sel);
+        top_ = mark;
+        emit({.kernel = op.kernel, .sel = sel, .dst = reg, .a = lhs, .b = rhs, .begin_pos = body.op.begin_pos, .end_pos = body.op.end_pos});
+        return {op.result, reg};
+    }
+
+    std::tuple<const BinaryKernel&, std::uint32_t, std::uint32_t> operands(const AstNodeBody<BINARY_EXPR>& body, std::uint32_t sel) {
+        auto lhs = expr(*body.lhs, sel, {});
+        auto rhs = expr(*body.rhs, sel, {});
+        for(const auto& op : binary_kernels) {
+            if(op.token == body.op.tokenType && op.operands == lhs.type && op.operands == rhs.type)
+                return {op, lhs.reg, rhs.reg};
+        }
+        throw Unsupported{};
+    }
+
+    // The branches write their rows of the same register
+    Operand expr(const AstNodeBody<IF_EXPR>& body, std::uint32_t sel, std::optional<std::uint32_t> dst) {
+        if(!body.on_false)
+            throw Unsupported{};
+        auto reg = dst ? *dst : temp();
+        auto mark = top_;
+        auto on_true = selection(), on_false = selection();
+
+        // A comparison splits the rows right away, without a column of bools.
+        // The condition is BOOL, so a binary operator there is a comparison.
+        auto [kernel, lhs, rhs] = [&]() -> std::tuple<Kernel, std::uint32_t, std::uint32_t> {
+            if(body.cond->type() == BINARY_EXPR) {
+                auto [op, l, r] = operands(body_of<BINARY_EXPR>(*body.cond), sel);
+                return {op.split, l, r};
+            }
+            auto cond = expr(*body.cond, sel, {});
+            return {split<bool, NotEqual>, cond.reg, constant(BOOL, false, 0).reg};
+        }();
+        emit({.kernel = kernel, .sel = sel, .a = lhs, .b = rhs, .on_true = on_true, .on_false = on_false});
+        top_ = mark;
+
+        auto res = expr(*body.on_true, on_true, reg);
+        top_ = mark;
+        expr(*body.on_false, on_false, reg);
+        top_ = mark;
+        return res;
+    }
+
+    // Only variable declarations, computed over the rows of the block
+    Operand expr(const AstNodeBody<COMPOUND_EXPR>& body, std::uint32_t sel, std::optional<std::uint32_t> dst) {
+        if(!body.last)
+            throw Unsupported{};
+        auto reg = dst ? *dst : temp();
+        auto mark = top_;
+        auto declared = declared_.size();
+        for(const auto& elem : body.preface) {
+            const auto* decl = std::get_if<DeclPtr>(&elem);
+            if(!decl || (*decl)->type() != VARIABLE_DECL)
+                throw Unsupported{};
+            const auto& var = body_of<VARIABLE_DECL>(**decl);
+            auto value = expr(*var.value, sel, temp());
+            const auto& name = std::get<std::string>(var.name.payload);
+            locals_[name].push_back(value);
+            declared_.push_back(name);
+        }
+        auto res = expr(*body.last, sel, reg);
+        while(declared_.size() > declared) {
+            locals_[declared_.back()].pop_back();
+            declared_.pop_back();
+        }
+        top_ = mark;
+        return res;
+    }
+
+    template<AstNodeType type>
+    Operand expr(const AstNodeBody<type>&, std::uint32_t, std::optional<std::uint32_t>) {
+        throw Unsupported{};
+    }
+
+    Operand lookup(const std::string& name) {
+        if(auto it = locals_.find(name); it != locals_.end() && !it->second.empty())
+            return it->second.back();
+        auto it = std::ranges::find(params_.rbegin(), params_.rend(), name, &Parameter::name);
+        if(it == params_.rend())
+            throw Unsupported{};
+        auto index = static_cast<std::size_t>(params_.rend() - it - 1);
+        return {it->type, param_regs_[index]};
+    }
+
+    PipelineState& pipeline_;
+    std::span<const Parameter> params_;
+    std::vector<std::uint32_t> param_regs_;
+    std::vector<std::uint32_t> temps_;
+    std::size_t top_ = 0;
+    std::map<std::pair<ValueType, std::uint64_t>, std::uint32_t> constants_;
+    std::unordered_map<std::string, std::vector<Operand>> locals_;
+    std::vector<std::string> declared_;
+};
+
+std::size_t size_of(ValueType type) {
+    return type == BOOL ? sizeof(bool) : sizeof(std::int64_t);
+}
+
+std::size_t column_size(const BatchColumn& column) {
+    return std::visit([](auto values) { return values.size(); }, column);
+}
+
+// Where the rows start, writable only for the output
+void* column_data(const BatchColumn& column, std::size_t row) {
+    return std::visit([row](auto values) {
+        return const_cast<void*>(static_cast<const void*>(values.data() + row));
+    }, column);
+}
+
+ValueType column_type(const BatchColumn& column) {
+    constexpr ValueType types[] = {INT, REAL, BOOL};
+    return types[column.index()];
+}
+
+}
+
+struct BatchFunction::Pipeline : PipelineState {};
+
+BatchFunction::BatchFunction(Program program, std::span<const Parameter> params) :
+    program_(std::move(program))
+{
+    for(const auto& param : params)
+        parameter_types_.push_back(param.type);
+}
+
+BatchFunction::BatchFunction(BatchFunction&& other) noexcept = default;
+BatchFunction& BatchFunction::operator=(BatchFunction&& other) noexcept = default;
+BatchFunction::~BatchFunction() = default;
+
+void BatchFunction::operator()(std::span<const BatchColumn> columns, std::span<std::int64_t> out) {
+    run(columns, out.data(), out.size(), INT);
+}
+
+void BatchFunction::operator()(std::span<const BatchColumn> columns, std::span<double> out) {
+    run(columns, out.data(), out.size(), REAL);
+}
+
+void BatchFunction::operator()(std::span<const BatchColumn> columns, std::span<bool> out) {
+    run(columns, out.data(), out.size(), BOOL);
+}
+
+void BatchFunction::run(std::span<const BatchColumn> columns, void* out, std::size_t rows, ValueType type) {
+    if(type != program_.result_type)
+        throw std::invalid_argument("Wrong output type for a BatchFunction");
+    if(columns.size() != parameter_types_.size())
+        throw std::invalid_argument("Wrong number of columns for a BatchFunction");
+    for(std::size_t i = 0; i < columns.size(); i++) {
+        if(column_type(columns[i]) != parameter_types_[i])
+            throw std::invalid_argument("Wrong column type for a BatchFunction");
+        if(column_size(columns[i]) != rows)
+            throw std::invalid_argument("Columns of a BatchFunction must be as long as the output");
+    }
+
+    if(!pipeline_) {
+        runRows(columns, out, rows);
+        return;
+    }
+
+    auto& frame = pipeline_->frame;
+    auto* output = static_cast<std::byte*>(out);
+    for(std::size_t begin = 0; begin < rows; begin += batch_size) {
+        for(std::size_t reg = 0; reg < pipeline_->registers.size(); reg++) {
+            auto [kind, index] = pipeline_->registers[reg];
+            if(kind == Register::COLUMN)
+                frame.data[reg] = column_data(columns[index], begin);
+            else if(kind == Register::OUTPUT)
+                frame.data[reg] = output + begin * size_of(type);
+        }
+        frame.selections[0].count = static_cast<std::uint32_t>(std::min(batch_size, rows - begin));
+
+        for(const auto& step : pipeline_->steps) {
+            // Splits run even without rows, so that their selections are emptied
+            if(frame.selections[step.sel].count > 0 || step.on_true != 0)
+                step.kernel(step, frame);
+        }
+    }
+}
+
+void BatchFunction::runRows(std::span<const BatchColumn> columns, void* out, std::size_t rows) {
+    std::vector<Slot> args(columns.size());
+    for(std::size_t row = 0; row < rows; row++) {
+        for(std::size_t i = 0; i < columns.size(); i++) {
+            std::visit([&](auto values) {
+                using T = typename decltype(values)::value_type;
+                if constexpr (std::is_same_v<T, std::int64_t>)
+                    args[i].integer = values[row];
+                else if constexpr (std::is_same_v<T, double>)
+                    args[i].real = values[row];
+                else
+                    args[i].boolean = values[row];
+            }, columns[i]);
+        }
+        auto value = vm_.run(program_, args);
+        if(auto* integer = std::get_if<std::int64_t>(&value))
+            static_cast<std::int64_t*>(out)[row] = *integer;
+        else if(auto* real = std::get_if<double>(&value))
+            static_cast<double*>(out)[row] = *real;
+        else
+            static_cast<bool*>(out)[row] = std::get<bool>(value);
+    }
+}
+
+BatchFunction batch_compile(const AstNode& expr, std::span<const Parameter> params) {
+    BatchFunction res(compile_expression(expr, params), params);
+    auto pipeline = std::make_unique<BatchFunction::Pipeline>();
+    try {
+        PipelineCompiler(*pipeline, params).compile(expr);
+    } catch(const Unsupported&) {
+        return res;
+    }
+
+    // The buffers do not move from now on
+    pipeline->frame.data.resize(pipeline->registers.size());
+    for(std::size_t reg = 0; reg < pipeline->registers.size(); reg++) {
+        auto [kind, index] = pipeline->registers[reg];
+        if(kind == Register::BUFFER)
+            pipeline->frame.data[reg] = pipeline->buffers[index].bytes;
+    }
+    res.pipeline_ = std::move(pipeline);
+    return res;
+}
+
+}
@@ -0,0 +1,474 @@
+#include "mycomp/bytecode.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+
+#include <fmt/core.h>
+#include <magic_enum.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace mycomp {
+
+namespace {
+
+using enum AstNodeType;
+using enum TokenType;
+using enum ValueType;
+
+using Reg = std::uint16_t;
+
+struct BinaryOp {
+    TokenType token;
+    ValueType operands;
+    OpCode op;
+    ValueType result;
+};
+
+constexpr BinaryOp binary_ops[] = {
+    {PLUS, INT, OpCode::ADD_INT, INT},
+    {MINUS, INT, OpCode::SUB_INT, INT},
+    {STAR, INT, OpCode::MUL_INT, INT},
+    {DIV, INT, OpCode::DIV_INT, INT},
+    {PLUS, REAL, OpCode::ADD_REAL, REAL},
+    {MINUS, REAL, OpCode::SUB_REAL, REAL},
+    {STAR, REAL, OpCode::MUL_REAL, REAL},
+    {DIV, REAL, OpCode::DIV_REAL, REAL},
+    {EQUALS, INT, OpCode::EQ_INT, BOOL},
+    {NOT_EQ, INT, OpCode::NE_INT, BOOL},
+    {LESS_THAN, INT, OpCode::LT_INT, BOOL},
+    {GREATER_THAN, INT, OpCode::GT_INT, BOOL},
+    {EQUALS, REAL, OpCode::EQ_REAL, BOOL},
+    {NOT_EQ, REAL, OpCode::NE_REAL, BOOL},
+    {LESS_THAN, REAL, OpCode::LT_REAL, BOOL},
+    {GREATER_THAN, REAL, OpCode::GT_REAL, BOOL},
+    {EQUALS, BOOL, OpCode::EQ_BOOL, BOOL},
+    {NOT_EQ, BOOL, OpCode::NE_BOOL, BOOL},
+};
+
+struct UnaryOp {
+    TokenType token;
+    ValueType operand;
+    OpCode op;
+};
+
+constexpr UnaryOp unary_ops[] = {
+    {MINUS, INT, OpCode::NEG_INT},
+    {MINUS, REAL, OpCode::NEG_REAL},
+    {NOT, BOOL, OpCode::NOT_BOOL},
+};
+
+// The span of all the tokens of a node, for errors
+struct SourceSpan : StaticAstVisitor<SourceSpan> {
+    std::size_t begin = std::numeric_limits<std::size_t>::max(), end = 0;
+
+    void add(const Token& tok) {
+        begin = std::min(begin, tok.begin_pos);
+        end = std::max(end, tok.end_pos);
+    }
+
+    template<AstNodeType type>
+    void visit(const AstNodeBody<type>& body) {
+        if constexpr (type == PRIMITIVE_TYPE || type == LITERAL_EXPR)
+            add(body.body);
+        else if constexpr (type == FUNCTION_DECL || type == VARIABLE_DECL)
+            add(body.name);
+        else if constexpr (type == ASSIGNMENT_STMT)
+            add(body.var);
+        else if constexpr (type == UNARY_EXPR || type == BINARY_EXPR)
+            add(body.op);
+        visitChildren(body);
+    }
+};
+
+struct HasAssignment : StaticAstVisitor<HasAssignment> {
+    bool found = false;
+
+    void visit(const AstNodeBody<ASSIGNMENT_STMT>&) {
+        found = true;
+    }
+    template<AstNodeType type>
+    void visit(const AstNodeBody<type>& body) {
+        if(!found)
+            visitChildren(body);
+    }
+};
+
+bool has_value(ValueType type) {
+    return type != UNIT && type != NEVER;
+}
+
+// Registers are allocated like a stack: a variable keeps its register
+// until the end of its block, a temporary until its value is used.
+// An expression is compiled into the register `dst` if one is given,
+// otherwise into whatever register is the cheapest: a variable is read
+// where it is, without a MOVE.
+struct Compiler {
+    Program program;
+
+    void module(const AstNodeBody<MODULE>& body) {
+        for(const auto& decl : body.decls) {
+            if(decl->type() != VARIABLE_DECL)
+                continue;
+            const auto& var = body_of<VARIABLE_DECL>(*decl);
+            auto local = declare(var);
+            program.globals.push_back({
+                .name = std::get<std::string>(var.name.payload),
+                .reg = local.reg,
+                .type = local.type
+            });
+        }
+        finish();
+    }
+
+    void function(const AstNode& body, std::span<const Parameter> params) {
+        for(const auto& param : params) {
+            std::string name(param.name);
+            locals_[name].push_back({.reg = alloc(), .type = param.type});
+            declared_.push_back(std::move(name));
+        }
+        program.parameter_count = static_cast<std::uint32_t>(params.size());
+        auto res = expr(body, {});
+        if(res.type != NEVER)
+            emitReturn(body, res);
+        finish();
+    }
+
+private:
+    struct Operand {
+        ValueType type = UNIT;
+        Reg reg = 0;
+    };
+
+    struct Local {
+        Reg reg;
+        ValueType type;
+    };
+
+    [[noreturn]] static void fail(const AstNode& node, std::string error) {
+        SourceSpan span;
+        span.visitNode(node);
+        if(span.begin > span.end)
+            span.begin = span.end = 0;
+        throw CompileException{.begin_pos = span.begin, .end_pos = span.end, .error = std::move(error)};
+    }
+
+    Reg alloc() {
+        if(top_ == std::numeric_limits<Reg>::max())
+            throw std::length_error("Too many registers in a bytecode Program");
+        auto res = top_++;
+        program.register_count = std::max<std::uint32_t>(program.register_count, top_);
+        return res;
+    }
+
+    std::uint32_t emit(OpCode op, Reg a = 0, Reg b = 0, Reg c = 0) {
+        if(program.code.size() == std::numeric_limits<std::uint32_t>::max())
+            throw std::length_error("Too much code in a bytecode Program");
+        program.code.push_back(Instruction{.op = op, .a = a, .b = b, .c = c});
+        return static_cast<std::uint32_t>(program.code.size() - 1);
+    }
+
+    // Points the jump at the next instruction to be emitted
+    void patch(std::uint32_t jump) {
+        program.code[jump].setWide(static_cast<std::uint32_t>(program.code.size()));
+    }
+
+    Operand constant(ValueType type, Slot value, std::uint64_t bits, std::optional<Reg> dst) {
+        auto [it, inserted] = constant_ids_.try_emplace({type, bits}, static_cast<std::uint32_t>(program.constants.size()));
+        if(inserted) {
+            if(program.constants.size() == std::numeric_limits<std::uint32_t>::max())
+                throw std::length_error("Too many constants in a bytecode Program");
+            program.constants.push_back(value);
+        }
+        auto reg = dst ? *dst : alloc();
+        program.code[emit(OpCode::LOAD_CONST, reg)].setWide(it->second);
+        return {type, reg};
+    }
+
+    void emitReturn(const AstNode& node, Operand value) {
+        if(result_type_ && *result_type_ != value.type)
+            fail(node, fmt::format(
+                "Returning {} from a program that returns {}",
+                magic_enum::enum_name(value.type), magic_enum::enum_name(*result_type_)
+            ));
+        result_type_ = value.type;
+        emit(OpCode::RETURN, value.reg);
+    }
+
+    void finish() {
+        emit(OpCode::HALT);
+        program.register_count = std::max<std::uint32_t>(program.register_count, 1);
+        program.result_type = result_type_.value_or(UNIT);
+    }
+
+    Local lookup(const AstNode& node, const Token& name) {
+        const auto& text = std::get<std::string>(name.payload);
+        auto it = locals_.find(text);
+        if(it == locals_.end() || it->second.empty())
+            fail(node, fmt::format("Unknown variable {}", text));
+        return it->second.back();
+    }
+
+    void closeScope(std::size_t declared) {
+        while(declared_.size() > declared) {
+            locals_[declared_.back()].pop_back();
+            declared_.pop_back();
+        }
+    }
+
+    ValueType typeOf(const AstNode& node) {
+        const auto& name = std::get<std::string>(body_of<PRIMITIVE_TYPE>(node).body.payload);
+        if(name == "int")
+            return INT;
+        if(name == "real")
+            return REAL;
+        if(name == "bool")
+            return BOOL;
+        fail(node, fmt::format("Unknown type {}", name));
+    }
+
+    void checkType(const AstNode& node, ValueType expected, ValueType actual) {
+        if(actual != NEVER && actual != expected)
+            fail(node, fmt::format("Expected {}, got {}", magic_enum::enum_name(expected), magic_enum::enum_name(actual)));
+    }
+
+
+    // Statements
+
+    void statement(const AstNode& node) {
+        visit_ast_node(node, [&](const auto& body) {
+            statement(node, body);
+        });
+    }
+
+    void statement(const AstNode&, const AstNodeBody<VARIABLE_DECL>& body) {
+        declare(body);
+    }
+
+    void statement(const AstNode&, const AstNodeBody<FUNCTION_DECL>&) {}
+
+    void statement(const AstNode& node, const AstNodeBody<ASSIGNMENT_STMT>& body) {
+        auto local = lookup(node, body.var);
+        auto mark = top_;
+        auto value = expr(*body.value, local.reg);
+        top_ = mark;
+        checkType(*body.value, local.type, value.type);
+    }
+
+    void statement(const AstNode&, const AstNodeBody<EXPR_STMT>& body) {
+        auto mark = top_;
+        expr(*body.body, {});
+        top_ = mark;
+    }
+
+    template<AstNodeType type>
+    void statement(const AstNode& node, const AstNodeBody<type>&) {
+        fail(node, "Expected a statement");
+    }
+
+    Local declare(const AstNodeBody<VARIABLE_DECL>& body) {
+        std::optional<ValueType> declared;
+        if(body.type)
+            declared = typeOf(*body.type);
+
+        // The variable is in scope only after its initializer
+        auto reg = alloc();
+        auto mark = top_;
+        auto value = expr(*body.value, reg);
+        top_ = mark;
+        if(declared)
+            checkType(*body.value, *declared, value.type);
+
+        Local res{.reg = reg, .type = declared.value_or(value.type)};
+        const auto& name = std::get<std::string>(body.name.payload);
+        locals_[name].push_back(res);
+        declared_.push_back(name);
+        return res;
+    }
+
+
+    // Expressions
+
+    Operand expr(const AstNode& node, std::optional<Reg> dst) {
+        return visit_ast_node(node, [&](const auto& body) {
+            return expr(node, body, dst);
+        });
+    }
+
+    Operand expr(const AstNode& node, const AstNodeBody<LITERAL_EXPR>& body, std::optional<Reg> dst) {
+        const auto& tok = body.body;
+        if(tok.tokenType == IDENTIFIER) {
+            auto local = lookup(node, tok);
+            if(dst && *dst != local.reg && has_value(local.type))
+                emit(OpCode::MOVE, *dst, local.reg);
+            return {local.type, dst ? *dst : local.reg};
+        }
+        if(tok.tokenType == NATURAL_NUMBER) {
+            auto value = std::get<std::uint64_t>(tok.payload);
+            if(value > std::uint64_t(std::numeric_limits<std::int64_t>::max()))
+                fail(node, "Integer literal out of range");
+            return constant(INT, Slot{.integer = static_cast<std::int64_t>(value)}, value, dst);
+        }
+        if(tok.tokenType == REAL_NUMBER) {
+            auto value = std::get<double>(tok.payload);
+            return constant(REAL, Slot{.real = value}, std::bit_cast<std::uint64_t>(value), dst);
+        }
+        if(tok.tokenType == TRUE || tok.tokenType == FALSE)
+            return constant(BOOL, Slot{.boolean = tok.tokenType == TRUE}, tok.tokenType == TRUE, dst);
+        fail(node, fmt::format("{} literals are not supported", magic_enum::enum_name(tok.tokenType)));
+    }
+
+    Operand expr(const AstNode& node, const AstNodeBody<UNARY_EXPR>& body, std::optional<Reg> dst) {
+        auto mark = top_;
+        auto operand = expr(*body.expr, {});
+        top_ = mark;
+        if(operand.type == NEVER)
+            return {NEVER};
+
+        for(const auto& op : unary_ops) {
+            if(op.token == body.op.tokenType && op.operand == operand.type) {
+                auto reg = dst ? *dst : alloc();
+                emit(op.op, reg, operand.reg);
+                return {operand.type, reg};
+            }
+        }
+        fail(node, fmt::format(
+            "{} is not defined for {}",
+            magic_enum::enum_name(body.op.tokenType), magic_enum::enum_name(operand.type)
+        ));
+    }
+
+    Operand expr(const AstNode& node, const AstNodeBody<BINARY_EXPR>& body, std::optional<Reg> dst) {
+        auto mark = top_;
+        auto lhs = expr(*body.lhs, {});
+        // A variable read in place would see an assignment in rhs,
+        // which happens after lhs is evaluated
+        if(lhs.reg < mark && has_value(lhs.type)) {
+            HasAssignment assigns;
+            assigns.visitNode(*body.rhs);
+            if(assigns.found) {
+                auto copy = alloc();
+                emit(OpCode::MOVE, copy, lhs.reg);
+                lhs.reg = copy;
+            }
+        }
+        auto rhs = expr(*body.rhs, {});
+        top_ = mark;
+        if(lhs.type == NEVER || rhs.type == NEVER)
+            return {NEVER};
+
+        for(const auto& op : binary_ops) {
+            if(op.token == body.op.tokenType && op.operands == lhs.type && op.operands == rhs.type) {
+                auto reg = dst ? *dst : alloc();
+                auto pc = emit(op.op, reg, lhs.reg, rhs.reg);
+                if(op.op == OpCode::DIV_INT)
+                    program.error_sites.push_back({.pc = pc, .begin_pos = body.op.begin_pos, .end_pos = body.op.end_pos});
+                return {op.result, reg};
+            }
+        }
+        fail(node, fmt::format(
+            "{} is not defined for {} and {}",
+            magic_enum::enum_name(body.op.tokenType), magic_enum::enum_name(lhs.type), magic_enum::enum_name(rhs.type)
+        ));
+    }
+
+    Operand expr(const AstNode&, const AstNodeBody<COMPOUND_EXPR>& body, std::optional<Reg> dst) {
+        // Allocated outside of the block, so that the result outlives its variables
+        auto reg = dst ? *dst : alloc();
+        auto mark = top_;
+        auto declared = declared_.size();
+        for(const auto& elem : body.preface)
+            std::visit([&](const auto& ptr) { statement(*ptr); }, elem);
+        Operand res{UNIT, reg};
+        if(body.last)
+            res = expr(*body.last, reg);
+        closeScope(declared);
+        top_ = mark;
+        return res;
+    }
+
+    Operand expr(const AstNode& node, const AstNodeBody<IF_EXPR>& body, std::optional<Reg> dst) {
+        auto reg = dst ? *dst : alloc();
+        auto mark = top_;
+        auto cond = expr(*body.cond, {});
+        top_ = mark;
+        checkType(*body.cond, BOOL, cond.type);
+        auto to_false = emit(OpCode::JUMP_IF_FALSE, cond.reg);
+
+        if(!body.on_false) {
+            expr(*body.on_true, {});
+            top_ = mark;
+            patch(to_false);
+            return {UNIT, reg};
+        }
+
+        auto on_true = expr(*body.on_true, reg);
+        top_ = mark;
+        std::optional<std::uint32_t> to_end;
+        if(on_true.type != NEVER)
+            to_end = emit(OpCode::JUMP);
+        patch(to_false);
+        auto on_false = expr(*body.on_false, reg);
+        top_ = mark;
+        if(to_end)
+            patch(*to_end);
+
+        if(on_true.type == NEVER)
+            return on_false;
+        if(on_false.type != NEVER && on_false.type != on_true.type)
+            fail(node, fmt::format(
+                "Branches of if have different types {} and {}",
+                magic_enum::enum_name(on_true.type), magic_enum::enum_name(on_false.type)
+            ));
+        return on_true;
+    }
+
+    Operand expr(const AstNode& node, const AstNodeBody<RETURN_EXPR>& body, std::optional<Reg>) {
+        auto mark = top_;
+        Operand res;
+        if(body.result)
+            res = expr(*body.result, {});
+        top_ = mark;
+        if(res.type != NEVER)
+            emitReturn(node, res);
+        return {NEVER};
+    }
+
+    template<AstNodeType type>
+    Operand expr(const AstNode& node, const AstNodeBody<type>&, std::optional<Reg>) {
+        fail(node, "Expected an expression");
+    }
+
+    // Every name maps to its declarations in scope, the innermost last
+    std::unordered_map<std::string, std::vector<Local>> locals_;
+    std::vector<std::string> declared_; // in order, for closing scopes
+    std::map<std::pair<ValueType, std::uint64_t>, std::uint32_t> constant_ids_;
+    std::optional<ValueType> result_type_;
+    Reg top_ = 0; // the registers below are taken
+};
+
+}
+
+Program compile(const AstNodeBody<AstNodeType::MODULE>& module) {
+    Compiler compiler;
+    compiler.module(module);
+    return std::move(compiler.program);
+}
+
+Program compile_expression(const AstNode& expr, std::span<const Parameter> params) {
+    Compiler compiler;
+    compiler.function(expr, params);
+    return std::move(compiler.program);
+}
+
+}
@@ -0,0 +1,180 @@
+#include "mycomp/compile_cache.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/utils/hash.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mycomp {
+
+namespace {
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+struct FileDescriptor {
+    int fd;
+
+    ~FileDescriptor() {
+        if(fd >= 0)
+            ::close(fd);
+    }
+};
+
+// Distinguishes the temporary files of the caches of one process
+std::atomic<std::uint64_t> temp_counter{0};
+
+// Temporary files older than this are left over from writers that crashed
+constexpr auto stale_temp_age = std::chrono::hours(1);
+
+void write_file(const std::filesystem::path& path, const std::vector<std::byte>& bytes) {
+    FileDescriptor file{::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)};
+    if(file.fd < 0)
+        throw_errno("open " + path.string());
+    for(std::size_t done = 0; done < bytes.size();) {
+        auto written = ::write(file.fd, bytes.data() + done, bytes.size() - done);
+        if(written < 0 && errno != EINTR)
+            throw_errno("write " + path.string());
+        if(written > 0)
+            done += static_cast<std::size_t>(written);
+    }
+    // close() reports the errors of delayed writes, e.g. on NFS
+    if(::close(std::exchange(file.fd, -1)) != 0)
+        throw_errno("close " + path.string());
+}
+
+}
+
+CompileCache::CompileCache(std::filesystem::path dir, std::uint64_t max_size) :
+    dir_(std::move(dir)),
+    max_size_(max_size)
+{
+    std::filesystem::create_directories(dir_);
+    evict();
+}
+
+std::filesystem::path CompileCache::entryPath(std::string_view source) const {
+    // Seeded with the version, so that versions sharing a directory do not
+    // replace each other's entries
+    return dir_ / fmt::format("{:016x}.ast", xxh64(source, serialized_ast_version));
+}
+
+std::optional<MappedAst> CompileCache::find(std::string_view source) {
+    auto path = entryPath(source);
+    try {
+        MappedAst entry(path);
+        // The name is only a hash of the source: the entry has to be of the same
+        // source, which a hash with another seed tells apart from a collision
+        if(entry.ast().sourceSize() == source.size() && entry.ast().sourceHash() == xxh64(source)) {
+            // Only a hint for eviction, so failures are ignored
+            ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+            hits_++;
+            return entry;
+        }
+    } catch(const std::system_error& e) {
+        if(e.code() != std::errc::no_such_file_or_directory)
+            throw;
+    } catch(const SerializedAstError&) {
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+    }
+    misses_++;
+    return std::nullopt;
+}
+
+void CompileCache::store(std::string_view source, const FlatAst& ast) {
+    auto bytes = serialize(ast, source);
+    auto path = entryPath(source);
+    auto temp = path;
+    temp += fmt::format(".{}.{}.tmp", ::getpid(), temp_counter.fetch_add(1, std::memory_order_relaxed));
+    try {
+        write_file(temp, bytes);
+        // Replaces an entry that another process stored meanwhile,
+        // which has the same contents
+        std::filesystem::rename(temp, path);
+    } catch(...) {
+        std::error_code ignored;
+        std::filesystem::remove(temp, ignored);
+        throw;
+    }
+
+    size_ += bytes.size();
+    if(size_ > max_size_)
+        evict();
+}
+
+AstPtr<AstCategoryType::MODULE> CompileCache::parse(std::string_view source) {
+    if(auto entry = find(source))
+        return unflatten(entry->ast());
+    auto module = mycomp::parse(source);
+    store(source, flatten(body_of<AstNodeType::MODULE>(*module)));
+    return module;
+}
+
+void CompileCache::evict() {
+    // Held until the descriptor is closed
+    auto lock_path = dir_ / "lock";
+    FileDescriptor lock{::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)};
+    if(lock.fd < 0)
+        throw_errno("open " + lock_path.string());
+    while(::flock(lock.fd, LOCK_EX) != 0) {
+        if(errno != EINTR)
+            throw_errno("flock " + lock_path.string());
+    }
+
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type time;
+        std::uint64_t size;
+    };
+    std::vector<Entry> entries;
+    std::uint64_t total = 0;
+    auto now = std::filesystem::file_time_type::clock::now();
+    for(const auto& file : std::filesystem::directory_iterator(dir_)) {
+        // Entries that are removed meanwhile, by a find() that could not read
+        // them, are skipped
+        std::error_code ec;
+        auto extension = file.path().extension();
+        if(extension != ".ast" && extension != ".tmp")
+            continue;
+        auto time = file.last_write_time(ec);
+        if(ec)
+            continue;
+        if(extension == ".tmp") {
+            if(now - time > stale_temp_age)
+                std::filesystem::remove(file.path(), ec);
+            continue;
+        }
+        auto size = file.file_size(ec);
+        if(ec)
+            continue;
+        entries.push_back({.path = file.path(), .time = time, .size = size});
+        total += size;
+    }
+
+    std::ranges::sort(entries, {}, &Entry::time);
+    auto limit = max_size_ / 4 * 3;
+    for(auto it = entries.begin(); total > limit && it != entries.end(); ++it) {
+        std::error_code ec;
+        std::filesystem::remove(it->path, ec);
+        total -= it->size;
+    }
+    size_ = total;
+}
+
+}
@@ -0,0 +1,249 @@
+#include "mycomp/flat_ast.hpp"
+#include "mycomp/serialized_ast.hpp"
+#include "mycomp/ast_visitor.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace mycomp {
+
+using enum AstNodeType;
+
+bool FlatAst::operator==(const FlatAst& other) const {
+    if(nodes_ != other.nodes_ || lists_ != other.lists_ || tokens_.size() != other.tokens_.size())
+        return false;
+    for(std::size_t i = 0; i < tokens_.size(); i++)
+        if(tokens_[i] != other.tokens_[i])
+            return false;
+    return true;
+}
+
+
+namespace {
+
+struct Flattener : AstVisitor {
+    std::vector<FlatNode>& nodes;
+    std::vector<FlatNodeId>& lists;
+    TokenStream& tokens;
+
+    Flattener(std::vector<FlatNode>& nodes_, std::vector<FlatNodeId>& lists_, TokenStream& tokens_) :
+        nodes(nodes_), lists(lists_), tokens(tokens_)
+    {}
+
+    void visit(const AstNodeBody<MODULE>& v) override {
+        auto decls = flattenAll(v.decls);
+        add(MODULE, no_flat_token, {appendList(decls), std::uint32_t(decls.size())});
+    }
+    void visit(const AstNodeBody<PRIMITIVE_TYPE>& v) override {
+        add(PRIMITIVE_TYPE, addToken(v.body));
+    }
+
+    void visit(const AstNodeBody<FUNCTION_DECL>& v) override {
+        auto type = flatten(v.type);
+        add(FUNCTION_DECL, addToken(v.name), {type});
+    }
+    void visit(const AstNodeBody<VARIABLE_DECL>& v) override {
+        auto type = flatten(v.type);
+        auto value = flatten(v.value);
+        add(VARIABLE_DECL, addToken(v.name), {type, value});
+    }
+
+    void visit(const AstNodeBody<ASSIGNMENT_STMT>& v) override {
+        auto value = flatten(v.value);
+        add(ASSIGNMENT_STMT, addToken(v.var), {value});
+    }
+    void visit(const AstNodeBody<EXPR_STMT>& v) override {
+        auto body = flatten(v.body);
+        add(EXPR_STMT, no_flat_token, {body});
+    }
+
+    void visit(const AstNodeBody<UNARY_EXPR>& v) override {
+        auto expr = flatten(v.expr);
+        add(UNARY_EXPR, addToken(v.op), {expr});
+    }
+    void visit(const AstNodeBody<BINARY_EXPR>& v) override {
+        auto lhs = flatten(v.lhs);
+        auto rhs = flatten(v.rhs);
+        add(BINARY_EXPR, addToken(v.op), {lhs, rhs});
+    }
+    void visit(const AstNodeBody<COMPOUND_EXPR>& v) override {
+        std::vector<FlatNodeId> preface;
+        preface.reserve(v.preface.size());
+        for(const auto& elem : v.preface)
+            preface.push_back(FlatNodeId{std::visit([this](const auto& ptr) { return flatten(ptr); }, elem)});
+        auto last = flatten(v.last);
+        add(COMPOUND_EXPR, no_flat_token, {appendList(preface), std::uint32_t(preface.size()), last});
+    }
+    void visit(const AstNodeBody<IF_EXPR>& v) override {
+        auto cond = flatten(v.cond);
+        auto on_true = flatten(v.on_true);
+        auto on_false = flatten(v.on_false);
+        add(IF_EXPR, no_flat_token, {cond, on_true, on_false});
+    }
+    void visit(const AstNodeBody<RETURN_EXPR>& v) override {
+        auto result = flatten(v.result);
+        add(RETURN_EXPR, no_flat_token, {result});
+    }
+    void visit(const AstNodeBody<LITERAL_EXPR>& v) override {
+        add(LITERAL_EXPR, addToken(v.body));
+    }
+
+private:
+    template<typename Ptr>
+    std::uint32_t flatten(const Ptr& ptr) {
+        if(!ptr)
+            return std::uint32_t(FlatNodeId::NONE);
+        ptr->acceptVisitor(*this);
+        return static_cast<std::uint32_t>(nodes.size() - 1);
+    }
+
+    template<typename Ptr>
+    std::vector<FlatNodeId> flattenAll(const std::vector<Ptr>& ptrs) {
+        std::vector<FlatNodeId> res;
+        res.reserve(ptrs.size());
+        for(const auto& ptr : ptrs)
+            res.push_back(FlatNodeId{flatten(ptr)});
+        return res;
+    }
+
+    // Lists are appended only after all of their elements have been flattened,
+    // so that the lists of nested nodes do not interleave with them
+    std::uint32_t appendList(const std::vector<FlatNodeId>& list) {
+        auto begin = static_cast<std::uint32_t>(lists.size());
+        lists.insert(lists.end(), list.begin(), list.end());
+        return begin;
+    }
+
+    std::uint32_t addToken(const Token& token) {
+        auto* text = std::get_if<std::string>(&token.payload);
+        tokens.push_back(token, text ? std::string_view(*text) : std::string_view{});
+        return static_cast<std::uint32_t>(tokens.size() - 1);
+    }
+
+    // Children that are not given are FlatNodeId::NONE
+    void add(AstNodeType type, std::uint32_t token, std::initializer_list<std::uint32_t> children = {}) {
+        FlatNode node{.type=type, .token=token};
+        std::ranges::copy(children, node.children.begin());
+        nodes.push_back(node);
+    }
+};
+
+}
+
+FlatAst flatten(const AstNodeBody<MODULE>& module) {
+    FlatAst res;
+    Flattener flattener(res.nodes_, res.lists_, res.tokens_);
+    flattener.visit(module);
+    return res;
+}
+
+
+namespace {
+
+// Children come before their parents, so the tree can be rebuilt in one pass
+// over the nodes. Every node has exactly one parent, which takes its pointer.
+// Ast is a FlatAst or a SerializedAst.
+template<typename Ast>
+struct Unflattener {
+    const Ast& ast;
+    AstArena& arena;
+    std::vector<AstNode*> built;
+
+    template<AstCategoryType category>
+    AstPtr<category> take(FlatNodeId id) {
+        if(id == FlatNodeId::NONE)
+            return nullptr;
+        return AstPtr<category>(static_cast<AstCategory<category>*>(built[static_cast<std::uint32_t>(id)]), AstDeleter{.in_arena = true});
+    }
+
+    ExprPtr expr(const FlatNode& node, std::size_t ind) {
+        return take<AstCategoryType::EXPRESSION>(node.child(ind));
+    }
+    TypePtr type(const FlatNode& node, std::size_t ind) {
+        return take<AstCategoryType::TYPE>(node.child(ind));
+    }
+    Token token(const FlatNode& node) {
+        return node.token == no_flat_token ? Token{} : ast.token(node);
+    }
+
+    AstNode* build(const FlatNode& node) {
+        switch(node.type) {
+        case MODULE: {
+            std::vector<DeclPtr> decls;
+            for(auto id : ast.list(node))
+                decls.push_back(take<AstCategoryType::DECLARATION>(id));
+            return arena.create(AstNodeBody<MODULE>{.decls=std::move(decls)});
+        }
+        case PRIMITIVE_TYPE:
+            return arena.create(AstNodeBody<PRIMITIVE_TYPE>{.body=token(node)});
+        case FUNCTION_DECL:
+            return arena.create(AstNodeBody<FUNCTION_DECL>{.name=token(node), .type=type(node, 0)});
+        case VARIABLE_DECL:
+            return arena.create(AstNodeBody<VARIABLE_DECL>{.name=token(node), .type=type(node, 0), .value=expr(node, 1)});
+        case ASSIGNMENT_STMT:
+            return arena.create(AstNodeBody<ASSIGNMENT_STMT>{.var=token(node), .value=expr(node, 0)});
+        case EXPR_STMT:
+            return arena.create(AstNodeBody<EXPR_STMT>{.body=expr(node, 0)});
+        case UNARY_EXPR:
+            return arena.create(AstNodeBody<UNARY_EXPR>{.op=token(node), .expr=expr(node, 0)});
+        case BINARY_EXPR:
+            return arena.create(AstNodeBody<BINARY_EXPR>{.op=token(node), .lhs=expr(node, 0), .rhs=expr(node, 1)});
+        case COMPOUND_EXPR: {
+            AstNodeBody<COMPOUND_EXPR> body;
+            for(auto id : ast.list(node)) {
+                if(ast_category(ast.node(id).type) == AstCategoryType::DECLARATION)
+                    body.preface.emplace_back(take<AstCategoryType::DECLARATION>(id));
+                else
+                    body.preface.emplace_back(take<AstCategoryType::STATEMENT>(id));
+            }
+            body.last = expr(node, 2);
+            return arena.create(std::move(body));
+        }
+        case IF_EXPR:
+            return arena.create(AstNodeBody<IF_EXPR>{.cond=expr(node, 0), .on_true=expr(node, 1), .on_false=expr(node, 2)});
+        case RETURN_EXPR:
+            return arena.create(AstNodeBody<RETURN_EXPR>{.result=expr(node, 0)});
+        case LITERAL_EXPR:
+            return arena.create(AstNodeBody<LITERAL_EXPR>{.body=token(node)});
+        }
+        return nullptr;
+    }
+};
+
+template<typename Ast>
+ModulePtr unflatten_nodes(const Ast& ast) {
+    auto arena = std::make_unique<AstArena>();
+    // A default-constructed FlatAst, without even the module
+    if(ast.nodes().empty())
+        return make_ast_node(AstNodeBody<MODULE>{.arena=std::move(arena), .decls={}});
+    Unflattener<Ast> unflattener{.ast=ast, .arena=*arena, .built={}};
+    unflattener.built.reserve(ast.nodes().size());
+
+    // The root module is not put into the arena, since it has to own the arena
+    auto nodes = ast.nodes().first(ast.nodes().size() - 1);
+    for(const auto& node : nodes)
+        unflattener.built.push_back(unflattener.build(node));
+
+    std::vector<DeclPtr> decls;
+    for(auto id : ast.list(ast.node(ast.root())))
+        decls.push_back(unflattener.template take<AstCategoryType::DECLARATION>(id));
+    return make_ast_node(AstNodeBody<MODULE>{.arena=std::move(arena), .decls=std::move(decls)});
+}
+
+}
+
+ModulePtr unflatten(const FlatAst& ast) {
+    return unflatten_nodes(ast);
+}
+
+ModulePtr unflatten(const SerializedAst& ast) {
+    return unflatten_nodes(ast);
+}
+
+}
@@ -0,0 +1,380 @@
+#include "mycomp/passes.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+#include "mycomp/utils/int_arithmetic.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace mycomp {
+
+namespace {
+
+using enum AstNodeType;
+using enum TokenType;
+
+using Constant = std::variant<std::int64_t, double, bool>;
+
+bool is(const ExprPtr& ptr, AstNodeType type) {
+    return ptr && ptr->type() == type;
+}
+
+// There are no negative literals, so a negative integer is
+// a unary minus over a literal: this is the one form of it
+bool is_negative_literal(const AstNodeBody<UNARY_EXPR>& body) {
+    return body.op.tokenType == MINUS
+        && body.expr->type() == LITERAL_EXPR
+        && body_of<LITERAL_EXPR>(*body.expr).body.tokenType == NATURAL_NUMBER;
+}
+
+std::optional<Constant> literal_value(const Token& tok) {
+    if(tok.tokenType == NATURAL_NUMBER) {
+        auto value = std::get<std::uint64_t>(tok.payload);
+        if(value > std::uint64_t(std::numeric_limits<std::int64_t>::max()))
+            return {}; // left for the compiler to reject
+        return static_cast<std::int64_t>(value);
+    }
+    if(tok.tokenType == REAL_NUMBER)
+        return std::get<double>(tok.payload);
+    if(tok.tokenType == TRUE || tok.tokenType == FALSE)
+        return tok.tokenType == TRUE;
+    return {};
+}
+
+std::optional<Constant> constant_value(const AstNode& node) {
+    if(node.type() == LITERAL_EXPR)
+        return literal_value(body_of<LITERAL_EXPR>(node).body);
+    if(node.type() == UNARY_EXPR && is_negative_literal(body_of<UNARY_EXPR>(node))) {
+        auto value = literal_value(body_of<LITERAL_EXPR>(*body_of<UNARY_EXPR>(node).expr).body);
+        if(value)
+            return -std::get<std::int64_t>(*value);
+    }
+    return {};
+}
+
+// Where a constant, in one of the forms above, is in the source
+std::pair<std::size_t, std::size_t> constant_span(const AstNode& node) {
+    if(node.type() == UNARY_EXPR) {
+        const auto& body = body_of<UNARY_EXPR>(node);
+        return {body.op.begin_pos, body_of<LITERAL_EXPR>(*body.expr).body.end_pos};
+    }
+    const auto& tok = body_of<LITERAL_EXPR>(node).body;
+    return {tok.begin_pos, tok.end_pos};
+}
+
+// Bitwise, so that 0.0 and -0.0 differ
+bool same(const std::optional<Constant>& value, Constant expected) {
+    if(!value || value->index() != expected.index())
+        return false;
+    if(auto* real = std::get_if<double>(&*value))
+        return std::bit_cast<std::uint64_t>(*real) == std::bit_cast<std::uint64_t>(std::get<double>(expected));
+    return *value == expected;
+}
+
+// The same as the VM computes, or nothing if it would fail or is not well typed
+std::optional<Constant> fold_unary(TokenType op, const Constant& value) {
+    if(op == MINUS) {
+        if(auto* integer = std::get_if<std::int64_t>(&value))
+            return int_arithmetic::negate(*integer);
+        if(auto* real = std::get_if<double>(&value))
+            return -*real;
+    }
+    if(op == NOT)
+        if(auto* boolean = std::get_if<bool>(&value))
+            return !*boolean;
+    return {};
+}
+
+std::optional<Constant> fold_binary(TokenType op, const Constant& lhs, const Constant& rhs) {
+    if(lhs.index() != rhs.index())
+        return {};
+    return std::visit([&](auto l) -> std::optional<Constant> {
+        using T = decltype(l);
+        auto r = std::get<T>(rhs);
+        if(op == EQUALS)
+            return l == r;
+        if(op == NOT_EQ)
+            return l != r;
+        if constexpr (!std::is_same_v<T, bool>) {
+            if(op == LESS_THAN)
+                return l < r;
+            if(op == GREATER_THAN)
+                return l > r;
+            if constexpr (std::is_same_v<T, std::int64_t>) {
+                if(op == PLUS)
+                    return int_arithmetic::add(l, r);
+                if(op == MINUS)
+                    return int_arithmetic::sub(l, r);
+                if(op == STAR)
+                    return int_arithmetic::mul(l, r);
+                if(op == DIV && r != 0)
+                    return int_arithmetic::divide(l, r);
+            } else {
+                if(op == PLUS)
+                    return l + r;
+                if(op == MINUS)
+                    return l - r;
+                if(op == STAR)
+                    return l * r;
+                if(op == DIV)
+                    return l / r;
+            }
+        }
+        return {};
+    }, lhs);
+}
+
+// Blocks with fewer items are folded on one thread
+constexpr std::size_t parallel_block_size = 64;
+
+// The workers to fold on, each creating nodes in an arena of its own
+struct ParallelFold {
+    TaskScheduler& scheduler;
+    std::span<AstArena> arenas;
+};
+
+struct Folder {
+    AstArena* arena;
+    const ParallelFold* parallel = nullptr;
+    bool changed = false;
+
+    void foldChildren(AstNode& node) {
+        visit_ast_node(node, [this](auto& body) {
+            foldChildren(body);
+        });
+    }
+
+    template<AstNodeType type>
+    void foldChildren(AstNodeBody<type>& body) {
+        if constexpr (type == MODULE) {
+            foldAll(body.decls, 2, [](Folder& folder, DeclPtr& decl) {
+                folder.foldChildren(*decl);
+            });
+        } else if constexpr (type == VARIABLE_DECL || type == ASSIGNMENT_STMT) {
+            fold(body.value);
+        } else if constexpr (type == EXPR_STMT) {
+            fold(body.body);
+        } else if constexpr (type == UNARY_EXPR) {
+            fold(body.expr);
+        } else if constexpr (type == BINARY_EXPR) {
+            fold(body.lhs);
+            fold(body.rhs);
+        } else if constexpr (type == COMPOUND_EXPR) {
+            foldAll(body.preface, parallel_block_size, [](Folder& folder, auto& elem) {
+                std::visit([&folder](auto& ptr) { folder.foldChildren(*ptr); }, elem);
+            });
+            fold(body.last);
+        } else if constexpr (type == IF_EXPR) {
+            fold(body.cond);
+            fold(body.on_true);
+            fold(body.on_false);
+        } else if constexpr (type == RETURN_EXPR) {
+            fold(body.result);
+        } else {
+            static_assert(type == PRIMITIVE_TYPE || type == FUNCTION_DECL || type == LITERAL_EXPR, "Unhandled node type");
+        }
+    }
+
+    // Bottom up, so that a node sees its children folded
+    void fold(ExprPtr& slot) {
+        if(!slot)
+            return;
+        foldChildren(*slot);
+        if(slot->type() == UNARY_EXPR)
+            foldUnary(slot, body_of<UNARY_EXPR>(*slot));
+        else if(slot->type() == BINARY_EXPR)
+            foldBinary(slot, body_of<BINARY_EXPR>(*slot));
+        else if(slot->type() == IF_EXPR)
+            foldIf(slot, body_of<IF_EXPR>(*slot));
+    }
+
+private:
+    // Declarations and block items fold independently of each other,
+    // so with enough of them every one is a task of its own
+    template<typename T, typename F>
+    void foldAll(std::vector<T>& elems, std::size_t min_parallel, const F& fold_one) {
+        if(!parallel || elems.size() < min_parallel) {
+            for(auto& elem : elems)
+                fold_one(*this, elem);
+            return;
+        }
+        std::vector<char> elem_changed(elems.size());
+        parallel->scheduler.parallelFor(elems.size(), [&](std::size_t i, unsigned worker) {
+            Folder folder{.arena = &parallel->arenas[worker], .parallel = parallel};
+            fold_one(folder, elems[i]);
+            elem_changed[i] = folder.changed;
+        });
+        changed = changed || std::ranges::count(elem_changed, 1) > 0;
+    }
+
+    template<AstNodeType type>
+    AstPtr<AstNodeBody<type>::category> node(AstNodeBody<type> body) {
+        if(arena)
+            return make_ast_node(*arena, std::move(body));
+        return make_ast_node(std::move(body));
+    }
+
+    // `replacement` may be a child of the node being replaced:
+    // it is moved out before the node is dropped
+    void replace(ExprPtr& slot, ExprPtr replacement) {
+        slot = std::move(replacement);
+        changed = true;
+    }
+
+    // INT64_MIN would need a literal the compiler rejects
+    static bool representable(const Constant& value) {
+        auto* integer = std::get_if<std::int64_t>(&value);
+        return !integer || *integer != std::numeric_limits<std::int64_t>::min();
+    }
+
+    // Rewrites `spare`, a literal that goes away with the folded node, if there is one
+    ExprPtr literal(Token tok, ExprPtr& spare) {
+        if(is(spare, LITERAL_EXPR)) {
+            body_of<LITERAL_EXPR>(*spare).body = std::move(tok);
+            return std::move(spare);
+        }
+        return node(AstNodeBody<LITERAL_EXPR>{.body = std::move(tok)});
+    }
+
+    ExprPtr constant(const Constant& value, std::pair<std::size_t, std::size_t> span, ExprPtr& spare) {
+        auto [begin, end] = span;
+        if(auto* integer = std::get_if<std::int64_t>(&value); integer && *integer < 0) {
+            Token minus{MINUS, begin, begin};
+            Token magnitude{NATURAL_NUMBER, begin, end, 0 - int_arithmetic::bits(*integer)};
+            if(is(spare, UNARY_EXPR) && is_negative_literal(body_of<UNARY_EXPR>(*spare))) {
+                auto& unary = body_of<UNARY_EXPR>(*spare);
+                unary.op = minus;
+                body_of<LITERAL_EXPR>(*unary.expr).body = std::move(magnitude);
+                return std::move(spare);
+            }
+            auto expr = literal(std::move(magnitude), spare);
+            return node(AstNodeBody<UNARY_EXPR>{.op = minus, .expr = std::move(expr)});
+        }
+
+        if(auto* integer = std::get_if<std::int64_t>(&value))
+            return literal(Token{NATURAL_NUMBER, begin, end, int_arithmetic::bits(*integer)}, spare);
+        if(auto* real = std::get_if<double>(&value))
+            return literal(Token{REAL_NUMBER, begin, end, *real}, spare);
+        return literal(Token{std::get<bool>(value) ? TRUE : FALSE, begin, end}, spare);
+    }
+
+    void foldUnary(ExprPtr& slot, AstNodeBody<UNARY_EXPR>& body) {
+        if(is_negative_literal(body))
+            return;
+        if(auto value = constant_value(*body.expr)) {
+            auto folded = fold_unary(body.op.tokenType, *value);
+            if(folded && representable(*folded))
+                replace(slot, constant(*folded, {body.op.begin_pos, constant_span(*body.expr).second}, body.expr));
+            return;
+        }
+
+        // -(-x) and !!x
+        if(body.expr->type() == UNARY_EXPR) {
+            auto& inner = body_of<UNARY_EXPR>(*body.expr);
+            if(inner.op.tokenType == body.op.tokenType)
+                replace(slot, std::move(inner.expr));
+        }
+    }
+
+    void foldBinary(ExprPtr& slot, AstNodeBody<BINARY_EXPR>& body) {
+        auto lhs = constant_value(*body.lhs), rhs = constant_value(*body.rhs);
+        auto op = body.op.tokenType;
+        if(lhs && rhs) {
+            auto folded = fold_binary(op, *lhs, *rhs);
+            if(folded && representable(*folded)) {
+                auto span = std::pair{constant_span(*body.lhs).first, constant_span(*body.rhs).second};
+                replace(slot, constant(*folded, span, body.lhs));
+            }
+            return;
+        }
+
+        // Only identities that hold for every value, including -0.0 and NaN:
+        // x + 0.0 is not one of them, since -0.0 + 0.0 is 0.0
+        constexpr std::int64_t zero = 0, one = 1;
+        bool keep_lhs =
+            ((op == PLUS || op == MINUS) && same(rhs, zero))
+            || (op == MINUS && same(rhs, 0.0))
+            || ((op == STAR || op == DIV) && (same(rhs, one) || same(rhs, 1.0)))
+            || (op == EQUALS && same(rhs, true))
+            || (op == NOT_EQ && same(rhs, false));
+        bool keep_rhs =
+            (op == PLUS && same(lhs, zero))
+            || (op == STAR && (same(lhs, one) || same(lhs, 1.0)))
+            || (op == EQUALS && same(lhs, true))
+            || (op == NOT_EQ && same(lhs, false));
+        if(keep_lhs) {
+            replace(slot, std::move(body.lhs));
+        } else if(keep_rhs) {
+            replace(slot, std::move(body.rhs));
+        } else if(op == STAR && (same(lhs, zero) || same(rhs, zero))) {
+            // Dropping the other operand has to drop nothing but a read of a variable
+            auto& other = same(lhs, zero) ? body.rhs : body.lhs;
+            if(other->type() == LITERAL_EXPR)
+                replace(slot, std::move(same(lhs, zero) ? body.lhs : body.rhs));
+        }
+    }
+
+    void foldIf(ExprPtr& slot, AstNodeBody<IF_EXPR>& body) {
+        auto cond = constant_value(*body.cond);
+        if(!cond || !std::holds_alternative<bool>(*cond))
+            return;
+
+        if(body.on_false) {
+            replace(slot, std::move(std::get<bool>(*cond) ? body.on_true : body.on_false));
+            return;
+        }
+
+        // An if without else has no value, so the block that replaces it
+        // must not have one either
+        if(body.on_true->type() != COMPOUND_EXPR)
+            return;
+        auto& block = body_of<COMPOUND_EXPR>(*body.on_true);
+        if(!std::get<bool>(*cond)) {
+            block.preface.clear();
+            block.last = nullptr;
+        } else if(block.last) {
+            block.preface.emplace_back(node(AstNodeBody<EXPR_STMT>{.body = std::move(block.last)}));
+        }
+        replace(slot, std::move(body.on_true));
+    }
+};
+
+}
+
+bool fold_constants(AstNodeBody<AstNodeType::MODULE>& module) {
+    Folder folder{.arena = module.arena.get()};
+    folder.foldChildren(module);
+    return folder.changed;
+}
+
+bool fold_constants(AstNodeBody<AstNodeType::MODULE>& module, TaskScheduler& scheduler) {
+    std::vector<AstArena> arenas(scheduler.workerCount());
+    ParallelFold parallel{.scheduler = scheduler, .arenas = arenas};
+    Folder folder{.arena = nullptr, .parallel = &parallel};
+
+    // The new nodes are in the tree even if folding fails halfway
+    auto adopt = [&] {
+        if(!module.arena)
+            module.arena = std::make_unique<AstArena>();
+        for(auto& arena : arenas)
+            module.arena->adopt(arena);
+    };
+    try {
+        folder.foldChildren(module);
+    } catch(...) {
+        adopt();
+        throw;
+    }
+    adopt();
+    return folder.changed;
+}
+
+}
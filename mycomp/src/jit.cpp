@@ -0,0 +1,473 @@
+#include "mycomp/jit.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#define MYCOMP_X86_64 1
+#endif
+
+namespace mycomp {
+
+namespace {
+
+#if MYCOMP_X86_64
+
+using enum AstNodeType;
+using enum TokenType;
+
+// The expression in post-order, one value per operation.
+// ARG and CONST only name a value that is already in memory.
+struct IrOp {
+    enum Kind : std::uint8_t {ARG, CONST, NEG, ADD, SUB, MUL, DIV} kind;
+    std::uint32_t a = 0, b = 0; // operands, or the argument or constant index
+};
+
+// Lowers an expression of the given type, or gives up on anything
+// that is not plain arithmetic
+struct Lowering {
+    ValueType type;
+    std::span<const Parameter> params;
+    std::vector<IrOp> ops;
+    std::vector<Slot> constants;
+    std::map<std::uint64_t, std::uint32_t> constant_ids;
+    std::map<std::size_t, std::uint32_t> args;
+
+    std::optional<std::uint32_t> lower(const AstNode& node) {
+        return visit_ast_node(node, [&](const auto& body) {
+            return lower(body);
+        });
+    }
+
+    std::optional<std::uint32_t> lower(const AstNodeBody<LITERAL_EXPR>& body) {
+        const auto& tok = body.body;
+        if(tok.tokenType == IDENTIFIER) {
+            // The last parameter of a name hides the others, as in compile_expression()
+            const auto& name = std::get<std::string>(tok.payload);
+            auto it = std::ranges::find(params.rbegin(), params.rend(), name, &Parameter::name);
+            if(it == params.rend() || it->type != type)
+                return std::nullopt;
+            auto index = static_cast<std::size_t>(params.rend() - it - 1);
+            auto [arg, inserted] = args.try_emplace(index, 0);
+            if(inserted)
+                arg->second = push({IrOp::ARG, static_cast<std::uint32_t>(index)});
+            return arg->second;
+        }
+        if(tok.tokenType == NATURAL_NUMBER && type == ValueType::INT) {
+            auto value = std::get<std::uint64_t>(tok.payload);
+            if(value > std::uint64_t(std::numeric_limits<std::int64_t>::max()))
+                return std::nullopt;
+            return constant(Slot{.integer = static_cast<std::int64_t>(value)}, value);
+        }
+        if(tok.tokenType == REAL_NUMBER && type == ValueType::REAL) {
+            auto value = std::get<double>(tok.payload);
+            return constant(Slot{.real = value}, std::bit_cast<std::uint64_t>(value));
+        }
+        return std::nullopt;
+    }
+
+    std::optional<std::uint32_t> lower(const AstNodeBody<UNARY_EXPR>& body) {
+        if(body.op.tokenType != MINUS)
+            return std::nullopt;
+        auto operand = lower(*body.expr);
+        if(!operand)
+            return std::nullopt;
+        return push({IrOp::NEG, *operand});
+    }
+
+    std::optional<std::uint32_t> lower(const AstNodeBody<BINARY_EXPR>& body) {
+        IrOp::Kind kind;
+        if(body.op.tokenType == PLUS)
+            kind = IrOp::ADD;
+        else if(body.op.tokenType == MINUS)
+            kind = IrOp::SUB;
+        else if(body.op.tokenType == STAR)
+            kind = IrOp::MUL;
+        // Integer division can fail, which is left to the VM
+        else if(body.op.tokenType == DIV && type == ValueType::REAL)
+            kind = IrOp::DIV;
+        else
+            return std::nullopt;
+
+        auto lhs = lower(*body.lhs);
+        if(!lhs)
+            return std::nullopt;
+        auto rhs = lower(*body.rhs);
+        if(!rhs)
+            return std::nullopt;
+        return push({kind, *lhs, *rhs});
+    }
+
+    template<AstNodeType node_type>
+    std::optional<std::uint32_t> lower(const AstNodeBody<node_type>&) {
+        return std::nullopt;
+    }
+
+    std::uint32_t constant(Slot value, std::uint64_t bits) {
+        auto [it, inserted] = constant_ids.try_emplace(bits, static_cast<std::uint32_t>(constants.size()));
+        if(inserted)
+            constants.push_back(value);
+        return push({IrOp::CONST, it->second});
+    }
+
+    std::uint32_t push(IrOp op) {
+        ops.push_back(op);
+        return static_cast<std::uint32_t>(ops.size() - 1);
+    }
+};
+
+// Where a value lives: a register, a spill slot on the stack,
+// the argument array or the constant pool after the code.
+// The result is written to RESULT; SIGN_MASK is a constant of the code itself.
+struct Location {
+    enum Kind : std::uint8_t {REG, STACK, ARG, CONST, RESULT, SIGN_MASK} kind;
+    std::uint32_t index;
+
+    bool isReg(int reg) const {
+        return kind == REG && index == static_cast<std::uint32_t>(reg);
+    }
+};
+
+// The registers values are allocated in, and one more for shuffling.
+// None of them is callee-saved; rdi and rsi hold the arguments of the code.
+constexpr int int_regs[] = {0 /* rax */, 1 /* rcx */, 2 /* rdx */, 8, 9, 10};
+constexpr int int_scratch = 11;
+constexpr int real_regs[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
+constexpr int real_scratch = 15;
+
+constexpr int RSP = 4, RSI = 6, RDI = 7;
+
+struct Allocation {
+    std::vector<Location> locations;
+    std::uint32_t stack_slots = 0;
+};
+
+// Linear scan over the live ranges of the values, which start at their operation
+// and end at their last use. When the registers run out, the value that
+// is needed the longest is spilled to the stack, since it is in the way the longest.
+Allocation allocate(const std::vector<IrOp>& ops, std::span<const int> regs) {
+    auto n = static_cast<std::uint32_t>(ops.size());
+    std::vector<std::uint32_t> end(n, 0);
+    for(std::uint32_t i = 0; i < n; i++) {
+        if(ops[i].kind == IrOp::NEG)
+            end[ops[i].a] = i;
+        else if(ops[i].kind != IrOp::ARG && ops[i].kind != IrOp::CONST)
+            end[ops[i].a] = end[ops[i].b] = i;
+    }
+    end[n - 1] = n; // the result
+
+    Allocation res;
+    res.locations.resize(n);
+    std::vector<int> free_regs(regs.rbegin(), regs.rend());
+    std::vector<std::uint32_t> free_slots;
+    std::vector<std::uint32_t> active, spilled;
+
+    // A value that had a register until now gets a new slot: the free ones
+    // may have been in use since the value was computed
+    auto spill = [&](std::uint32_t value, bool computed_now) {
+        std::uint32_t slot;
+        if(!computed_now || free_slots.empty()) {
+            slot = res.stack_slots++;
+        } else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        res.locations[value] = {Location::STACK, slot};
+        spilled.push_back(value);
+    };
+
+    for(std::uint32_t i = 0; i < n; i++) {
+        if(ops[i].kind == IrOp::ARG) {
+            res.locations[i] = {Location::ARG, ops[i].a};
+            continue;
+        }
+        if(ops[i].kind == IrOp::CONST) {
+            res.locations[i] = {Location::CONST, ops[i].a};
+            continue;
+        }
+
+        // Operands used last here give up their place, which the result may
+        // take over: the code reads the operands before it writes the result
+        std::erase_if(active, [&](std::uint32_t value) {
+            if(end[value] > i)
+                return false;
+            free_regs.push_back(static_cast<int>(res.locations[value].index));
+            return true;
+        });
+        std::erase_if(spilled, [&](std::uint32_t value) {
+            if(end[value] > i)
+                return false;
+            free_slots.push_back(res.locations[value].index);
+            return true;
+        });
+
+        if(!free_regs.empty()) {
+            res.locations[i] = {Location::REG, static_cast<std::uint32_t>(free_regs.back())};
+            free_regs.pop_back();
+            active.push_back(i);
+            continue;
+        }
+        auto victim = std::ranges::max_element(active, {}, [&](std::uint32_t value) { return end[value]; });
+        if(end[*victim] > end[i]) {
+            res.locations[i] = res.locations[*victim];
+            spill(*victim, false);
+            *victim = i;
+        } else {
+            spill(i, true);
+        }
+    }
+    return res;
+}
+
+enum Width { REAL64, INT64 };
+
+struct Assembler {
+    std::vector<std::uint8_t> code;
+    // Offsets of rip-relative displacements, with the offset into the constant pool they point to
+    std::vector<std::pair<std::size_t, std::uint32_t>> fixups;
+
+    void bytes(std::initializer_list<std::uint8_t> values) {
+        code.insert(code.end(), values);
+    }
+
+    void imm32(std::uint32_t value) {
+        for(int i = 0; i < 4; i++)
+            code.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+
+    // prefix [REX] opcode ModRM [SIB] [disp], with `reg` in ModRM.reg
+    // and `rm` a register or memory
+    void instruction(std::initializer_list<std::uint8_t> prefix, bool wide, std::initializer_list<std::uint8_t> opcode, int reg, Location rm) {
+        bool rip_relative = rm.kind == Location::CONST || rm.kind == Location::SIGN_MASK;
+        int base = rm.kind == Location::REG ? static_cast<int>(rm.index)
+            : rm.kind == Location::STACK ? RSP
+            : rm.kind == Location::RESULT ? RSI
+            : RDI;
+        int rex = (wide ? 8 : 0) | (reg & 8 ? 4 : 0) | (!rip_relative && base & 8 ? 1 : 0);
+        bytes(prefix);
+        if(rex)
+            code.push_back(static_cast<std::uint8_t>(0x40 | rex));
+        bytes(opcode);
+
+        auto modrm = [&](int mod, int r, int m) {
+            code.push_back(static_cast<std::uint8_t>(mod << 6 | (r & 7) << 3 | (m & 7)));
+        };
+        if(rm.kind == Location::REG) {
+            modrm(3, reg, base);
+        } else if(rip_relative) {
+            // The displacement is relative to the end of the instruction,
+            // which is where it ends since none of these take an immediate.
+            // The sign mask comes first in the pool, for the alignment xorpd needs.
+            modrm(0, reg, 5);
+            fixups.emplace_back(code.size(), rm.kind == Location::SIGN_MASK ? 0 : 16 + 8 * rm.index);
+            imm32(0);
+        } else {
+            modrm(2, reg, base);
+            if(base == RSP)
+                code.push_back(0x24); // SIB: no index
+            imm32(rm.index * 8);
+        }
+    }
+
+    void load(Width width, int reg, Location from) {
+        if(from.isReg(reg))
+            return;
+        if(width == INT64)
+            instruction({}, true, {0x8B}, reg, from);              // mov
+        else if(from.kind == Location::REG)
+            instruction({0x66}, false, {0x0F, 0x28}, reg, from);   // movapd
+        else
+            instruction({0xF2}, false, {0x0F, 0x10}, reg, from);   // movsd
+    }
+
+    void store(Width width, Location to, int reg) {
+        if(to.kind == Location::REG)
+            load(width, static_cast<int>(to.index), {Location::REG, static_cast<std::uint32_t>(reg)});
+        else if(width == INT64)
+            instruction({}, true, {0x89}, reg, to);                // mov
+        else
+            instruction({0xF2}, false, {0x0F, 0x11}, reg, to);     // movsd
+    }
+
+    void arithmetic(Width width, IrOp::Kind kind, int reg, Location rhs) {
+        if(width == INT64) {
+            if(kind == IrOp::ADD)
+                instruction({}, true, {0x03}, reg, rhs);
+            else if(kind == IrOp::SUB)
+                instruction({}, true, {0x2B}, reg, rhs);
+            else
+                instruction({}, true, {0x0F, 0xAF}, reg, rhs);     // imul
+            return;
+        }
+        std::uint8_t opcode = kind == IrOp::ADD ? 0x58 : kind == IrOp::SUB ? 0x5C : kind == IrOp::MUL ? 0x59 : 0x5E;
+        instruction({0xF2}, false, {0x0F, opcode}, reg, rhs);
+    }
+
+    void negate(Width width, int reg) {
+        if(width == INT64)
+            instruction({}, true, {0xF7}, 3, {Location::REG, static_cast<std::uint32_t>(reg)}); // neg
+        else
+            instruction({0x66}, false, {0x0F, 0x57}, reg, {Location::SIGN_MASK, 0});           // xorpd
+    }
+
+    void frame(bool enter, std::uint32_t slots) {
+        if(slots == 0)
+            return;
+        // sub rsp, imm32 / add rsp, imm32
+        instruction({}, true, {0x81}, enter ? 5 : 0, {Location::REG, RSP});
+        imm32(slots * 8);
+    }
+};
+
+// Machine code for `void(const Slot* args, Slot* result)`, followed by the constants
+std::vector<std::uint8_t> generate(const Lowering& ir) {
+    auto width = ir.type == ValueType::INT ? INT64 : REAL64;
+    auto scratch = width == INT64 ? int_scratch : real_scratch;
+    auto allocation = width == INT64 ? allocate(ir.ops, int_regs) : allocate(ir.ops, real_regs);
+    const auto& loc = allocation.locations;
+
+    Assembler as;
+    as.frame(true, allocation.stack_slots);
+    for(std::uint32_t i = 0; i < ir.ops.size(); i++) {
+        const auto& op = ir.ops[i];
+        if(op.kind == IrOp::ARG || op.kind == IrOp::CONST)
+            continue;
+        // Computed in the register of the result if it has one
+        int reg = loc[i].kind == Location::REG ? static_cast<int>(loc[i].index) : scratch;
+        if(op.kind == IrOp::NEG) {
+            as.load(width, reg, loc[op.a]);
+            as.negate(width, reg);
+        } else {
+            auto lhs = loc[op.a], rhs = loc[op.b];
+            // `reg = lhs; reg op= rhs` would overwrite rhs
+            if(rhs.isReg(reg) && !lhs.isReg(reg)) {
+                if(op.kind == IrOp::ADD || op.kind == IrOp::MUL)
+                    std::swap(lhs, rhs);
+                else
+                    reg = scratch;
+            }
+            as.load(width, reg, lhs);
+            as.arithmetic(width, op.kind, reg, rhs);
+        }
+        as.store(width, loc[i], reg);
+    }
+    int result = loc.back().kind == Location::REG ? static_cast<int>(loc.back().index) : scratch;
+    as.load(width, result, loc.back());
+    as.store(width, {Location::RESULT, 0}, result);
+    as.frame(false, allocation.stack_slots);
+    as.bytes({0xC3}); // ret
+
+    // The pool: the 16 bytes xorpd reads of the sign mask, then the constants.
+    // Code is mapped at the start of a page, so aligning the offset aligns the address.
+    auto pool = (as.code.size() + 15) / 16 * 16;
+    std::vector<std::uint8_t> res(pool + 16 + 8 * ir.constants.size(), 0);
+    std::ranges::copy(as.code, res.begin());
+    auto mask = std::uint64_t(1) << 63;
+    std::memcpy(res.data() + pool, &mask, 8);
+    if(!ir.constants.empty())
+        std::memcpy(res.data() + pool + 16, ir.constants.data(), 8 * ir.constants.size());
+    for(auto [at, offset] : as.fixups) {
+        auto disp = static_cast<std::int32_t>(pool + offset - (at + 4));
+        std::memcpy(res.data() + at, &disp, 4);
+    }
+    return res;
+}
+
+// Executable memory holding the code, or nullptr if none can be mapped
+std::pair<void*, std::size_t> map_code(const std::vector<std::uint8_t>& code) {
+    auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto size = (code.size() + page - 1) / page * page;
+    void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory == MAP_FAILED)
+        return {nullptr, 0};
+    std::memcpy(memory, code.data(), code.size());
+    // Never writable and executable at once
+    if(::mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        ::munmap(memory, size);
+        return {nullptr, 0};
+    }
+    return {memory, size};
+}
+
+#endif
+
+}
+
+JitFunction::JitFunction(Program program, std::size_t parameter_count) :
+    program_(std::move(program)),
+    parameter_count_(parameter_count)
+{}
+
+JitFunction::~JitFunction() {
+    if(code_)
+        ::munmap(code_, size_);
+}
+
+JitFunction::JitFunction(JitFunction&& other) noexcept :
+    program_(std::move(other.program_)),
+    parameter_count_(other.parameter_count_),
+    vm_(std::move(other.vm_)),
+    code_(std::exchange(other.code_, nullptr)),
+    size_(std::exchange(other.size_, 0))
+{}
+
+JitFunction& JitFunction::operator=(JitFunction&& other) noexcept {
+    std::swap(program_, other.program_);
+    std::swap(parameter_count_, other.parameter_count_);
+    std::swap(vm_, other.vm_);
+    std::swap(code_, other.code_);
+    std::swap(size_, other.size_);
+    return *this;
+}
+
+Slot JitFunction::operator()(std::span<const Slot> args) const {
+    if(args.size() != parameter_count_)
+        throw std::invalid_argument("Wrong number of arguments for a JitFunction");
+    if(code_) {
+        Slot res;
+        reinterpret_cast<Native>(code_)(args.data(), &res);
+        return res;
+    }
+    return std::visit([](auto value) {
+        if constexpr (std::is_same_v<decltype(value), std::int64_t>)
+            return Slot{.integer = value};
+        else if constexpr (std::is_same_v<decltype(value), double>)
+            return Slot{.real = value};
+        else if constexpr (std::is_same_v<decltype(value), bool>)
+            return Slot{.boolean = value};
+        else
+            return Slot{};
+    }, vm_.run(program_, args));
+}
+
+JitFunction jit_compile(const AstNode& expr, std::span<const Parameter> params) {
+    JitFunction res(compile_expression(expr, params), params.size());
+#if MYCOMP_X86_64
+    auto type = res.program_.result_type;
+    if(type != ValueType::INT && type != ValueType::REAL)
+        return res;
+    Lowering ir{.type = type, .params = params, .ops = {}, .constants = {}, .constant_ids = {}, .args = {}};
+    if(!ir.lower(expr))
+        return res;
+    std::tie(res.code_, res.size_) = map_code(generate(ir));
+#endif
+    return res;
+}
+
+}
@@ -1,17 +1,23 @@
 #include "mycomp/lex.hpp"
+#include "mycomp/utils/char_class.hpp"
 
 #include <fmt/core.h>
 
-#include <algorithm>
-#include <cctype>
+#include <array>
+#include <bit>
 #include <charconv>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <optional>
 #include <span>
+#include <string>
 #include <string_view>
 #include <system_error>
 #include <type_traits>
-#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
 
 namespace mycomp {
 
@@ -46,89 +52,385 @@ static constexpr std::pair<std::string_view, TokenType> special_tokens[] = {
     {";", SEMICOLON}
 };
 
-static_assert(std::ranges::is_sorted(
-    special_tokens,
-    [](auto l, auto r) {
-        return l.first.size() > r.first.size();
+
+// Everything below is derived from the two tables above at compile time:
+// adding a keyword or an operator only means editing the tables.
+
+// Keywords are looked up in a perfect hash table. The seed is searched
+// for at compile time, so that no two keywords share a slot.
+namespace keyword_lookup {
+
+static constexpr std::size_t size = std::bit_ceil(std::size(keywords) * 4);
+
+static constexpr std::size_t hash(std::string_view word, std::uint32_t seed) {
+    std::uint32_t h = seed;
+    for(char c : word)
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u; // FNV-1a
+    return h & (size - 1);
+}
+
+static constexpr std::uint32_t seed = [] {
+    for(std::uint32_t candidate = 2166136261u;; candidate++) {
+        std::array<bool, size> used{};
+        bool ok = true;
+        for(auto [word, tok] : keywords)
+            ok = ok && !std::exchange(used[hash(word, candidate)], true);
+        if(ok)
+            return candidate;
+    }
+}();
+
+// Empty slots hold an empty word, which never comes out of Lexer::parseWord
+struct Entry {
+    std::string_view word;
+    TokenType tok = IDENTIFIER;
+};
+
+static constexpr auto table = [] {
+    std::array<Entry, size> res{};
+    for(auto [word, tok] : keywords)
+        res[hash(word, seed)] = {word, tok};
+    return res;
+}();
+
+static constexpr std::optional<TokenType> find(std::string_view word) {
+    const auto& entry = table[hash(word, seed)];
+    if(entry.word != word)
+        return std::nullopt;
+    return entry.tok;
+}
+
+static_assert(find("return") == RETURN);
+static_assert(find("retur") == std::nullopt);
+
+}
+
+// Operators are matched by a trie over the special tokens, walked with
+// maximal munch. The order of the special tokens does not matter.
+namespace operator_automaton {
+
+static constexpr std::size_t max_states = [] {
+    std::size_t res = 1;
+    for(auto [str, tok] : special_tokens)
+        res += str.size();
+    return res;
+}();
+static_assert(max_states <= 256, "States have to fit into std::uint8_t");
+
+// 0 is both the initial state and "no transition", since nothing transitions back into it
+static constexpr std::uint8_t no_state = 0;
+
+struct Automaton {
+    std::array<std::array<std::uint8_t, 256>, max_states> next{};
+    std::array<std::optional<TokenType>, max_states> accept{};
+};
+
+static constexpr Automaton automaton = [] {
+    Automaton res;
+    std::size_t states = 1;
+    for(auto [str, tok] : special_tokens) {
+        std::size_t state = 0;
+        for(char c : str) {
+            auto& next = res.next[state][static_cast<unsigned char>(c)];
+            if(next == no_state)
+                next = static_cast<std::uint8_t>(states++);
+            state = next;
+        }
+        res.accept[state] = tok;
+    }
+    return res;
+}();
+
+}
+
+// Decimal literals without an exponent are parsed while they are scanned,
+// eight digits at a time. Everything else (hex, exponents, long mantissas
+// and malformed numbers) is left to the general path and std::from_chars.
+namespace number_fast_path {
+
+inline constexpr std::uint64_t ones = 0x0101010101010101;
+
+// Whether the 8 bytes are all decimal digits
+inline bool all_digits(std::uint64_t chunk) {
+    return ((chunk & (ones * 0xF0)) == ones * 0x30) && (((chunk + ones * 0x06) & (ones * 0xF0)) == ones * 0x30);
+}
+
+// The value of 8 decimal digits, the first one in the lowest byte
+inline std::uint64_t parse_8_digits(std::uint64_t chunk) {
+    chunk -= ones * '0';
+    chunk = chunk * 10 + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FF) * (100 + (1000000ULL << 32)))
+        + (((chunk >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32;
+    return chunk;
+}
+
+inline std::uint64_t load(const char* ptr) {
+    std::uint64_t res;
+    std::memcpy(&res, ptr, sizeof(res));
+    if constexpr (std::endian::native == std::endian::big)
+        res = __builtin_bswap64(res);
+    return res;
+}
+
+// Up to 19 digits fit into a uint64_t without overflow
+inline constexpr std::size_t max_digits = 19;
+
+// Accumulates the digits at code[pos...] into value, returns the position after them.
+// Stops early once there are more than max_digits.
+inline std::size_t parse_digits(std::string_view code, std::size_t pos, std::uint64_t& value, std::size_t& digits) {
+    while(pos + 8 <= code.size() && digits + 8 <= max_digits) {
+        auto chunk = load(code.data() + pos);
+        if(!all_digits(chunk))
+            break;
+        value = value * 100000000 + parse_8_digits(chunk);
+        digits += 8;
+        pos += 8;
+    }
+    for(; pos < code.size() && has_char_class(code[pos], char_class::DIGIT); pos++) {
+        if(++digits > max_digits)
+            return pos;
+        value = value * 10 + static_cast<std::uint64_t>(code[pos] - '0');
+    }
+    return pos;
+}
+
+// Only finds the end of the digits at code[pos...]
+inline std::size_t skip_digits(std::string_view code, std::size_t pos) {
+    while(pos + 8 <= code.size() && all_digits(load(code.data() + pos)))
+        pos += 8;
+    while(pos < code.size() && has_char_class(code[pos], char_class::DIGIT))
+        pos++;
+    return pos;
+}
+
+// Powers of ten that are exact doubles
+inline constexpr auto exact_powers_of_10 = [] {
+    std::array<double, 23> res{};
+    res[0] = 1;
+    for(std::size_t i = 1; i < res.size(); i++)
+        res[i] = res[i - 1] * 10;
+    return res;
+}();
+
+// Whether the number ends at pos, as far as the fast path is concerned
+inline bool ends_number(std::string_view code, std::size_t pos) {
+    return pos == code.size() || (code[pos] != '.' && has_char_class(code[pos], char_class::SPACE | char_class::PUNCT));
+}
+
+// Parses [digits][.digits] at pos, or returns nothing if the general path is needed.
+// Without `decode` only the kind and the span are found, and any number of digits is fine.
+inline std::optional<Token> parse(std::string_view code, std::size_t pos, bool decode) {
+    auto begin = pos;
+    // Leading zeros and 0x prefixes
+    if(code[pos] == '0' && pos + 1 < code.size() && has_char_class(code[pos + 1], char_class::WORD))
+        return {};
+
+    if(!decode) {
+        pos = skip_digits(code, pos);
+        if(ends_number(code, pos))
+            return Token{.tokenType=NATURAL_NUMBER, .begin_pos=begin, .end_pos=pos};
+        if(code[pos] != '.')
+            return {};
+        pos = skip_digits(code, pos + 1);
+        if(!ends_number(code, pos))
+            return {};
+        return Token{.tokenType=REAL_NUMBER, .begin_pos=begin, .end_pos=pos};
+    }
+
+    std::uint64_t mantissa = 0;
+    std::size_t digits = 0;
+    pos = parse_digits(code, pos, mantissa, digits);
+    if(digits > max_digits)
+        return {};
+    if(ends_number(code, pos))
+        return Token{.tokenType=NATURAL_NUMBER, .begin_pos=begin, .end_pos=pos, .payload=mantissa};
+    if(code[pos] != '.')
+        return {};
+
+    auto int_digits = digits;
+    pos = parse_digits(code, pos + 1, mantissa, digits);
+    auto frac_digits = digits - int_digits;
+    // Clinger's fast path: both the mantissa and the power of ten are exact doubles,
+    // so the quotient is correctly rounded
+    if(digits > max_digits || mantissa > (std::uint64_t{1} << 53) || frac_digits >= exact_powers_of_10.size())
+        return {};
+    if(digits == 0 || !ends_number(code, pos))
+        return {};
+    auto value = static_cast<double>(mantissa) / exact_powers_of_10[frac_digits];
+    return Token{.tokenType=REAL_NUMBER, .begin_pos=begin, .end_pos=pos, .payload=value};
+}
+
+}
+
+// What Lexer::next does, depending on the first character of a token
+enum class Dispatch : std::uint8_t {
+    INVALID,
+    NUMBER,
+    POINT, // a number if followed by a digit
+    WORD,
+    STRING,
+    SPECIAL
+};
+
+static constexpr auto dispatch_table = [] {
+    std::array<Dispatch, 256> res{};
+    for(unsigned c = 0; c < 256; c++) {
+        auto ch = static_cast<char>(c);
+        if(has_char_class(ch, char_class::DIGIT))
+            res[c] = Dispatch::NUMBER;
+        else if(ch == '.')
+            res[c] = Dispatch::POINT;
+        else if(has_char_class(ch, char_class::WORD_START))
+            res[c] = Dispatch::WORD;
+        else if(ch == '"')
+            res[c] = Dispatch::STRING;
+        else if(has_char_class(ch, char_class::PUNCT))
+            res[c] = Dispatch::SPECIAL;
+        else
+            res[c] = Dispatch::INVALID;
     }
-), "We want our special tokens to come in descending order of size");
+    return res;
+}();
 
 
-Lexer::Lexer(std::string_view code) : s_(code) {}
+Lexer::Lexer(std::string_view code, SimdLevel simd) : s_(code), simd_(simd) {}
+
+Lexer::Lexer(std::string_view code, std::vector<LexException>& diagnostics, SimdLevel simd) :
+    s_(code), simd_(simd), diagnostics_(&diagnostics)
+{}
 
 
 std::optional<Token> Lexer::next() {
-    skipWhitespaceAndComments();
-    char c = s_.curr(), c2 = s_.peek();
+    auto tok = nextWithoutText();
+    if(tok && (tok->tokenType == IDENTIFIER || tok->tokenType == STRING))
+        tok->payload = std::string(token_text(s_.raw(), *tok));
+    return tok;
+}
+
+
+bool Lexer::nextInto(Token& out) {
+    auto tok = nextWithoutText();
+    if(!tok)
+        return false;
+    out.tokenType = tok->tokenType;
+    out.begin_pos = tok->begin_pos;
+    out.end_pos = tok->end_pos;
+    if(tok->tokenType == IDENTIFIER || tok->tokenType == STRING) {
+        // Reusing the string the slot already has saves an allocation
+        auto text = token_text(s_.raw(), *tok);
+        if(auto* str = std::get_if<std::string>(&out.payload))
+            str->assign(text);
+        else
+            out.payload.emplace<std::string>(text);
+    } else {
+        out.payload = tok->payload;
+    }
+    return true;
+}
+
+std::size_t Lexer::nextBatch(std::span<Token> out) {
+    std::size_t res = 0;
+    while(res < out.size() && nextInto(out[res]))
+        res++;
+    return res;
+}
+
+
+std::optional<Token> Lexer::nextWithoutText() {
+    return lexToken(true);
+}
+
+std::optional<SpanToken> Lexer::nextSpan() {
+    auto tok = lexToken(false);
+    if(!tok)
+        return {};
+    return SpanToken{.tokenType=tok->tokenType, .begin_pos=tok->begin_pos, .end_pos=tok->end_pos};
+}
+
+
+std::optional<Token> Lexer::lexToken(bool decode_numbers) {
+    if(auto error = skipWhitespaceAndComments())
+        return error;
 
     if(s_.end())
         return {};
-    if(std::isdigit(c))
-        return parseNumber();
-    if(c == '.' && std::isdigit(c2))
-        return parseNumber();
-    if(c == '_' || std::isalpha(c))
+    switch(dispatch_table[static_cast<unsigned char>(s_.curr())]) {
+    case Dispatch::NUMBER:
+        return parseNumber(decode_numbers);
+    case Dispatch::POINT:
+        if(has_char_class(s_.peek(), char_class::DIGIT))
+            return parseNumber(decode_numbers);
+        return parseSpecialToken();
+    case Dispatch::WORD:
         return parseWord();
-    if(c == '"')
+    case Dispatch::STRING:
         return parseString();
-    if(std::ispunct(c))
+    case Dispatch::SPECIAL:
         return parseSpecialToken();
+    case Dispatch::INVALID:
+        break;
+    }
 
-    throw LexException{
+    return fail(LexException{
         .begin_pos=s_.ind(),
         .end_pos=s_.ind() + 1,
         .error="Unrecognized character!"
+    }, s_.ind(), s_.ind() + 1);
+}
+
+
+Token Lexer::fail(LexException error, std::size_t begin, std::size_t resume) {
+    if(!diagnostics_)
+        throw std::move(error);
+    diagnostics_->push_back(std::move(error));
+    s_.seek(resume);
+    return Token{
+        .tokenType=ERROR,
+        .begin_pos=begin,
+        .end_pos=s_.ind()
     };
 }
 
 
-void Lexer::skipWhitespaceAndComments() {
-    while(!s_.end()) {
-        if(std::isspace(s_.curr()))
-            s_.advance();
-        else if(s_.substr(2) == "//")
-            while(!s_.end() && s_.curr() != '\n')
-                s_.advance();
-        else if(s_.substr(2) == "/*") {
-            auto ind_start = s_.ind();
-            s_.advance(2);
-            while(s_.substr(2) != "*/") {
-                s_.advance();
-                if(s_.end())
-                    throw LexException{
-                        .begin_pos=ind_start,
-                        .end_pos=ind_start + 2,
-                        .error="Inline comment not terminated!"
-                    };
-            }
-            s_.advance(2);
-        } else if(s_.substr(2) == "*/")
-            throw LexException{
-                .begin_pos=s_.ind(),
-                .end_pos=s_.ind() + 2,
-                .error="Unexpected inline comment terminator encountered!"
-            };
-        else
-            break;
-    }
+std::optional<Token> Lexer::skipWhitespaceAndComments() {
+    std::optional<LexException> error;
+    s_.seek(detail::skip_whitespace_and_comments(s_.raw(), s_.ind(), simd_, error));
+    if(!error) [[likely]]
+        return {};
+    // A stray terminator is skipped, an unterminated comment goes on to the end
+    auto resume = s_.substr(2) == "*/" ? s_.ind() + 2 : s_.raw().size();
+    return fail(std::move(*error), s_.ind(), resume);
 }
 
 
-Token Lexer::parseNumber() {
+Token Lexer::parseNumber(bool decode) {
+    if(auto res = number_fast_path::parse(s_.raw(), s_.ind(), decode)) [[likely]] {
+        s_.seek(res->end_pos);
+        return std::move(*res);
+    }
+
     bool is_base16 = false;
     bool has_point = false;
     bool has_exponent = false;
+    std::size_t mantissa_digits = 0, exponent_digits = 0;
 
     auto ind_start = s_.ind();
 
+    // After an error, lexing resumes after the rest of the malformed number
+    auto fail_number = [&](LexException error) {
+        while(!s_.end() && (has_char_class(s_.curr(), char_class::WORD) || s_.curr() == '.'))
+            s_.advance();
+        return fail(std::move(error), ind_start, s_.ind());
+    };
+
     if(s_.curr() == '0') {
         char c2 = s_.peek();
-        if(std::isdigit(c2))
-            throw LexException{
+        if(has_char_class(c2, char_class::DIGIT))
+            return fail_number(LexException{
                 .begin_pos=ind_start,
                 .end_pos=ind_start + 1,
                 .error="Leading zero in a number!"
-            };
+            });
 
         if(c2 == 'x' || c2 == 'X') {
             is_base16 = true;
@@ -141,38 +443,50 @@ Token Lexer::parseNumber() {
         char c = s_.curr();
         if(c == '.') {
             if(has_point || has_exponent)
-                throw LexException{
+                return fail_number(LexException{
                     .begin_pos=s_.ind(),
                     .end_pos=s_.ind() + 1,
                     .error="Unexpected point in a number!"
-                };
+                });
             else
                 has_point = true;
         }
         else if(is_base16 ? (c == 'p' || c == 'P') : (c == 'e' || c == 'E')) {
             if(has_exponent)
-                throw LexException{
+                return fail_number(LexException{
                     .begin_pos=s_.ind(),
                     .end_pos=s_.ind() + 1,
                     .error="Unexpected exponent in a number!"
-                };
+                });
             else {
                 has_exponent = true;
                 if(s_.peek() == '-' || s_.peek() == '+')
                     s_.advance(); // '-' or '+' is ok here
             }
         }
-        else if(std::isspace(c) || std::ispunct(c))
+        else if(has_char_class(c, char_class::SPACE | char_class::PUNCT))
             break;
-        else if(is_base16 ? !std::isxdigit(c) : !std::isdigit(c))
-            throw LexException{
+        // The exponent of a hex number is decimal too
+        else if(!has_char_class(c, is_base16 && !has_exponent ? char_class::HEX_DIGIT : char_class::DIGIT))
+            return fail_number(LexException{
                 .begin_pos=s_.ind(),
                 .end_pos=s_.ind() + 1,
                 .error=fmt::format("Unexpected character in a number: '{}'!", c)
-            };
+            });
+        else
+            (has_exponent ? exponent_digits : mantissa_digits)++;
     }
     const char* end_ptr = s_.raw().data() + s_.ind();
 
+    // All that from_chars would reject but too large numbers,
+    // so that numbers that are not decoded are checked as well
+    if(mantissa_digits == 0 || (has_exponent && exponent_digits == 0))
+        return fail_number(LexException{
+            .begin_pos=ind_start,
+            .end_pos=s_.ind(),
+            .error="Missing digits in a number!"
+        });
+
     bool is_float = has_point || has_exponent;
 
     Token res{
@@ -180,11 +494,14 @@ Token Lexer::parseNumber() {
         .begin_pos=ind_start,
         .end_pos=s_.ind()
     };
+    // Overflows are only found by decoding
+    if(!decode)
+        return res;
 
-    auto check_fc_result = [&](std::from_chars_result r) {
+    auto check_fc_result = [&](std::from_chars_result r) -> std::optional<LexException> {
         auto [last, errc] = r;
         if(errc != std::errc{})
-            throw LexException{
+            return LexException{
                 .begin_pos=res.begin_pos,
                 .end_pos=res.end_pos,
                 .error=fmt::format(
@@ -193,16 +510,18 @@ Token Lexer::parseNumber() {
                 )
             };
         if(last != end_ptr)
-            throw LexException{
+            return LexException{
                 .begin_pos=res.begin_pos,
                 .end_pos=res.end_pos,
                 .error="Number could not be fully parsed!"
             };
+        return {};
     };
 
+    std::optional<LexException> error;
     if(is_float) {
         double val = {};
-        check_fc_result(std::from_chars(
+        error = check_fc_result(std::from_chars(
             start_ptr,
             end_ptr,
             val,
@@ -212,7 +531,7 @@ Token Lexer::parseNumber() {
     }
     else {
         std::uint64_t val = {};
-        check_fc_result(std::from_chars(
+        error = check_fc_result(std::from_chars(
             start_ptr,
             end_ptr,
             val,
@@ -220,6 +539,8 @@ Token Lexer::parseNumber() {
         ));
         res.payload = val;
     }
+    if(error)
+        return fail(std::move(*error), res.begin_pos, res.end_pos);
     return res;
 }
 
@@ -228,41 +549,44 @@ Token Lexer::parseString() {
     auto ind_start = s_.ind();
     s_.advance(); // skip the '"'
     while(s_.curr() != '"') {
-        if(s_.curr() == '\\')
-            throw LexException{
-                .begin_pos=s_.ind(),
-                .end_pos=s_.ind() + 1,
+        if(s_.curr() == '\\') {
+            // After an error, lexing resumes after the closing quote
+            auto escape = s_.ind();
+            s_.advance(2);
+            while(!s_.end() && s_.curr() != '"')
+                s_.advance();
+            return fail(LexException{
+                .begin_pos=escape,
+                .end_pos=escape + 1,
                 .error="Escape sequences inside strings are not supported yet!"
-            };
+            }, ind_start, s_.ind() + 1);
+        }
         s_.advance();
         if(s_.end())
-            throw LexException{
+            return fail(LexException{
                 .begin_pos=ind_start,
                 .end_pos=ind_start + 1,
                 .error="String literal is not terminated!"
-            };
+            }, ind_start, s_.ind());
     }
     s_.advance(); // skip the '"'
 
     return Token{
         .tokenType=STRING,
         .begin_pos=ind_start,
-        .end_pos=s_.ind(),
-        .payload=std::string(s_.raw().substr(ind_start + 1, (s_.ind() - 1) - (ind_start + 1)))
+        .end_pos=s_.ind()
     };
 }
 
 
 Token Lexer::parseWord() {
-    constexpr std::span keyword_span = keywords;
-    static const std::unordered_map<std::string_view, TokenType> keyword_map{keyword_span.begin(), keyword_span.end()};
     auto ind_start = s_.ind();
-    while(std::isalnum(s_.curr()) || s_.curr() == '_')
+    while(has_char_class(s_.curr(), char_class::WORD))
         s_.advance();
     auto word = s_.raw().substr(ind_start, s_.ind() - ind_start);
-    if(auto iter = keyword_map.find(word); iter != keyword_map.end())
+    if(auto keyword = keyword_lookup::find(word))
         return Token{
-            .tokenType=iter->second,
+            .tokenType=*keyword,
             .begin_pos=ind_start,
             .end_pos=s_.ind()
         };
@@ -270,40 +594,105 @@ Token Lexer::parseWord() {
         return Token{
             .tokenType=IDENTIFIER,
             .begin_pos=ind_start,
-            .end_pos=s_.ind(),
-            .payload=std::string{word}
+            .end_pos=s_.ind()
         };
 }
 
 
 Token Lexer::parseSpecialToken() {
-    for(auto [str, tok] : special_tokens)
-        if(s_.substr(str.size()) == str) {
-            s_.advance(str.size());
-            return Token{
-                .tokenType=tok,
-                .begin_pos=s_.ind() - str.size(),
-                .end_pos=s_.ind()
-            };
+    using namespace operator_automaton;
+
+    std::optional<TokenType> tok;
+    std::size_t tok_size = 0;
+    std::uint8_t state = 0;
+    // s_.peek returns '\n' past the end, which never continues an operator
+    for(std::size_t i = 0; ; i++) {
+        state = automaton.next[state][static_cast<unsigned char>(s_.peek(i))];
+        if(state == no_state)
+            break;
+        if(automaton.accept[state]) {
+            tok = automaton.accept[state];
+            tok_size = i + 1;
         }
+    }
+
+    if(tok) {
+        s_.advance(tok_size);
+        return Token{
+            .tokenType=*tok,
+            .begin_pos=s_.ind() - tok_size,
+            .end_pos=s_.ind()
+        };
+    }
 
-    throw LexException{
+    return fail(LexException{
         .begin_pos=s_.ind(),
         .end_pos=s_.ind() + 1,
         .error="Unexpected sequence of special characters"
-    };
+    }, s_.ind(), s_.ind() + 1);
+}
+
+
+std::string_view token_text(std::string_view code, const Token& token) {
+    return token_text(code, SpanToken{.tokenType=token.tokenType, .begin_pos=token.begin_pos, .end_pos=token.end_pos});
+}
+
+std::string_view token_text(std::string_view code, const SpanToken& token) {
+    if(token.tokenType == STRING) // without the quotes
+        return code.substr(token.begin_pos + 1, token.end_pos - token.begin_pos - 2);
+    return code.substr(token.begin_pos, token.end_pos - token.begin_pos);
 }
 
 
 std::vector<Token> lex(std::string_view code) {
+    // Typical code has a token every 4-8 bytes, so the reservation is seldom
+    // outgrown. Tokens are lexed in place, a chunk at a time, so that only
+    // the last chunk has unused tokens, which are trimmed.
+    constexpr std::size_t chunk = 256;
     std::vector<Token> res;
+    res.reserve(code.size() / 4 + chunk);
     Lexer lexer(code);
     while(true) {
-        auto tok = lexer.next();
-        if(!tok.has_value())
+        auto old_size = res.size();
+        res.resize(old_size + chunk);
+        auto written = lexer.nextBatch(std::span(res).subspan(old_size));
+        if(written < chunk) {
+            res.resize(old_size + written);
             return res;
-        res.push_back(*tok);
+        }
     }
 }
 
+std::vector<SpanToken> lex_spans(std::string_view code) {
+    // Spans are small enough for a generous estimate
+    std::vector<SpanToken> res;
+    res.reserve(code.size() / 4 + 16);
+    Lexer lexer(code);
+    while(auto tok = lexer.nextSpan())
+        res.push_back(*tok);
+    return res;
+}
+
+Token decode(std::string_view code, const SpanToken& token) {
+    Lexer lexer(code);
+    lexer.seek(token.begin_pos);
+    return *lexer.next();
+}
+
+std::uint64_t decode_natural(std::string_view code, const SpanToken& token) {
+    return std::get<std::uint64_t>(decode(code, token).payload);
+}
+
+double decode_real(std::string_view code, const SpanToken& token) {
+    return std::get<double>(decode(code, token).payload);
+}
+
+LexResult lex_with_diagnostics(std::string_view code) {
+    LexResult res;
+    Lexer lexer(code, res.diagnostics);
+    while(auto tok = lexer.next())
+        res.tokens.push_back(std::move(*tok));
+    return res;
+}
+
 }
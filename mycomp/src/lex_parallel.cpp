@@ -0,0 +1,123 @@
+#include "mycomp/lex.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mycomp {
+
+namespace {
+
+// Smaller chunks are not worth a thread
+constexpr std::size_t min_chunk_size = 256 * 1024;
+
+// The tokens that begin in [begin, end), lexed as if the code started at `begin`.
+// They are right from the first token that the sequential lexer also produces onwards,
+// since the lexer has no state besides its position.
+struct Chunk {
+    std::size_t begin, end;
+    std::vector<Token> tokens;
+    std::optional<LexException> error;
+    // Anything else that was thrown, such as std::bad_alloc, for the calling thread
+    std::exception_ptr failure;
+
+    void lex(std::string_view code) {
+        Lexer lexer(code);
+        lexer.seek(begin);
+        try {
+            while(auto tok = lexer.next()) {
+                if(tok->begin_pos >= end)
+                    return;
+                tokens.push_back(std::move(*tok));
+            }
+        } catch(LexException& e) {
+            // An error after the end of the chunk belongs to the next one
+            if(e.begin_pos < end)
+                error = std::move(e);
+        } catch(...) {
+            failure = std::current_exception();
+        }
+    }
+};
+
+std::vector<Chunk> split(std::string_view code, std::size_t count) {
+    std::vector<Chunk> res;
+    std::size_t begin = 0;
+    for(std::size_t i = 1; i <= count && begin < code.size(); i++) {
+        std::size_t end = code.size();
+        if(i < count) {
+            // Chunks start at line starts, which are unlikely to be inside a token
+            end = std::max(begin, code.size() / count * i);
+            auto newline = code.find('\n', end);
+            end = newline == std::string_view::npos ? code.size() : newline + 1;
+        }
+        if(end > begin)
+            res.push_back(Chunk{.begin = begin, .end = end, .tokens = {}, .error = {}, .failure = {}});
+        begin = end;
+    }
+    return res;
+}
+
+}
+
+std::vector<Token> lex_parallel(std::string_view code, unsigned threads) {
+    auto count = std::min<std::size_t>(std::max(threads, 1u), code.size() / min_chunk_size);
+    if(count <= 1)
+        return lex(code);
+
+    auto chunks = split(code, count);
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(chunks.size() - 1);
+        for(std::size_t i = 1; i < chunks.size(); i++)
+            workers.emplace_back([&chunk = chunks[i], code] { chunk.lex(code); });
+        chunks[0].lex(code);
+    }
+    for(const auto& chunk : chunks)
+        if(chunk.failure)
+            std::rethrow_exception(chunk.failure);
+
+    // Stitching the chunks together: the sequential lexer continues from the end
+    // of the last accepted token until it produces a token that the next chunk
+    // has as well. Normally that is the first token of the chunk, unless the chunk
+    // began inside a comment, a string, or a token that crossed the boundary.
+    std::vector<Token> res;
+    std::size_t total = 0;
+    for(const auto& chunk : chunks)
+        total += chunk.tokens.size();
+    res.reserve(total);
+    Lexer lexer(code);
+    std::optional<Token> pending; // lexed sequentially, but beyond the chunk being stitched
+
+    for(auto& chunk : chunks) {
+        while(true) {
+            if(!pending) {
+                lexer.seek(res.empty() ? 0 : res.back().end_pos);
+                pending = lexer.next();
+                if(!pending)
+                    return res;
+            }
+            if(pending->begin_pos >= chunk.end)
+                break;
+
+            auto synced = std::ranges::lower_bound(chunk.tokens, pending->begin_pos, {}, &Token::begin_pos);
+            if(synced != chunk.tokens.end() && synced->begin_pos == pending->begin_pos) {
+                res.insert(res.end(), std::make_move_iterator(synced), std::make_move_iterator(chunk.tokens.end()));
+                pending.reset();
+                if(chunk.error)
+                    throw *chunk.error;
+                break;
+            }
+            res.push_back(std::move(*pending));
+            pending.reset();
+        }
+    }
+    return res;
+}
+
+}
@@ -0,0 +1,81 @@
+#include "mycomp/mapped_source.hpp"
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mycomp {
+
+namespace {
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Closes the descriptor once the file is mapped (or the mapping failed)
+struct FileDescriptor {
+    int fd;
+
+    ~FileDescriptor() {
+        if(fd >= 0)
+            ::close(fd);
+    }
+};
+
+}
+
+MappedSource::MappedSource(const std::filesystem::path& path) {
+    FileDescriptor file{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if(file.fd < 0)
+        throw_errno("open " + path.string());
+
+    struct stat st{};
+    if(::fstat(file.fd, &st) != 0)
+        throw_errno("stat " + path.string());
+    // mmap() does not accept empty mappings
+    if(st.st_size == 0)
+        return;
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if(data == MAP_FAILED)
+        throw_errno("mmap " + path.string());
+    // Only a hint, so failures are ignored
+    ::madvise(data, size, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const char*>(data);
+    size_ = size;
+}
+
+MappedSource::~MappedSource() {
+    if(data_)
+        ::munmap(const_cast<char*>(data_), size_);
+}
+
+MappedSource::MappedSource(MappedSource&& other) noexcept :
+    data_(std::exchange(other.data_, nullptr)),
+    size_(std::exchange(other.size_, 0))
+{}
+
+MappedSource& MappedSource::operator=(MappedSource&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+}
+
+
+LexedFile lex_file(const std::filesystem::path& path) {
+    LexedFile res{.source = std::make_shared<const MappedSource>(path), .tokens = {}};
+    Lexer lexer(res.source->text());
+    while(auto tok = lexer.nextWithoutText())
+        res.tokens.push_back(std::move(*tok));
+    return res;
+}
+
+}
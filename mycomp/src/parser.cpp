@@ -0,0 +1,230 @@
+#include "mycomp/parser.hpp"
+
+#include <fmt/core.h>
+#include <magic_enum.hpp>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mycomp {
+
+namespace {
+
+using enum TokenType;
+using enum AstNodeType;
+
+// 0 for tokens that are not binary operators
+constexpr auto binary_precedence = [] {
+    std::array<int, magic_enum::enum_count<TokenType>()> res{};
+    auto set = [&](TokenType type, int precedence) {
+        res[static_cast<std::size_t>(type)] = precedence;
+    };
+    set(EQUALS, 1);
+    set(NOT_EQ, 1);
+    set(LESS_THAN, 2);
+    set(GREATER_THAN, 2);
+    set(PLUS, 3);
+    set(MINUS, 3);
+    set(STAR, 4);
+    set(DIV, 4);
+    return res;
+}();
+
+constexpr auto starts_expr = [] {
+    std::array<bool, magic_enum::enum_count<TokenType>()> res{};
+    for(auto type : {NATURAL_NUMBER, REAL_NUMBER, STRING, IDENTIFIER, TRUE, FALSE,
+                     LEFT_PAREN, MINUS, NOT, LEFT_BRACE, IF, RETURN})
+        res[static_cast<std::size_t>(type)] = true;
+    return res;
+}();
+
+struct Parser {
+    Parser(std::string_view code, AstArena& arena) : lexer_(code), end_(code.size()), arena_(arena) {
+        tok_ = lexer_.next();
+    }
+
+    std::vector<DeclPtr> parseModule() {
+        std::vector<DeclPtr> res;
+        while(tok_) {
+            res.push_back(parseDecl());
+            expect(SEMICOLON);
+        }
+        return res;
+    }
+
+    ExprPtr parseExpr(int min_precedence = 1) {
+        auto lhs = parsePrefix();
+        while(tok_) {
+            auto precedence = binary_precedence[static_cast<std::size_t>(tok_->tokenType)];
+            if(precedence < min_precedence) // also for non-operators, since min_precedence >= 1
+                break;
+            auto op = take();
+            // Operands of the same precedence go to the left, hence the + 1
+            auto rhs = parseExpr(precedence + 1);
+            lhs = node(AstNodeBody<BINARY_EXPR>{.op = std::move(op), .lhs = std::move(lhs), .rhs = std::move(rhs)});
+        }
+        return lhs;
+    }
+
+    bool atEnd() const {
+        return !tok_;
+    }
+
+    [[noreturn]] void fail(std::string error) const {
+        if(!tok_)
+            throw ParseException{.begin_pos = end_, .end_pos = end_, .error = std::move(error)};
+        throw ParseException{.begin_pos = tok_->begin_pos, .end_pos = tok_->end_pos, .error = std::move(error)};
+    }
+
+private:
+    bool at(TokenType type) const {
+        return tok_ && tok_->tokenType == type;
+    }
+
+    Token take() {
+        auto res = std::move(*tok_);
+        tok_ = lexer_.next();
+        return res;
+    }
+
+    Token expect(TokenType type) {
+        if(!at(type))
+            fail(fmt::format("Expected {}", magic_enum::enum_name(type)));
+        return take();
+    }
+
+    template<AstNodeType type>
+    AstPtr<AstNodeBody<type>::category> node(AstNodeBody<type> body) {
+        return make_ast_node(arena_, std::move(body));
+    }
+
+    TypePtr parseType() {
+        return node(AstNodeBody<PRIMITIVE_TYPE>{.body = expect(IDENTIFIER)});
+    }
+
+    DeclPtr parseDecl() {
+        if(at(VAR)) {
+            take();
+            auto type = parseType();
+            auto name = expect(IDENTIFIER);
+            expect(ASSIGN);
+            return node(AstNodeBody<VARIABLE_DECL>{.name = std::move(name), .type = std::move(type), .value = parseExpr()});
+        }
+        if(at(FUN)) {
+            take();
+            auto type = parseType();
+            auto name = expect(IDENTIFIER);
+            expect(LEFT_PAREN);
+            expect(RIGHT_PAREN);
+            return node(AstNodeBody<FUNCTION_DECL>{.name = std::move(name), .type = std::move(type)});
+        }
+        fail("Expected a declaration");
+    }
+
+    ExprPtr parsePrefix() {
+        if(!tok_)
+            fail("Expected an expression");
+
+        auto type = tok_->tokenType;
+        if(type == NATURAL_NUMBER || type == REAL_NUMBER || type == STRING
+            || type == IDENTIFIER || type == TRUE || type == FALSE)
+            return node(AstNodeBody<LITERAL_EXPR>{.body = take()});
+        if(type == LEFT_PAREN) {
+            take();
+            auto res = parseExpr();
+            expect(RIGHT_PAREN);
+            return res;
+        }
+        if(type == MINUS || type == NOT) {
+            auto op = take();
+            return node(AstNodeBody<UNARY_EXPR>{.op = std::move(op), .expr = parsePrefix()});
+        }
+        if(type == LEFT_BRACE)
+            return parseCompound();
+        if(type == IF)
+            return parseIf();
+        if(type == RETURN) {
+            take();
+            ExprPtr result = nullptr;
+            if(tok_ && starts_expr[static_cast<std::size_t>(tok_->tokenType)])
+                result = parseExpr();
+            return node(AstNodeBody<RETURN_EXPR>{.result = std::move(result)});
+        }
+        fail("Expected an expression");
+    }
+
+    ExprPtr parseIf() {
+        expect(IF);
+        auto cond = parseExpr();
+        auto on_true = parseCompound();
+        ExprPtr on_false = nullptr;
+        if(at(ELSE)) {
+            take();
+            on_false = at(IF) ? parseIf() : parseCompound();
+        }
+        return node(AstNodeBody<IF_EXPR>{.cond = std::move(cond), .on_true = std::move(on_true), .on_false = std::move(on_false)});
+    }
+
+    // An assignment is told apart from an expression statement only by the '='
+    // after it, so the target is parsed as an expression first
+    ExprPtr parseCompound() {
+        expect(LEFT_BRACE);
+        AstNodeBody<COMPOUND_EXPR> res;
+        while(!at(RIGHT_BRACE)) {
+            if(at(VAR) || at(FUN)) {
+                res.preface.emplace_back(parseDecl());
+                expect(SEMICOLON);
+                continue;
+            }
+
+            auto expr = parseExpr();
+            if(at(ASSIGN) && expr->type() == LITERAL_EXPR) {
+                auto& target = body_of<LITERAL_EXPR>(*expr).body;
+                if(target.tokenType == IDENTIFIER) {
+                    take();
+                    res.preface.emplace_back(node(AstNodeBody<ASSIGNMENT_STMT>{.var = std::move(target), .value = parseExpr()}));
+                    expect(SEMICOLON);
+                    continue;
+                }
+            }
+            if(at(RIGHT_BRACE)) {
+                res.last = std::move(expr);
+                break;
+            }
+            if(!at(SEMICOLON))
+                fail("Expected SEMICOLON or RIGHT_BRACE");
+            take();
+            res.preface.emplace_back(node(AstNodeBody<EXPR_STMT>{.body = std::move(expr)}));
+        }
+        expect(RIGHT_BRACE);
+        return node(std::move(res));
+    }
+
+    Lexer lexer_;
+    std::optional<Token> tok_;
+    std::size_t end_;
+    AstArena& arena_;
+};
+
+}
+
+ModulePtr parse(std::string_view code) {
+    auto arena = std::make_unique<AstArena>();
+    auto decls = Parser(code, *arena).parseModule();
+    return make_ast_node(AstNodeBody<MODULE>{.arena = std::move(arena), .decls = std::move(decls)});
+}
+
+ExprPtr parse_expr(std::string_view code, AstArena& arena) {
+    Parser parser(code, arena);
+    auto res = parser.parseExpr();
+    if(!parser.atEnd())
+        parser.fail("Expected the end of the expression");
+    return res;
+}
+
+}
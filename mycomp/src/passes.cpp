@@ -0,0 +1,47 @@
+#include "mycomp/passes.hpp"
+
+#include <utility>
+
+namespace mycomp {
+
+PassManager& PassManager::add(std::string name, AstPass pass) {
+    passes_.push_back(std::move(pass));
+    statistics_.push_back({.name = std::move(name)});
+    return *this;
+}
+
+bool PassManager::run(AstNodeBody<AstNodeType::MODULE>& module, std::size_t max_rounds) {
+    bool res = false;
+    for(std::size_t round = 0; round < max_rounds; round++) {
+        bool changed = false;
+        for(std::size_t i = 0; i < passes_.size(); i++) {
+            statistics_[i].runs++;
+            if(passes_[i](module)) {
+                statistics_[i].changes++;
+                changed = true;
+            }
+        }
+        if(!changed)
+            break;
+        res = true;
+    }
+    return res;
+}
+
+PassManager default_passes() {
+    PassManager res;
+    res.add("fold_constants", [](AstNodeBody<AstNodeType::MODULE>& module) {
+        return fold_constants(module);
+    });
+    return res;
+}
+
+PassManager default_passes(TaskScheduler& scheduler) {
+    PassManager res;
+    res.add("fold_constants", [&scheduler](AstNodeBody<AstNodeType::MODULE>& module) {
+        return fold_constants(module, scheduler);
+    });
+    return res;
+}
+
+}
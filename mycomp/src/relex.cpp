@@ -0,0 +1,50 @@
+#include "mycomp/lex.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace mycomp {
+
+void relex(std::vector<Token>& tokens, std::string_view new_code, const TextEdit& edit) {
+    // The lexer looks at most one character past the end of a token,
+    // so the tokens ending before the edit are not affected by it
+    auto first = std::ranges::lower_bound(tokens, edit.offset, {}, &Token::end_pos);
+    auto restart = first == tokens.begin() ? 0 : std::prev(first)->end_pos;
+
+    auto new_end = edit.offset + edit.inserted.size();
+    auto shift = [&](std::size_t pos) {
+        return pos - edit.removed + edit.inserted.size();
+    };
+
+    // The old tokens after the edit can be reused as soon as a new token begins
+    // where one of them (shifted) does, since the lexer has no state besides
+    // its position and the rest of the code is the same
+    std::vector<Token> relexed;
+    auto synced = tokens.end();
+    Lexer lexer(new_code);
+    lexer.seek(restart);
+    while(auto tok = lexer.next()) {
+        if(tok->begin_pos >= new_end) {
+            // Where the token would begin in the old code, which is past the removed part
+            auto old_begin = tok->begin_pos + edit.removed - edit.inserted.size();
+            auto old = std::ranges::lower_bound(first, tokens.end(), old_begin, {}, &Token::begin_pos);
+            if(old != tokens.end() && old->begin_pos == old_begin) {
+                synced = old;
+                break;
+            }
+        }
+        relexed.push_back(std::move(*tok));
+    }
+
+    for(auto it = synced; it != tokens.end(); ++it) {
+        it->begin_pos = shift(it->begin_pos);
+        it->end_pos = shift(it->end_pos);
+    }
+    auto pos = tokens.erase(first, synced);
+    tokens.insert(pos, std::make_move_iterator(relexed.begin()), std::make_move_iterator(relexed.end()));
+}
+
+}
@@ -0,0 +1,326 @@
+#include "mycomp/serialized_ast.hpp"
+#include "mycomp/utils/hash.hpp"
+
+#include <fmt/core.h>
+#include <magic_enum.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mycomp {
+
+namespace {
+
+using enum AstNodeType;
+using enum TokenType;
+
+struct Section {
+    std::uint64_t offset, count; // in bytes from the start, in elements
+};
+
+struct Header {
+    std::array<char, 8> magic;
+    std::uint32_t byte_order;
+    std::uint32_t version;
+    std::uint64_t size; // of the whole file
+    std::uint64_t source_size, source_hash;
+    Section nodes, lists, tokens, numbers, strings, chars;
+};
+
+static_assert(sizeof(Header) == 136);
+
+constexpr std::array<char, 8> magic = {'m', 'y', 'c', '-', 'a', 's', 't', '\0'};
+// Reads as another number on a machine of the other byte order
+constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+[[noreturn]] void fail(const std::string& what) {
+    throw SerializedAstError("Malformed serialized AST: " + what);
+}
+
+template<typename T>
+std::span<const T> section(std::span<const std::byte> bytes, const Section& s, const char* name) {
+    if(s.offset % alignof(T) != 0 || s.offset > bytes.size() || s.count > (bytes.size() - s.offset) / sizeof(T))
+        fail(fmt::format("the {} are out of bounds", name));
+    return {reinterpret_cast<const T*>(bytes.data() + s.offset), static_cast<std::size_t>(s.count)};
+}
+
+bool is_name(TokenType type) {
+    return type == IDENTIFIER || type == STRING;
+}
+
+bool is_number(TokenType type) {
+    return type == NATURAL_NUMBER || type == REAL_NUMBER;
+}
+
+// The kinds of tokens that the parser puts into nodes, by what they are for
+constexpr TokenType name_tokens[] = {IDENTIFIER};
+constexpr TokenType literal_tokens[] = {NATURAL_NUMBER, REAL_NUMBER, STRING, IDENTIFIER, TRUE, FALSE};
+constexpr TokenType unary_tokens[] = {MINUS, NOT};
+constexpr TokenType binary_tokens[] = {EQUALS, NOT_EQ, LESS_THAN, GREATER_THAN, PLUS, MINUS, STAR, DIV};
+
+}
+
+std::vector<std::byte> serialize(const FlatAst& ast, std::string_view source) {
+    // The numbers and names of the tokens, each name stored once
+    const auto& stream = ast.tokens();
+    std::vector<CompactToken> tokens(stream.tokens().begin(), stream.tokens().end());
+    std::vector<std::uint64_t> numbers;
+    std::vector<SerializedAst::String> strings;
+    std::string chars;
+    std::unordered_map<std::uint32_t, std::uint32_t> string_ids;
+    for(auto& token : tokens) {
+        if(token.tokenType == NATURAL_NUMBER || token.tokenType == REAL_NUMBER) {
+            auto value = token.tokenType == NATURAL_NUMBER ? stream.natural(token) : std::bit_cast<std::uint64_t>(stream.real(token));
+            token.payload = static_cast<std::uint32_t>(numbers.size());
+            numbers.push_back(value);
+        } else if(is_name(token.tokenType)) {
+            auto [it, inserted] = string_ids.try_emplace(token.payload, static_cast<std::uint32_t>(strings.size()));
+            if(inserted) {
+                auto text = stream.text(token);
+                if(text.size() > std::numeric_limits<std::uint32_t>::max() - chars.size())
+                    throw std::length_error("Too many names for a serialized AST");
+                strings.push_back({.offset = static_cast<std::uint32_t>(chars.size()), .size = static_cast<std::uint32_t>(text.size())});
+                chars += text;
+            }
+            token.payload = it->second;
+        } else {
+            token.payload = 0;
+        }
+    }
+
+    Header header{
+        .magic = magic,
+        .byte_order = byte_order_mark,
+        .version = serialized_ast_version,
+        .size = 0,
+        .source_size = source.size(),
+        .source_hash = xxh64(source),
+        .nodes = {}, .lists = {}, .tokens = {}, .numbers = {}, .strings = {}, .chars = {}
+    };
+    // Every section starts 8-aligned, so that it can be read in place
+    std::uint64_t size = sizeof(Header);
+    auto place = [&](Section& s, std::size_t count, std::size_t element_size) {
+        size = (size + 7) / 8 * 8;
+        s = {.offset = size, .count = count};
+        size += count * element_size;
+    };
+    place(header.nodes, ast.nodes_.size(), sizeof(FlatNode));
+    place(header.lists, ast.lists_.size(), sizeof(FlatNodeId));
+    place(header.tokens, tokens.size(), sizeof(CompactToken));
+    place(header.numbers, numbers.size(), sizeof(std::uint64_t));
+    place(header.strings, strings.size(), sizeof(SerializedAst::String));
+    place(header.chars, chars.size(), 1);
+    header.size = size;
+
+    std::vector<std::byte> res(size);
+    auto write = [&](const Section& s, const void* data, std::size_t bytes) {
+        if(bytes > 0)
+            std::memcpy(res.data() + s.offset, data, bytes);
+    };
+    std::memcpy(res.data(), &header, sizeof(Header));
+    write(header.nodes, ast.nodes_.data(), ast.nodes_.size() * sizeof(FlatNode));
+    write(header.lists, ast.lists_.data(), ast.lists_.size() * sizeof(FlatNodeId));
+    write(header.tokens, tokens.data(), tokens.size() * sizeof(CompactToken));
+    write(header.numbers, numbers.data(), numbers.size() * sizeof(std::uint64_t));
+    write(header.strings, strings.data(), strings.size() * sizeof(SerializedAst::String));
+    write(header.chars, chars.data(), chars.size());
+    return res;
+}
+
+
+SerializedAst::SerializedAst(std::span<const std::byte> bytes) {
+    Header header;
+    if(bytes.size() < sizeof(Header))
+        fail("too short for the header");
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+    if(header.magic != magic)
+        fail("not a serialized AST");
+    if(header.byte_order != byte_order_mark)
+        fail("written on a machine of another byte order");
+    if(header.version != serialized_ast_version)
+        throw SerializedAstError(fmt::format(
+            "Serialized AST of version {}, expected {}", header.version, serialized_ast_version
+        ));
+    if(header.size != bytes.size())
+        fail("truncated");
+    if(reinterpret_cast<std::uintptr_t>(bytes.data()) % 8 != 0)
+        throw std::invalid_argument("A serialized AST must be 8-aligned in memory");
+
+    source_size_ = header.source_size;
+    source_hash_ = header.source_hash;
+    nodes_ = section<FlatNode>(bytes, header.nodes, "nodes");
+    lists_ = section<FlatNodeId>(bytes, header.lists, "lists");
+    tokens_ = section<CompactToken>(bytes, header.tokens, "tokens");
+    numbers_ = section<std::uint64_t>(bytes, header.numbers, "numbers");
+    strings_ = section<String>(bytes, header.strings, "strings");
+    auto chars = section<char>(bytes, header.chars, "names");
+    chars_ = std::string_view(chars.data(), chars.size());
+
+    for(const auto& s : strings_) {
+        if(s.offset > chars_.size() || s.size > chars_.size() - s.offset)
+            fail("a name is out of bounds");
+    }
+    for(const auto& token : tokens_) {
+        if(static_cast<std::size_t>(token.tokenType) >= magic_enum::enum_count<TokenType>())
+            fail("a token of unknown type");
+        if((is_number(token.tokenType) && token.payload >= numbers_.size()) || (is_name(token.tokenType) && token.payload >= strings_.size()))
+            fail("a token payload is out of bounds");
+    }
+
+    // Children come before their parents, as in a FlatAst, are of the
+    // category their parent expects and have exactly one parent, only the
+    // children that may be missing from the tree are, and tokens are of the
+    // kinds the parser gives each node, so that unflatten() and whatever reads
+    // the tree after it can trust them
+    if(nodes_.empty() || nodes_.back().type != MODULE)
+        fail("the root is not a module");
+    std::vector<bool> has_parent(nodes_.size());
+    for(std::uint32_t i = 0; i < nodes_.size(); i++) {
+        const auto& node = nodes_[i];
+        if(static_cast<std::size_t>(node.type) >= magic_enum::enum_count<AstNodeType>())
+            fail("a node of unknown type");
+
+        auto check = [&](std::uint32_t id, std::initializer_list<AstCategoryType> categories) {
+            if(id >= i || std::ranges::find(categories, ast_category(nodes_[id].type)) == categories.end())
+                fail(fmt::format("node {} has a wrong child", i));
+            if(has_parent[id])
+                fail(fmt::format("node {} has more than one parent", id));
+            has_parent[id] = true;
+        };
+        auto missing = [&](std::size_t ind) {
+            return node.children[ind] == std::uint32_t(FlatNodeId::NONE);
+        };
+        auto required = [&](std::size_t ind, AstCategoryType category) {
+            if(missing(ind))
+                fail(fmt::format("node {} lacks a child", i));
+            check(node.children[ind], {category});
+        };
+        auto optional = [&](std::size_t ind, AstCategoryType category) {
+            if(!missing(ind))
+                check(node.children[ind], {category});
+        };
+        auto unused = [&](std::initializer_list<std::size_t> inds) {
+            for(auto ind : inds)
+                if(!missing(ind))
+                    fail(fmt::format("node {} has too many children", i));
+        };
+        auto list = [&](std::initializer_list<AstCategoryType> categories) {
+            auto [begin, size] = std::pair(node.children[0], node.children[1]);
+            if(begin > lists_.size() || size > lists_.size() - begin)
+                fail(fmt::format("the list of node {} is out of bounds", i));
+            for(auto id : lists_.subspan(begin, size))
+                check(static_cast<std::uint32_t>(id), categories);
+        };
+
+        // Empty for nodes without a token
+        std::span<const TokenType> token_types;
+        switch(node.type) {
+        case MODULE:
+            if(i != nodes_.size() - 1)
+                fail("a module inside a module");
+            list({AstCategoryType::DECLARATION});
+            unused({2});
+            break;
+        case PRIMITIVE_TYPE:
+            token_types = name_tokens;
+            unused({0, 1, 2});
+            break;
+        case LITERAL_EXPR:
+            token_types = literal_tokens;
+            unused({0, 1, 2});
+            break;
+        case FUNCTION_DECL:
+            token_types = name_tokens;
+            required(0, AstCategoryType::TYPE);
+            unused({1, 2});
+            break;
+        case VARIABLE_DECL:
+            token_types = name_tokens;
+            required(0, AstCategoryType::TYPE);
+            required(1, AstCategoryType::EXPRESSION);
+            unused({2});
+            break;
+        case ASSIGNMENT_STMT:
+            token_types = name_tokens;
+            required(0, AstCategoryType::EXPRESSION);
+            unused({1, 2});
+            break;
+        case UNARY_EXPR:
+            token_types = unary_tokens;
+            required(0, AstCategoryType::EXPRESSION);
+            unused({1, 2});
+            break;
+        case EXPR_STMT:
+            required(0, AstCategoryType::EXPRESSION);
+            unused({1, 2});
+            break;
+        case RETURN_EXPR:
+            optional(0, AstCategoryType::EXPRESSION);
+            unused({1, 2});
+            break;
+        case BINARY_EXPR:
+            token_types = binary_tokens;
+            required(0, AstCategoryType::EXPRESSION);
+            required(1, AstCategoryType::EXPRESSION);
+            unused({2});
+            break;
+        case COMPOUND_EXPR:
+            list({AstCategoryType::DECLARATION, AstCategoryType::STATEMENT});
+            optional(2, AstCategoryType::EXPRESSION);
+            break;
+        case IF_EXPR:
+            required(0, AstCategoryType::EXPRESSION);
+            required(1, AstCategoryType::EXPRESSION);
+            optional(2, AstCategoryType::EXPRESSION);
+            break;
+        }
+        if(token_types.empty() && node.token != no_flat_token)
+            fail(fmt::format("node {} has a token", i));
+        if(!token_types.empty() && node.token >= tokens_.size())
+            fail(fmt::format("node {} lacks a token", i));
+        if(!token_types.empty() && std::ranges::find(token_types, tokens_[node.token].tokenType) == token_types.end())
+            fail(fmt::format("node {} has a token of the wrong kind", i));
+    }
+    // Nodes that nothing refers to would be left out of the tree
+    if(std::ranges::count(has_parent, false) != 1)
+        fail("a node outside the tree");
+}
+
+Token SerializedAst::token(const FlatNode& node) const {
+    const auto& compact = tokens_[node.token];
+    Token res{
+        .tokenType=compact.tokenType,
+        .begin_pos=compact.begin_pos,
+        .end_pos=compact.end_pos
+    };
+    if(compact.tokenType == NATURAL_NUMBER)
+        res.payload = numbers_[compact.payload];
+    else if(compact.tokenType == REAL_NUMBER)
+        res.payload = std::bit_cast<double>(numbers_[compact.payload]);
+    else if(is_name(compact.tokenType))
+        res.payload = std::string(text(compact));
+    return res;
+}
+
+std::string_view SerializedAst::text(const CompactToken& token) const {
+    auto [offset, size] = strings_[token.payload];
+    return chars_.substr(offset, size);
+}
+
+
+MappedAst::MappedAst(const std::filesystem::path& path) :
+    file_(path),
+    ast_(std::as_bytes(std::span(file_.text())))
+{}
+
+}
@@ -0,0 +1,240 @@
+#include "mycomp/lex.hpp"
+#include "mycomp/utils/char_class.hpp"
+#include "mycomp/utils/simd.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#ifdef MYCOMP_X86
+#include <immintrin.h>
+#endif
+
+namespace mycomp {
+
+static constexpr bool is_space(char c) {
+    return has_char_class(c, char_class::SPACE);
+}
+
+// Errors stop skipping at the beginning of the malformed comment
+static std::size_t unterminated(std::size_t ind_start, std::optional<LexException>& error) {
+    error = LexException{
+        .begin_pos=ind_start,
+        .end_pos=ind_start + 2,
+        .error="Inline comment not terminated!"
+    };
+    return ind_start;
+}
+
+static std::size_t unexpected_terminator(std::size_t ind, std::optional<LexException>& error) {
+    error = LexException{
+        .begin_pos=ind,
+        .end_pos=ind + 2,
+        .error="Unexpected inline comment terminator encountered!"
+    };
+    return ind;
+}
+
+
+// The reference implementation, one character at a time.
+static std::size_t skip_scalar(std::string_view code, std::size_t pos, std::optional<LexException>& error) {
+    auto substr2 = [&] { return code.substr(pos, 2); };
+    while(pos < code.size()) {
+        if(is_space(code[pos]))
+            pos++;
+        else if(substr2() == "//")
+            while(pos < code.size() && code[pos] != '\n')
+                pos++;
+        else if(substr2() == "/*") {
+            auto ind_start = pos;
+            pos += 2;
+            while(substr2() != "*/") {
+                pos = std::min(pos + 1, code.size());
+                if(pos == code.size())
+                    return unterminated(ind_start, error);
+            }
+            pos += 2;
+        } else if(substr2() == "*/")
+            return unexpected_terminator(pos, error);
+        else
+            break;
+    }
+    return pos;
+}
+
+
+// The vectorized implementations share the same driver and only differ in
+// how they find the end of a whitespace run, a line comment and a block comment.
+// Every finder returns code.size() if there is no match.
+template<typename Finders>
+static std::size_t skip_vectorized(std::string_view code, std::size_t pos, std::optional<LexException>& error) {
+    while(pos < code.size()) {
+        char c = code[pos];
+        char c2 = pos + 1 < code.size() ? code[pos + 1] : '\n';
+        if(is_space(c))
+            pos = Finders::non_space(code, pos + 1);
+        else if(c == '/' && c2 == '/')
+            pos = Finders::newline(code, pos + 2);
+        else if(c == '/' && c2 == '*') {
+            auto end = Finders::comment_end(code, pos + 2);
+            if(end == code.size())
+                return unterminated(pos, error);
+            pos = end + 2;
+        } else if(c == '*' && c2 == '/')
+            return unexpected_terminator(pos, error);
+        else
+            break;
+    }
+    return pos;
+}
+
+#ifdef MYCOMP_X86
+
+// A bit mask of matches inside a vector: 16 or 32 meaningful bits
+using MatchMask = unsigned;
+
+static std::size_t first_match(std::size_t pos, MatchMask mask) {
+    return pos + static_cast<std::size_t>(std::countr_zero(mask));
+}
+
+struct Sse42Finders {
+    static constexpr std::size_t width = 16;
+
+    MYCOMP_TARGET_SSE42
+    static std::size_t non_space(std::string_view code, std::size_t pos) {
+        // PCMPESTRI in ranges mode: ['\t', '\r'] and [' ', ' '], negated
+        const __m128i ranges = _mm_setr_epi8('\t', '\r', ' ', ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        for(; pos + width <= code.size(); pos += width) {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code.data() + pos));
+            int ind = _mm_cmpestri(
+                ranges, 4, chunk, width,
+                _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT
+            );
+            if(ind != width)
+                return pos + static_cast<std::size_t>(ind);
+        }
+        while(pos < code.size() && is_space(code[pos]))
+            pos++;
+        return pos;
+    }
+
+    MYCOMP_TARGET_SSE42
+    static std::size_t newline(std::string_view code, std::size_t pos) {
+        const __m128i nl = _mm_set1_epi8('\n');
+        for(; pos + width <= code.size(); pos += width) {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code.data() + pos));
+            auto mask = static_cast<MatchMask>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl)));
+            if(mask)
+                return first_match(pos, mask);
+        }
+        while(pos < code.size() && code[pos] != '\n')
+            pos++;
+        return pos;
+    }
+
+    MYCOMP_TARGET_SSE42
+    static std::size_t comment_end(std::string_view code, std::size_t pos) {
+        const __m128i star = _mm_set1_epi8('*'), slash = _mm_set1_epi8('/');
+        for(; pos + width + 1 <= code.size(); pos += width) {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code.data() + pos));
+            auto next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code.data() + pos + 1));
+            auto mask = static_cast<MatchMask>(_mm_movemask_epi8(_mm_and_si128(
+                _mm_cmpeq_epi8(chunk, star),
+                _mm_cmpeq_epi8(next, slash)
+            )));
+            if(mask)
+                return first_match(pos, mask);
+        }
+        for(; pos + 1 < code.size(); pos++)
+            if(code[pos] == '*' && code[pos + 1] == '/')
+                return pos;
+        return code.size();
+    }
+};
+
+struct Avx2Finders {
+    static constexpr std::size_t width = 32;
+
+    MYCOMP_TARGET_AVX2
+    static std::size_t non_space(std::string_view code, std::size_t pos) {
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i tab = _mm256_set1_epi8('\t');
+        const __m256i range = _mm256_set1_epi8('\r' - '\t');
+        for(; pos + width <= code.size(); pos += width) {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code.data() + pos));
+            // c - '\t' <= '\r' - '\t' as unsigned bytes
+            auto shifted = _mm256_sub_epi8(chunk, tab);
+            auto in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, range), shifted);
+            auto spaces = _mm256_or_si256(in_range, _mm256_cmpeq_epi8(chunk, space));
+            auto mask = ~static_cast<MatchMask>(_mm256_movemask_epi8(spaces));
+            if(mask)
+                return first_match(pos, mask);
+        }
+        return Sse42Finders::non_space(code, pos);
+    }
+
+    MYCOMP_TARGET_AVX2
+    static std::size_t newline(std::string_view code, std::size_t pos) {
+        const __m256i nl = _mm256_set1_epi8('\n');
+        for(; pos + width <= code.size(); pos += width) {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code.data() + pos));
+            auto mask = static_cast<MatchMask>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl)));
+            if(mask)
+                return first_match(pos, mask);
+        }
+        return Sse42Finders::newline(code, pos);
+    }
+
+    MYCOMP_TARGET_AVX2
+    static std::size_t comment_end(std::string_view code, std::size_t pos) {
+        const __m256i star = _mm256_set1_epi8('*'), slash = _mm256_set1_epi8('/');
+        for(; pos + width + 1 <= code.size(); pos += width) {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code.data() + pos));
+            auto next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code.data() + pos + 1));
+            auto mask = static_cast<MatchMask>(_mm256_movemask_epi8(_mm256_and_si256(
+                _mm256_cmpeq_epi8(chunk, star),
+                _mm256_cmpeq_epi8(next, slash)
+            )));
+            if(mask)
+                return first_match(pos, mask);
+        }
+        return Sse42Finders::comment_end(code, pos);
+    }
+};
+
+#endif
+
+
+std::size_t detail::skip_whitespace_and_comments(
+    std::string_view code,
+    std::size_t pos,
+    SimdLevel simd,
+    std::optional<LexException>& error
+) {
+    switch(simd) {
+#ifdef MYCOMP_X86
+    case SimdLevel::AVX2:
+        return skip_vectorized<Avx2Finders>(code, pos, error);
+    case SimdLevel::SSE42:
+        return skip_vectorized<Sse42Finders>(code, pos, error);
+#else
+    case SimdLevel::AVX2:
+    case SimdLevel::SSE42:
+#endif
+    case SimdLevel::SCALAR:
+        break;
+    }
+    return skip_scalar(code, pos, error);
+}
+
+std::size_t skip_whitespace_and_comments(std::string_view code, std::size_t pos, SimdLevel simd) {
+    std::optional<LexException> error;
+    auto res = detail::skip_whitespace_and_comments(code, pos, simd, error);
+    if(error)
+        throw std::move(*error);
+    return res;
+}
+
+}
@@ -0,0 +1,156 @@
+#include "mycomp/stream_lexer.hpp"
+#include "mycomp/utils/char_class.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <unistd.h>
+
+namespace mycomp {
+
+namespace {
+
+// How far past the end of a token the lexer may look. A token (or an error)
+// that ends closer than that to the end of the buffer may turn out
+// different once more input is there.
+constexpr std::size_t lookahead = 2;
+
+}
+
+StreamLexer::StreamLexer(ReadFunction read, std::size_t chunk_size) :
+    read_(std::move(read)),
+    chunk_size_(std::max<std::size_t>(chunk_size, 1))
+{}
+
+StreamLexer::StreamLexer(int fd, std::size_t chunk_size) :
+    StreamLexer([fd](std::span<char> buf) -> std::size_t {
+        while(true) {
+            auto res = ::read(fd, buf.data(), buf.size());
+            if(res >= 0)
+                return static_cast<std::size_t>(res);
+            if(errno != EINTR)
+                throw std::system_error(errno, std::generic_category(), "read");
+        }
+    }, chunk_size)
+{}
+
+StreamLexer::StreamLexer(std::istream& in, std::size_t chunk_size) :
+    StreamLexer([&in](std::span<char> buf) -> std::size_t {
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        return static_cast<std::size_t>(in.gcount());
+    }, chunk_size)
+{}
+
+
+void StreamLexer::fill() {
+    buf_.erase(0, pos_);
+    base_ += pos_;
+    pos_ = 0;
+
+    auto old_size = buf_.size();
+    buf_.resize(old_size + chunk_size_);
+    auto read = read_(std::span(buf_).subspan(old_size));
+    buf_.resize(old_size + read);
+    eof_ = read == 0;
+}
+
+
+std::optional<Token> StreamLexer::next() {
+    auto absolute = [this](auto&& value) {
+        value.begin_pos += base_;
+        value.end_pos += base_;
+        return std::forward<decltype(value)>(value);
+    };
+
+    while(true) {
+        std::string_view code = buf_;
+
+        if(state_ == State::LINE_COMMENT) {
+            auto newline = code.find('\n', pos_);
+            if(newline == std::string_view::npos) {
+                pos_ = code.size();
+                if(eof_)
+                    state_ = State::CODE;
+                else
+                    fill();
+            } else {
+                pos_ = newline;
+                state_ = State::CODE;
+            }
+            continue;
+        }
+
+        if(state_ == State::BLOCK_COMMENT) {
+            auto end = code.find("*/", pos_);
+            if(end != std::string_view::npos) {
+                pos_ = end + 2;
+                state_ = State::CODE;
+            } else if(eof_) {
+                throw LexException{
+                    .begin_pos=comment_begin_,
+                    .end_pos=comment_begin_ + 2,
+                    .error="Inline comment not terminated!"
+                };
+            } else {
+                // The last character may be the '*' of the terminator
+                pos_ = std::max(pos_, code.size() - 1);
+                fill();
+            }
+            continue;
+        }
+
+        // Before the end of the input, whitespace and comments that reach
+        // the end of the buffer are skipped one at a time, remembering
+        // which kind of comment the buffer ended in
+        auto start = pos_;
+        if(!eof_) {
+            std::size_t skipped = std::string_view::npos;
+            try {
+                skipped = skip_whitespace_and_comments(code, pos_, simd_);
+            } catch(LexException&) {}
+
+            if(skipped == std::string_view::npos || skipped + lookahead > code.size()) {
+                while(start < code.size() && has_char_class(code[start], char_class::SPACE))
+                    start++;
+                if(start + lookahead > code.size()) {
+                    pos_ = start;
+                    fill();
+                    continue;
+                }
+                auto prefix = code.substr(start, 2);
+                if(prefix == "//" || prefix == "/*") {
+                    state_ = prefix == "//" ? State::LINE_COMMENT : State::BLOCK_COMMENT;
+                    comment_begin_ = base_ + start;
+                    pos_ = start + 2;
+                    continue;
+                }
+            } else {
+                start = skipped;
+            }
+        }
+
+        Lexer lexer(code, simd_);
+        lexer.seek(start);
+        std::optional<Token> tok;
+        try {
+            tok = lexer.next();
+        } catch(LexException& e) {
+            if(eof_ || lexer.pos() + lookahead <= code.size())
+                throw absolute(std::move(e));
+        }
+        if(!eof_ && lexer.pos() + lookahead > code.size()) {
+            pos_ = start;
+            fill();
+            continue;
+        }
+        if(!tok)
+            return {};
+        pos_ = tok->end_pos;
+        return absolute(std::move(*tok));
+    }
+}
+
+}
@@ -0,0 +1,101 @@
+#include "mycomp/symbol_table.hpp"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace mycomp {
+
+static std::uint64_t mix(std::uint64_t h) {
+    // the finalizer of MurmurHash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+std::uint64_t hash_bytes(std::string_view bytes) {
+    constexpr std::uint64_t mul = 0x9e3779b97f4a7c15ull;
+    std::uint64_t h = bytes.size() * mul;
+    std::size_t i = 0;
+    for(; i + 8 <= bytes.size(); i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes.data() + i, 8);
+        h = (h ^ word) * mul;
+        h ^= h >> 29;
+    }
+    if(i < bytes.size()) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, bytes.data() + i, bytes.size() - i);
+        h = (h ^ word) * mul;
+    }
+    return mix(h);
+}
+
+std::size_t SymbolTable::findSlot(std::string_view name, std::uint64_t hash) const {
+    auto mask = slots_.size() - 1;
+    auto short_hash = static_cast<std::uint32_t>(hash);
+    for(auto ind = hash & mask;; ind = (ind + 1) & mask) {
+        const auto& slot = slots_[ind];
+        if(slot.id_plus_one == 0)
+            return ind;
+        if(slot.hash == short_hash && names_[slot.id_plus_one - 1] == name)
+            return ind;
+    }
+}
+
+std::optional<SymbolId> SymbolTable::find(std::string_view name) const {
+    const auto& slot = slots_[findSlot(name, hash_bytes(name))];
+    if(slot.id_plus_one == 0)
+        return {};
+    return SymbolId{slot.id_plus_one - 1};
+}
+
+SymbolId SymbolTable::intern(std::string_view name) {
+    auto hash = hash_bytes(name);
+    auto& slot = slots_[findSlot(name, hash)];
+    if(slot.id_plus_one != 0)
+        return SymbolId{slot.id_plus_one - 1};
+
+    if(names_.size() == std::numeric_limits<std::uint32_t>::max() - 1)
+        throw std::length_error("Too many symbols in a SymbolTable");
+
+    auto* chars = static_cast<char*>(chars_.allocate(name.size(), 1));
+    if(!name.empty())
+        std::memcpy(chars, name.data(), name.size());
+    names_.emplace_back(chars, name.size());
+
+    slot = Slot{
+        .hash=static_cast<std::uint32_t>(hash),
+        .id_plus_one=static_cast<std::uint32_t>(names_.size())
+    };
+    if(names_.size() * 2 > slots_.size())
+        grow();
+    return SymbolId{static_cast<std::uint32_t>(names_.size() - 1)};
+}
+
+void SymbolTable::grow() {
+    std::vector<Slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    auto mask = slots_.size() - 1;
+    for(const auto& slot : old) {
+        if(slot.id_plus_one == 0)
+            continue;
+        // the low bits of the full hash are the same as of the short one
+        auto ind = slot.hash & mask;
+        while(slots_[ind].id_plus_one != 0)
+            ind = (ind + 1) & mask;
+        slots_[ind] = slot;
+    }
+}
+
+std::size_t SymbolTable::memoryUsage() const {
+    return
+        chars_.memoryUsage() +
+        names_.capacity() * sizeof(std::string_view) +
+        slots_.capacity() * sizeof(Slot);
+}
+
+}
@@ -0,0 +1,100 @@
+#include "mycomp/token_stream.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+namespace mycomp {
+
+using enum TokenType;
+
+Token TokenStream::operator[](std::size_t ind) const {
+    const auto& compact = tokens_[ind];
+    Token res{
+        .tokenType=compact.tokenType,
+        .begin_pos=compact.begin_pos,
+        .end_pos=compact.end_pos
+    };
+    if(compact.tokenType == NATURAL_NUMBER)
+        res.payload = natural(compact);
+    else if(compact.tokenType == REAL_NUMBER)
+        res.payload = real(compact);
+    else if(compact.tokenType == IDENTIFIER || compact.tokenType == STRING)
+        res.payload = std::string(text(compact));
+    return res;
+}
+
+std::vector<Token> TokenStream::toTokens() const {
+    std::vector<Token> res;
+    res.reserve(size());
+    for(std::size_t i = 0; i < size(); i++)
+        res.push_back((*this)[i]);
+    return res;
+}
+
+std::uint64_t TokenStream::natural(const CompactToken& token) const {
+    return numbers_[token.payload];
+}
+
+double TokenStream::real(const CompactToken& token) const {
+    return std::bit_cast<double>(numbers_[token.payload]);
+}
+
+void TokenStream::push_back(const Token& token, std::string_view text) {
+    if(token.end_pos > std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("Token positions do not fit into a TokenStream");
+    CompactToken res{
+        .begin_pos=static_cast<std::uint32_t>(token.begin_pos),
+        .end_pos=static_cast<std::uint32_t>(token.end_pos),
+        .payload=0,
+        .tokenType=token.tokenType
+    };
+    if(auto* natural = std::get_if<std::uint64_t>(&token.payload)) {
+        res.payload = static_cast<std::uint32_t>(numbers_.size());
+        numbers_.push_back(*natural);
+    } else if(auto* real = std::get_if<double>(&token.payload)) {
+        res.payload = static_cast<std::uint32_t>(numbers_.size());
+        numbers_.push_back(std::bit_cast<std::uint64_t>(*real));
+    } else if(auto* name = std::get_if<std::string>(&token.payload)) {
+        res.payload = static_cast<std::uint32_t>(symbols_->intern(*name));
+    } else if(token.tokenType == IDENTIFIER || token.tokenType == STRING) {
+        res.payload = static_cast<std::uint32_t>(symbols_->intern(text));
+    }
+    tokens_.push_back(res);
+}
+
+void TokenStream::shrink_to_fit() {
+    tokens_.shrink_to_fit();
+    numbers_.shrink_to_fit();
+}
+
+std::size_t TokenStream::memoryUsage() const {
+    return
+        tokens_.capacity() * sizeof(CompactToken) +
+        numbers_.capacity() * sizeof(std::uint64_t) +
+        symbols_->memoryUsage();
+}
+
+
+TokenStream lex_compact(std::string_view code, std::shared_ptr<SymbolTable> symbols) {
+    if(code.size() > std::numeric_limits<std::uint32_t>::max())
+        throw LexException{
+            .begin_pos=0,
+            .end_pos=code.size(),
+            .error="Code is too large for a TokenStream!"
+        };
+
+    TokenStream res(std::move(symbols));
+    Lexer lexer(code);
+    while(auto tok = lexer.nextWithoutText())
+        res.push_back(*tok, token_text(code, *tok));
+    res.shrink_to_fit();
+    return res;
+}
+
+}
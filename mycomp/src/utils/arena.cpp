@@ -0,0 +1,57 @@
+#include "mycomp/utils/arena.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace mycomp {
+
+Arena::Arena(Arena&& other) noexcept :
+    block_size_(other.block_size_),
+    blocks_(std::move(other.blocks_)),
+    curr_(std::exchange(other.curr_, nullptr)),
+    left_(std::exchange(other.left_, 0)),
+    used_(std::exchange(other.used_, 0))
+{
+    other.blocks_.clear();
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if(this != &other) {
+        block_size_ = other.block_size_;
+        blocks_ = std::move(other.blocks_);
+        other.blocks_.clear();
+        curr_ = std::exchange(other.curr_, nullptr);
+        left_ = std::exchange(other.left_, 0);
+        used_ = std::exchange(other.used_, 0);
+    }
+    return *this;
+}
+
+void* Arena::allocateSlow(std::size_t size, std::size_t align) {
+    // Oversized allocations get a block of their own, so that the rest
+    // of the current block is not wasted
+    auto block_size = std::max(block_size_, size + align);
+    blocks_.push_back(std::make_unique_for_overwrite<std::byte[]>(block_size));
+    used_ += block_size;
+    if(block_size != block_size_) {
+        auto* block = blocks_.back().get();
+        auto padding = (align - reinterpret_cast<std::uintptr_t>(block) % align) % align;
+        return block + padding;
+    }
+    curr_ = blocks_.back().get();
+    left_ = block_size;
+    return allocate(size, align);
+}
+
+void Arena::adopt(Arena&& other) {
+    blocks_.reserve(blocks_.size() + other.blocks_.size());
+    for(auto& block : other.blocks_)
+        blocks_.push_back(std::move(block));
+    used_ += other.used_;
+    other.blocks_.clear();
+    other.curr_ = nullptr;
+    other.left_ = 0;
+    other.used_ = 0;
+}
+
+}
@@ -0,0 +1,90 @@
+#include "mycomp/utils/hash.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+namespace mycomp {
+
+namespace {
+
+constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87;
+constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4F;
+constexpr std::uint64_t prime3 = 0x165667B19E3779F9;
+constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63;
+constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5;
+
+// Little-endian reads, so that the hash does not depend on the machine
+std::uint64_t read64(const char* p) {
+    std::uint64_t res;
+    std::memcpy(&res, p, sizeof(res));
+    if constexpr(std::endian::native == std::endian::big)
+        res = __builtin_bswap64(res);
+    return res;
+}
+
+std::uint32_t read32(const char* p) {
+    std::uint32_t res;
+    std::memcpy(&res, p, sizeof(res));
+    if constexpr(std::endian::native == std::endian::big)
+        res = __builtin_bswap32(res);
+    return res;
+}
+
+std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+    acc += input * prime2;
+    return std::rotl(acc, 31) * prime1;
+}
+
+std::uint64_t merge_round(std::uint64_t acc, std::uint64_t value) {
+    acc ^= round(0, value);
+    return acc * prime1 + prime4;
+}
+
+}
+
+std::uint64_t xxh64(std::string_view bytes, std::uint64_t seed) {
+    const char* p = bytes.data();
+    const char* end = p + bytes.size();
+    std::uint64_t acc;
+
+    if(bytes.size() >= 32) {
+        // Four lanes over stripes of 32 bytes
+        std::uint64_t v1 = seed + prime1 + prime2;
+        std::uint64_t v2 = seed + prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - prime1;
+        for(; end - p >= 32; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        acc = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        acc = merge_round(acc, v1);
+        acc = merge_round(acc, v2);
+        acc = merge_round(acc, v3);
+        acc = merge_round(acc, v4);
+    } else {
+        acc = seed + prime5;
+    }
+    acc += bytes.size();
+
+    for(; end - p >= 8; p += 8)
+        acc = std::rotl(acc ^ round(0, read64(p)), 27) * prime1 + prime4;
+    if(end - p >= 4) {
+        acc = std::rotl(acc ^ (read32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+    for(; p != end; p++)
+        acc = std::rotl(acc ^ (static_cast<unsigned char>(*p) * prime5), 11) * prime1;
+
+    acc ^= acc >> 33;
+    acc *= prime2;
+    acc ^= acc >> 29;
+    acc *= prime3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+}
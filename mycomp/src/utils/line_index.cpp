@@ -0,0 +1,91 @@
+#include "mycomp/utils/line_index.hpp"
+#include "mycomp/utils/simd.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#ifdef MYCOMP_X86
+#include <immintrin.h>
+#endif
+
+namespace mycomp {
+
+namespace {
+
+// Every finder appends the position after each '\n' in code[pos, code.size())
+void line_starts_scalar(std::string_view code, std::size_t pos, std::vector<std::size_t>& res) {
+    for(; pos < code.size(); pos++)
+        if(code[pos] == '\n')
+            res.push_back(pos + 1);
+}
+
+void push_matches(std::size_t pos, unsigned mask, std::vector<std::size_t>& res) {
+    for(; mask; mask &= mask - 1)
+        res.push_back(pos + static_cast<std::size_t>(std::countr_zero(mask)) + 1);
+}
+
+#ifdef MYCOMP_X86
+
+MYCOMP_TARGET_SSE42
+void line_starts_sse42(std::string_view code, std::vector<std::size_t>& res) {
+    constexpr std::size_t width = 16;
+    const __m128i nl = _mm_set1_epi8('\n');
+    std::size_t pos = 0;
+    for(; pos + width <= code.size(); pos += width) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code.data() + pos));
+        push_matches(pos, static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl))), res);
+    }
+    line_starts_scalar(code, pos, res);
+}
+
+MYCOMP_TARGET_AVX2
+void line_starts_avx2(std::string_view code, std::vector<std::size_t>& res) {
+    constexpr std::size_t width = 32;
+    const __m256i nl = _mm256_set1_epi8('\n');
+    std::size_t pos = 0;
+    for(; pos + width <= code.size(); pos += width) {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code.data() + pos));
+        push_matches(pos, static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl))), res);
+    }
+    line_starts_scalar(code, pos, res);
+}
+
+#endif
+
+}
+
+LineIndex::LineIndex(std::string_view code, SimdLevel simd) : size_(code.size()) {
+    line_starts_.push_back(0);
+    switch(simd) {
+#ifdef MYCOMP_X86
+    case SimdLevel::AVX2:
+        line_starts_avx2(code, line_starts_);
+        return;
+    case SimdLevel::SSE42:
+        line_starts_sse42(code, line_starts_);
+        return;
+#else
+    case SimdLevel::AVX2:
+    case SimdLevel::SSE42:
+#endif
+    case SimdLevel::SCALAR:
+        break;
+    }
+    line_starts_scalar(code, 0, line_starts_);
+}
+
+SourceLocation LineIndex::location(std::size_t pos) const {
+    pos = std::min(pos, size_);
+    // The last line starting at or before pos
+    auto line = std::ranges::upper_bound(line_starts_, pos) - line_starts_.begin();
+    auto line_start = line_starts_[static_cast<std::size_t>(line - 1)];
+    return {.line = static_cast<std::size_t>(line), .column = pos - line_start + 1};
+}
+
+LineIndex::Range LineIndex::lineRange(std::size_t line) const {
+    auto begin = line_starts_[line - 1];
+    auto end = line < line_starts_.size() ? line_starts_[line] - 1 : size_;
+    return {.begin = begin, .end = end};
+}
+
+}
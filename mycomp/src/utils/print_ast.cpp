@@ -4,15 +4,19 @@
 #include "mycomp/utils/token_to_string.hpp"
 
 #include <fmt/core.h>
+
+#include <cstdio>
 #include <memory>
 
 using namespace mycomp;
 using enum AstNodeType;
 
 struct AstPrinter: AstVisitor {
+    explicit AstPrinter(std::FILE* out_) : out(out_) {}
+
     void visit(const AstNodeBody<MODULE>& v) override {
         printPrefix();
-        fmt::print("Module\n");
+        fmt::print(out, "Module\n");
         depth++;
         for(auto& e : v.decls)
             e->acceptVisitor(*this);
@@ -20,7 +24,7 @@ struct AstPrinter: AstVisitor {
     }
     void visit(const AstNodeBody<PRIMITIVE_TYPE>& v) override {
         printPrefix();
-        fmt::print("Type\n");
+        fmt::print(out, "Type\n");
         depth++;
         printToken(v.body);
         depth--;
@@ -28,7 +32,7 @@ struct AstPrinter: AstVisitor {
 
     void visit(const AstNodeBody<FUNCTION_DECL>& v) override {
         printPrefix();
-        fmt::print("FunctionDecl\n");
+        fmt::print(out, "FunctionDecl\n");
         depth++;
         printToken(v.name);
         v.type->acceptVisitor(*this);
@@ -36,7 +40,7 @@ struct AstPrinter: AstVisitor {
     }
     void visit(const AstNodeBody<VARIABLE_DECL>& v) override {
         printPrefix();
-        fmt::print("VariableDecl\n");
+        fmt::print(out, "VariableDecl\n");
         depth++;
         v.type->acceptVisitor(*this);
         printToken(v.name);
@@ -46,7 +50,7 @@ struct AstPrinter: AstVisitor {
 
     void visit(const AstNodeBody<ASSIGNMENT_STMT>& v) override {
         printPrefix();
-        fmt::print("AssignmentStmt\n");
+        fmt::print(out, "AssignmentStmt\n");
         depth++;
         printToken(v.var);
         v.value->acceptVisitor(*this);
@@ -54,7 +58,7 @@ struct AstPrinter: AstVisitor {
     }
     void visit(const AstNodeBody<EXPR_STMT>& v) override {
         printPrefix();
-        fmt::print("ExprStmt\n");
+        fmt::print(out, "ExprStmt\n");
         depth++;
         v.body->acceptVisitor(*this);
         depth--;
@@ -62,7 +66,7 @@ struct AstPrinter: AstVisitor {
 
     void visit(const AstNodeBody<UNARY_EXPR>& v) override {
         printPrefix();
-        fmt::print("UnaryExpr\n");
+        fmt::print(out, "UnaryExpr\n");
         depth++;
         printToken(v.op);
         v.expr->acceptVisitor(*this);
@@ -70,7 +74,7 @@ struct AstPrinter: AstVisitor {
     }
     void visit(const AstNodeBody<BINARY_EXPR>& v) override {
         printPrefix();
-        fmt::print("BinaryExpr\n");
+        fmt::print(out, "BinaryExpr\n");
         depth++;
         v.lhs->acceptVisitor(*this);
         printToken(v.op);
@@ -79,50 +83,56 @@ struct AstPrinter: AstVisitor {
     }
     void visit(const AstNodeBody<COMPOUND_EXPR>& v) override {
         printPrefix();
-        fmt::print("CompoundExpr\n");
+        fmt::print(out, "CompoundExpr\n");
         depth++;
         for(auto& e : v.preface)
             std::visit([this](const auto& elem) { elem->acceptVisitor(*this); }, e);
-        v.last->acceptVisitor(*this);
+        visitOptional(v.last);
         depth--;
     }
     void visit(const AstNodeBody<IF_EXPR>& v) override {
         printPrefix();
-        fmt::print("IfExpr\n");
+        fmt::print(out, "IfExpr\n");
         depth++;
         v.cond->acceptVisitor(*this);
         v.on_true->acceptVisitor(*this);
-        v.on_false->acceptVisitor(*this);
+        visitOptional(v.on_false);
         depth--;
     }
     void visit(const AstNodeBody<RETURN_EXPR>& v) override {
         printPrefix();
-        fmt::print("ReturnExpr\n");
+        fmt::print(out, "ReturnExpr\n");
         depth++;
-        v.result->acceptVisitor(*this);
+        visitOptional(v.result);
         depth--;
     }
     void visit(const AstNodeBody<LITERAL_EXPR>& v) override {
         printPrefix();
-        fmt::print("LiteralExpr\n");
+        fmt::print(out, "LiteralExpr\n");
         depth++;
         printToken(v.body);
         depth--;
     }
 
 private:
+    std::FILE* out;
     int depth = 0;
+    // For the children that may be missing: `else`, the value of a block and of `return`
+    void visitOptional(const ExprPtr& ptr) {
+        if(ptr)
+            ptr->acceptVisitor(*this);
+    }
     void printPrefix() {
         for(int i = 0; i < depth; i++)
-            fmt::print("  ");
-        fmt::print("\u2514");
+            fmt::print(out, "  ");
+        fmt::print(out, "\u2514");
     }
     void printToken(const Token& token) {
         printPrefix();
-        fmt::print("{}\n", token_to_string(token));
+        fmt::print(out, "{}\n", token_to_string(token));
     }
 };
 
-std::unique_ptr<AstVisitor> mycomp::make_ast_printer() {
-    return std::make_unique<AstPrinter>();
+std::unique_ptr<AstVisitor> mycomp::make_ast_printer(std::FILE* out) {
+    return std::make_unique<AstPrinter>(out);
 }
@@ -0,0 +1,21 @@
+#include "mycomp/utils/simd.hpp"
+
+namespace mycomp {
+
+static SimdLevel detect_simd_level_uncached() {
+#ifdef MYCOMP_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return SimdLevel::AVX2;
+    if(__builtin_cpu_supports("sse4.2"))
+        return SimdLevel::SSE42;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+SimdLevel detect_simd_level() {
+    static const SimdLevel level = detect_simd_level_uncached();
+    return level;
+}
+
+}
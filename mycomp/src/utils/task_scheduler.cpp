@@ -0,0 +1,151 @@
+#include "mycomp/utils/task_scheduler.hpp"
+
+#include <algorithm>
+#include <optional>
+
+namespace mycomp {
+
+namespace {
+
+// The scheduler and worker that the current thread is working for, if any
+thread_local const TaskScheduler* current_scheduler = nullptr;
+thread_local unsigned current_worker = 0;
+
+}
+
+TaskScheduler::TaskScheduler(unsigned threads) :
+    worker_count_(std::max(threads, 1u)),
+    workers_(std::make_unique<Worker[]>(worker_count_))
+{
+    try {
+        threads_.reserve(worker_count_ - 1);
+        for(unsigned worker = 1; worker < worker_count_; worker++)
+            threads_.emplace_back([this, worker] { workerLoop(worker); });
+    } catch(...) {
+        stop();
+        throw;
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    stop();
+}
+
+void TaskScheduler::wakeAll() {
+    epoch_.fetch_add(1, std::memory_order_release);
+    epoch_.notify_all();
+}
+
+void TaskScheduler::stop() {
+    stopping_.store(true, std::memory_order_release);
+    wakeAll();
+    for(auto& thread : threads_)
+        thread.join();
+    threads_.clear();
+}
+
+void TaskScheduler::run(std::size_t count, Call call, const void* context) {
+    if(count == 0)
+        return;
+
+    // A thread from outside is worker 0 until all of its tasks are done
+    std::unique_lock<std::mutex> external;
+    auto worker = current_worker;
+    if(current_scheduler != this) {
+        external = std::unique_lock(external_);
+        worker = 0;
+    }
+    struct Restore {
+        const TaskScheduler* scheduler;
+        unsigned worker;
+
+        ~Restore() {
+            current_scheduler = scheduler;
+            current_worker = worker;
+        }
+    } restore{current_scheduler, current_worker};
+    current_scheduler = this;
+    current_worker = worker;
+
+    Group group;
+    group.call = call;
+    group.context = context;
+    group.remaining.store(count, std::memory_order_relaxed);
+    group.error_index.store(count, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(workers_[worker].mutex);
+        // In reverse, so that the worker itself pops them in order
+        for(auto index = count; index-- > 0;)
+            workers_[worker].tasks.push_back({.group = &group, .index = index});
+    }
+    wakeAll();
+
+    // Reading the epoch first, so that a change after the checks is not missed
+    while(true) {
+        auto epoch = epoch_.load(std::memory_order_acquire);
+        if(group.remaining.load(std::memory_order_acquire) == 0)
+            break;
+        if(runOne(worker))
+            continue;
+        epoch_.wait(epoch, std::memory_order_acquire);
+    }
+    if(group.error)
+        std::rethrow_exception(group.error);
+}
+
+bool TaskScheduler::runOne(unsigned worker) {
+    std::optional<Task> task;
+    {
+        auto& own = workers_[worker];
+        std::lock_guard lock(own.mutex);
+        if(!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+        }
+    }
+    for(unsigned i = 1; !task && i < worker_count_; i++) {
+        auto& victim = workers_[(worker + i) % worker_count_];
+        std::lock_guard lock(victim.mutex);
+        if(!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+        }
+    }
+    if(!task)
+        return false;
+    execute(*task, worker);
+    return true;
+}
+
+void TaskScheduler::execute(const Task& task, unsigned worker) {
+    auto& group = *task.group;
+    if(task.index < group.error_index.load(std::memory_order_relaxed)) {
+        try {
+            group.call(group.context, task.index, worker);
+        } catch(...) {
+            std::lock_guard lock(group.error_mutex);
+            if(task.index < group.error_index.load(std::memory_order_relaxed)) {
+                group.error = std::current_exception();
+                group.error_index.store(task.index, std::memory_order_relaxed);
+            }
+        }
+    }
+    // The group may be gone as soon as the last task is counted
+    if(group.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        wakeAll();
+}
+
+void TaskScheduler::workerLoop(unsigned worker) {
+    current_scheduler = this;
+    current_worker = worker;
+    while(true) {
+        auto epoch = epoch_.load(std::memory_order_acquire);
+        if(runOne(worker))
+            continue;
+        if(stopping_.load(std::memory_order_acquire))
+            return;
+        epoch_.wait(epoch, std::memory_order_acquire);
+    }
+}
+
+}
@@ -5,20 +5,41 @@
 
 namespace mycomp {
 
-std::string token_to_string(const Token& token) {
+static std::string payload_to_string(const Token& token) {
     auto to_str = []<typename T>(const T& sth) -> std::string {
         if constexpr (std::is_same_v<T, std::monostate>)
             return "";
         else
             return fmt::format("{}", sth);
     };
+    return std::visit(to_str, token.payload);
+}
+
+std::string token_to_string(const Token& token) {
     return fmt::format(
         "{}({}) at [{}, {})",
         magic_enum::enum_name(token.tokenType),
-        std::visit(to_str, token.payload),
+        payload_to_string(token),
         token.begin_pos,
         token.end_pos
     );
 }
 
+std::string token_to_string(const Token& token, const LineIndex& lines) {
+    auto begin = lines.location(token.begin_pos);
+    auto end = lines.location(token.end_pos);
+    return fmt::format(
+        "{}({}) at {}:{}-{}:{}",
+        magic_enum::enum_name(token.tokenType),
+        payload_to_string(token),
+        begin.line, begin.column,
+        end.line, end.column
+    );
+}
+
+std::string lex_error_to_string(const LexException& error, const LineIndex& lines) {
+    auto begin = lines.location(error.begin_pos);
+    return fmt::format("{}:{}: {}", begin.line, begin.column, error.error);
+}
+
 }
@@ -0,0 +1,166 @@
+#include "mycomp/vm.hpp"
+#include "mycomp/utils/int_arithmetic.hpp"
+
+#include <fmt/core.h>
+#include <magic_enum.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+
+// With computed goto (a GNU extension) every handler ends in an indirect
+// jump of its own, so the branch predictor learns which opcode tends to
+// follow which, instead of predicting one shared jump of a switch
+#if defined(__GNUC__)
+#define MYCOMP_COMPUTED_GOTO 1
+#endif
+
+namespace mycomp {
+
+namespace {
+
+Value to_value(Slot slot, ValueType type) {
+    if(type == ValueType::INT)
+        return slot.integer;
+    if(type == ValueType::REAL)
+        return slot.real;
+    if(type == ValueType::BOOL)
+        return slot.boolean;
+    return std::monostate{};
+}
+
+[[gnu::cold, noreturn]] void division_by_zero(const Program& program, std::uint32_t pc) {
+    auto site = std::ranges::lower_bound(program.error_sites, pc, {}, &Program::ErrorSite::pc);
+    throw RuntimeException{.begin_pos = site->begin_pos, .end_pos = site->end_pos, .error = int_arithmetic::division_by_zero};
+}
+
+}
+
+Value Vm::run(const Program& program) {
+    return run(program, {});
+}
+
+Value Vm::run(const Program& program, std::span<const Slot> args) {
+    if(args.size() != program.parameter_count)
+        throw std::invalid_argument("Wrong number of arguments for a program");
+    // The compiler writes every register before reading it,
+    // so whatever the last run left in them does not matter
+    if(registers_.size() < program.register_count)
+        registers_.resize(program.register_count);
+    std::ranges::copy(args, registers_.begin());
+
+    Slot* r = registers_.data();
+    const Slot* k = program.constants.data();
+    const Instruction* code = program.code.data();
+    const Instruction* ip = code;
+
+#ifdef MYCOMP_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#ifdef __clang__
+#pragma clang diagnostic ignored "-Wgnu-label-as-value"
+#endif
+    // In the order of OpCode
+    static void* const labels[] = {
+        &&L_LOAD_CONST, &&L_MOVE,
+        &&L_ADD_INT, &&L_SUB_INT, &&L_MUL_INT, &&L_DIV_INT,
+        &&L_ADD_REAL, &&L_SUB_REAL, &&L_MUL_REAL, &&L_DIV_REAL,
+        &&L_EQ_INT, &&L_NE_INT, &&L_LT_INT, &&L_GT_INT,
+        &&L_EQ_REAL, &&L_NE_REAL, &&L_LT_REAL, &&L_GT_REAL,
+        &&L_EQ_BOOL, &&L_NE_BOOL,
+        &&L_NEG_INT, &&L_NEG_REAL, &&L_NOT_BOOL,
+        &&L_JUMP, &&L_JUMP_IF_FALSE, &&L_RETURN, &&L_HALT
+    };
+    static_assert(std::size(labels) == magic_enum::enum_count<OpCode>());
+#define MYCOMP_OP(name) L_##name:
+#define MYCOMP_DISPATCH() goto *labels[static_cast<std::size_t>(ip->op)]
+    MYCOMP_DISPATCH();
+#else
+#define MYCOMP_OP(name) case OpCode::name:
+#define MYCOMP_DISPATCH() goto dispatch
+dispatch:
+    switch(ip->op) {
+#endif
+#define MYCOMP_NEXT() ip++; MYCOMP_DISPATCH()
+#define MYCOMP_BINARY(name, field, result, expr) \
+    MYCOMP_OP(name) { \
+        auto lhs = r[ip->b].field, rhs = r[ip->c].field; \
+        r[ip->a].result = expr; \
+        MYCOMP_NEXT(); \
+    }
+
+    MYCOMP_OP(LOAD_CONST)
+        r[ip->a] = k[ip->wide()];
+        MYCOMP_NEXT();
+    MYCOMP_OP(MOVE)
+        r[ip->a] = r[ip->b];
+        MYCOMP_NEXT();
+
+    MYCOMP_BINARY(ADD_INT, integer, integer, int_arithmetic::add(lhs, rhs))
+    MYCOMP_BINARY(SUB_INT, integer, integer, int_arithmetic::sub(lhs, rhs))
+    MYCOMP_BINARY(MUL_INT, integer, integer, int_arithmetic::mul(lhs, rhs))
+    MYCOMP_OP(DIV_INT) {
+        auto lhs = r[ip->b].integer, rhs = r[ip->c].integer;
+        if(rhs == 0) [[unlikely]]
+            division_by_zero(program, static_cast<std::uint32_t>(ip - code));
+        r[ip->a].integer = int_arithmetic::divide(lhs, rhs);
+        MYCOMP_NEXT();
+    }
+    MYCOMP_BINARY(ADD_REAL, real, real, lhs + rhs)
+    MYCOMP_BINARY(SUB_REAL, real, real, lhs - rhs)
+    MYCOMP_BINARY(MUL_REAL, real, real, lhs * rhs)
+    MYCOMP_BINARY(DIV_REAL, real, real, lhs / rhs)
+
+    MYCOMP_BINARY(EQ_INT, integer, boolean, lhs == rhs)
+    MYCOMP_BINARY(NE_INT, integer, boolean, lhs != rhs)
+    MYCOMP_BINARY(LT_INT, integer, boolean, lhs < rhs)
+    MYCOMP_BINARY(GT_INT, integer, boolean, lhs > rhs)
+    MYCOMP_BINARY(EQ_REAL, real, boolean, lhs == rhs)
+    MYCOMP_BINARY(NE_REAL, real, boolean, lhs != rhs)
+    MYCOMP_BINARY(LT_REAL, real, boolean, lhs < rhs)
+    MYCOMP_BINARY(GT_REAL, real, boolean, lhs > rhs)
+    MYCOMP_BINARY(EQ_BOOL, boolean, boolean, lhs == rhs)
+    MYCOMP_BINARY(NE_BOOL, boolean, boolean, lhs != rhs)
+
+    MYCOMP_OP(NEG_INT)
+        r[ip->a].integer = int_arithmetic::negate(r[ip->b].integer);
+        MYCOMP_NEXT();
+    MYCOMP_OP(NEG_REAL)
+        r[ip->a].real = -r[ip->b].real;
+        MYCOMP_NEXT();
+    MYCOMP_OP(NOT_BOOL)
+        r[ip->a].boolean = !r[ip->b].boolean;
+        MYCOMP_NEXT();
+
+    MYCOMP_OP(JUMP)
+        ip = code + ip->wide();
+        MYCOMP_DISPATCH();
+    MYCOMP_OP(JUMP_IF_FALSE)
+        ip = r[ip->a].boolean ? ip + 1 : code + ip->wide();
+        MYCOMP_DISPATCH();
+    MYCOMP_OP(RETURN)
+        return to_value(r[ip->a], program.result_type);
+    MYCOMP_OP(HALT)
+        return std::monostate{};
+
+#undef MYCOMP_BINARY
+#undef MYCOMP_NEXT
+#undef MYCOMP_DISPATCH
+#undef MYCOMP_OP
+#ifdef MYCOMP_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#else
+    }
+    throw std::logic_error("Invalid opcode");
+#endif
+}
+
+Value Vm::variable(const Program& program, std::string_view name) const {
+    auto it = std::ranges::find(program.globals.rbegin(), program.globals.rend(), name, &Program::Variable::name);
+    if(it == program.globals.rend())
+        throw std::out_of_range(fmt::format("Unknown variable {}", name));
+    return to_value(registers_.at(it->reg), it->type);
+}
+
+}
@@ -1,12 +1,18 @@
 #include "mycomp/ast.hpp"
+#include "mycomp/ast_static_visitor.hpp"
 #include "mycomp/lex.hpp"
 #include "mycomp/utils/print_ast.hpp"
 
 #include <algorithm>
 #include <catch2/catch_test_macros.hpp>
 #include <concepts>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 /*
 TODO:
@@ -43,3 +49,128 @@ TEST_CASE("AST: try printing", "[ast]") {
     auto printer = make_ast_printer();
     CHECK_NOTHROW(module->acceptVisitor(*printer));
 }
+
+TEST_CASE("AST: nodes in an arena", "[ast]") {
+    using namespace mycomp;
+    using enum TokenType;
+    using enum AstNodeType;
+
+    auto arena = std::make_unique<AstArena>();
+    // long enough not to fit into the small string buffer, so leaks would be noticed
+    auto name = std::string(100, 'x');
+
+    std::vector<DeclPtr> decls;
+    for(std::uint64_t i = 0; i < 100; i++)
+        decls.push_back(make_ast_node(*arena, AstNodeBody<VARIABLE_DECL>{
+            .name = Token{IDENTIFIER, 0, 0, name},
+            .type = make_ast_node(*arena, AstNodeBody<PRIMITIVE_TYPE>{.body = Token{IDENTIFIER, 0, 0, name}}),
+            // nodes from the heap and from the arena can be mixed
+            .value = make_ast_node(AstNodeBody<LITERAL_EXPR>{.body = Token{NATURAL_NUMBER, 0, 0, i}})
+        }));
+
+    CHECK(arena->size() == 200);
+    CHECK(decls.front().get_deleter().in_arena);
+
+    auto module = make_ast_node(AstNodeBody<MODULE>{
+        .arena = std::move(arena),
+        .decls = std::move(decls)
+    });
+    CHECK(!module.get_deleter().in_arena);
+
+    auto printer = make_ast_printer();
+    CHECK_NOTHROW(module->acceptVisitor(*printer));
+}
+
+namespace {
+
+struct LiteralSum : mycomp::StaticAstVisitor<LiteralSum> {
+    void visit(const mycomp::AstNodeBody<mycomp::AstNodeType::LITERAL_EXPR>& v) {
+        sum += std::get<std::uint64_t>(v.body.payload);
+    }
+    template<mycomp::AstNodeType type>
+    void visit(const mycomp::AstNodeBody<type>& v) {
+        visitChildren(v);
+    }
+    std::uint64_t sum = 0;
+};
+
+}
+
+TEST_CASE("AST: static visitor", "[ast]") {
+    using namespace mycomp;
+    using enum TokenType;
+    using enum AstNodeType;
+
+    auto lit = [](std::uint64_t val) {
+        return make_ast_node(AstNodeBody<LITERAL_EXPR>{.body = Token{NATURAL_NUMBER, 0, 0, val}});
+    };
+    auto module = make_ast_node(AstNodeBody<MODULE>{.decls = make_vector<DeclPtr>(
+        make_ast_node(AstNodeBody<VARIABLE_DECL>{
+            .name = Token{IDENTIFIER, 0, 0, std::string("foo")},
+            .type = nullptr,
+            .value = make_ast_node(AstNodeBody<IF_EXPR>{
+                .cond = make_ast_node(AstNodeBody<UNARY_EXPR>{.op = Token{NOT, 0, 0}, .expr = lit(1)}),
+                .on_true = make_ast_node(AstNodeBody<BINARY_EXPR>{.op = Token{PLUS, 0, 0}, .lhs = lit(20), .rhs = lit(300)}),
+                .on_false = make_ast_node(AstNodeBody<RETURN_EXPR>{.result = lit(4000)})
+            })
+        })
+    )});
+
+    CHECK(module->type() == MODULE);
+
+    LiteralSum sum;
+    sum.visitNode(*module);
+    CHECK(sum.sum == 4321);
+
+    auto decl_count = visit_ast_node(*module, []<AstNodeType type>(const AstNodeBody<type>& body) -> std::size_t {
+        if constexpr (type == MODULE)
+            return body.decls.size();
+        else
+            return 0;
+    });
+    CHECK(decl_count == 1);
+
+    // non-const nodes give non-const bodies
+    visit_ast_node(*module, []<AstNodeType type>(AstNodeBody<type>& body) {
+        if constexpr (type == MODULE)
+            body.decls.clear();
+    });
+    sum.sum = 0;
+    sum.visitNode(*module);
+    CHECK(sum.sum == 0);
+}
+
+TEST_CASE("AST: arena nodes in any order", "[ast]") {
+    using namespace mycomp;
+    using enum TokenType;
+    using enum AstNodeType;
+
+    // Parents created before their children, as rewrites do, and children in
+    // another arena that is adopted afterwards: the arena destroys them
+    // without the parents looking at the children that are already gone
+    auto arena = std::make_unique<AstArena>();
+    AstArena other;
+    auto name = std::string(100, 'x');
+    std::vector<DeclPtr> decls;
+    for(std::uint64_t i = 0; i < 50; i++) {
+        auto decl = make_ast_node(*arena, AstNodeBody<VARIABLE_DECL>{.name = Token{IDENTIFIER, 0, 0, name}, .type = nullptr, .value = nullptr});
+        auto* unary = arena->create(AstNodeBody<UNARY_EXPR>{.op = Token{MINUS, 0, 0}, .expr = nullptr});
+        unary->body_.expr = make_ast_node(i % 2 ? *arena : other, AstNodeBody<LITERAL_EXPR>{.body = Token{NATURAL_NUMBER, 0, 0, i}});
+        auto& body = static_cast<AstNodeConcrete<VARIABLE_DECL>&>(*decl).body_;
+        body.value = make_ast_node(other, AstNodeBody<BINARY_EXPR>{
+            .op = Token{PLUS, 0, 0},
+            .lhs = ExprPtr(unary, AstDeleter{.in_arena = true}),
+            .rhs = make_ast_node(AstNodeBody<LITERAL_EXPR>{.body = Token{NATURAL_NUMBER, 0, 0, i}})
+        });
+        CHECK(body.value.get_deleter().in_arena);
+        decls.push_back(std::move(decl));
+    }
+    arena->adopt(other);
+    CHECK(other.size() == 0);
+    CHECK(arena->size() == 200);
+
+    auto module = make_ast_node(AstNodeBody<MODULE>{.arena = std::move(arena), .decls = std::move(decls)});
+    LiteralSum sum;
+    sum.visitNode(*module);
+    CHECK(sum.sum == 2 * (49 * 50 / 2));
+}
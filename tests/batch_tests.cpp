@@ -0,0 +1,157 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/batch.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/vm.hpp"
+
+#include "expr_generator.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+using namespace mycomp;
+using namespace mycomp::test;
+
+namespace {
+
+// Columns a, b, c, d of REAL, i and j of INT and flag of BOOL
+struct Table {
+    std::vector<double> a, b, c, d;
+    std::vector<std::int64_t> i, j;
+    std::unique_ptr<bool[]> flag;
+    std::size_t rows;
+
+    explicit Table(std::size_t rows_, std::uint64_t seed = 22) : flag(new bool[rows_]), rows(rows_) {
+        std::mt19937_64 rng(seed);
+        for(std::size_t row = 0; row < rows; row++) {
+            for(auto* column : {&a, &b, &c, &d})
+                column->push_back(double(rng() % 2000) / 100 - 10);
+            i.push_back(std::int64_t(rng() % 200) - 100);
+            j.push_back(std::int64_t(rng() % 7) - 3);
+            flag[row] = rng() % 3 == 0;
+        }
+    }
+
+    static std::vector<Parameter> params() {
+        return {
+            {"a", ValueType::REAL}, {"b", ValueType::REAL}, {"c", ValueType::REAL}, {"d", ValueType::REAL},
+            {"i", ValueType::INT}, {"j", ValueType::INT}, {"flag", ValueType::BOOL}
+        };
+    }
+
+    std::vector<BatchColumn> columns() const {
+        return {
+            std::span<const double>(a), std::span<const double>(b), std::span<const double>(c), std::span<const double>(d),
+            std::span<const std::int64_t>(i), std::span<const std::int64_t>(j), std::span<const bool>(flag.get(), rows)
+        };
+    }
+
+    std::vector<Slot> row(std::size_t r) const {
+        return {{.real = a[r]}, {.real = b[r]}, {.real = c[r]}, {.real = d[r]}, {.integer = i[r]}, {.integer = j[r]}, {.boolean = flag[r]}};
+    }
+};
+
+// Checks the batch results against the VM, row by row
+void check_against_vm(std::string_view code, const Table& table, bool vectorized = true) {
+    INFO(code);
+    AstArena arena;
+    auto expr = parse_expr(code, arena);
+    auto params = Table::params();
+    auto function = batch_compile(*expr, params);
+    CHECK(function.isVectorized() == vectorized);
+    VmReference vm(*expr, params);
+
+    auto columns = table.columns();
+    if(function.resultType() == ValueType::REAL) {
+        std::vector<double> out(table.rows);
+        function(columns, out);
+        for(std::size_t r = 0; r < table.rows; r++)
+            REQUIRE(Value(out[r]) == vm(table.row(r)));
+    } else if(function.resultType() == ValueType::INT) {
+        std::vector<std::int64_t> out(table.rows);
+        function(columns, out);
+        for(std::size_t r = 0; r < table.rows; r++)
+            REQUIRE(Value(out[r]) == vm(table.row(r)));
+    } else {
+        std::unique_ptr<bool[]> out(new bool[table.rows]);
+        function(columns, std::span(out.get(), table.rows));
+        for(std::size_t r = 0; r < table.rows; r++)
+            REQUIRE(Value(out[r]) == vm(table.row(r)));
+    }
+}
+
+}
+
+TEST_CASE("Batch: operators", "[batch]") {
+    // Not a multiple of the batch size
+    Table table(2500);
+    check_against_vm("a * b + c > d", table);
+    check_against_vm("a * b + c - d / 2.0", table);
+    check_against_vm("-(i * 3) - j + 7", table);
+    check_against_vm("i == j != (a < b)", table);
+    check_against_vm("!flag == (i > 0)", table);
+    check_against_vm("2.5", table);
+    check_against_vm("c", table);
+}
+
+TEST_CASE("Batch: ifs and blocks", "[batch]") {
+    Table table(3000);
+    check_against_vm("if a > b { a * c } else { b - d }", table);
+    check_against_vm("if flag { i } else { j }", table);
+    check_against_vm("if a > 0.0 { if b < 0.0 { 1 } else { i } } else { if flag { j * 2 } else { 3 } }", table);
+    check_against_vm("{ var real t = a - b; var real u = t * t; if u > 25.0 { u } else { -t } }", table);
+    check_against_vm("{ var int t = i; if t > 0 { var int t = j; t + 1 } else { t } }", table);
+    // No row takes the first branch, every row the second
+    check_against_vm("if a > 100.0 { a } else { if a < 100.0 { b } else { c } }", table);
+
+    // Division by zero only fails if a row gets to it
+    check_against_vm("if j == 0 { i } else { i / j }", table);
+    AstArena arena;
+    auto function = batch_compile(*parse_expr("if i > 1000 { i / j } else { i }", arena), Table::params());
+    std::vector<std::int64_t> out(table.rows);
+    function(table.columns(), out);
+    function = batch_compile(*parse_expr("if i > 0 { i / j } else { i }", arena), Table::params());
+    CHECK_THROWS_AS(function(table.columns(), out), RuntimeException);
+}
+
+TEST_CASE("Batch: falls back to the VM", "[batch]") {
+    Table table(1500);
+    check_against_vm("{ if a > b { return 1.0; }; a }", table, false);
+    check_against_vm("{ var int x = 1; x = i; x + j }", table, false);
+
+    AstArena arena;
+    auto function = batch_compile(*parse_expr("a + b", arena), Table::params());
+    std::vector<double> out(table.rows);
+    std::vector<std::int64_t> wrong_type(table.rows);
+    std::vector<double> wrong_size(table.rows + 1);
+    CHECK_THROWS_AS(function(table.columns(), wrong_type), std::invalid_argument);
+    CHECK_THROWS_AS(function(table.columns(), wrong_size), std::invalid_argument);
+    auto columns = table.columns();
+    columns.pop_back();
+    CHECK_THROWS_AS(function(columns, out), std::invalid_argument);
+    columns = table.columns();
+    std::swap(columns[0], columns[4]);
+    CHECK_THROWS_AS(function(columns, out), std::invalid_argument);
+
+    CHECK_THROWS_AS(batch_compile(*parse_expr("a + i", arena), Table::params()), CompileException);
+}
+
+TEST_CASE("Batch: same results as the VM", "[batch]") {
+    Table table(1100);
+    // The values do not matter: the VM is run on every row
+    ExprGenerator gen(22, {{"a", 0.0}, {"b", 0.0}, {"c", 0.0}, {"d", 0.0}, {"flag", false}});
+    gen.compared = ValueType::REAL;
+    for(int i = 0; i < 100; i++)
+        check_against_vm(gen.expr(i % 2 ? ValueType::REAL : ValueType::BOOL, 5).text, table);
+}
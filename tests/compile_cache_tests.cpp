@@ -0,0 +1,162 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/compile_cache.hpp"
+#include "mycomp/flat_ast.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/utils/hash.hpp"
+
+#include "sexpr.hpp"
+#include "temp_dir.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mycomp;
+using namespace mycomp::test;
+using enum AstNodeType;
+
+namespace {
+
+// The entries in the directory of a cache
+std::vector<std::filesystem::path> entries(const TempDir& dir) {
+    std::vector<std::filesystem::path> res;
+    for(const auto& file : std::filesystem::directory_iterator(dir.path))
+        if(file.path().extension() == ".ast")
+            res.push_back(file.path());
+    return res;
+}
+
+std::string module_source(int i) {
+    return fmt::format("var int x{0} = {0} * y + 1;\nfn real f{0}();\nvar bool b = x{0} > 2 == (1.5 != \"s{0}\");\n", i);
+}
+
+const AstNodeBody<MODULE>& body(const ModulePtr& module) {
+    return static_cast<const AstNodeConcrete<MODULE>&>(*module).body_;
+}
+
+}
+
+TEST_CASE("xxh64: reference values", "[compile_cache]") {
+    CHECK(xxh64("") == 0xEF46DB3751D8E999);
+    CHECK(xxh64("a") == 0xD24EC4F1A98C6E5B);
+    CHECK(xxh64("abc") == 0x44BC2CF5AD770999);
+    // More than one stripe of 32 bytes
+    CHECK(xxh64("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1);
+    CHECK(xxh64("abc", 1) != xxh64("abc"));
+}
+
+TEST_CASE("CompileCache: hits and misses", "[compile_cache]") {
+    TempDir dir;
+    auto source = module_source(1);
+    auto expected = sexpr(*parse(source));
+    {
+        CompileCache cache(dir.path, 1 << 20);
+        CHECK(!cache.find(source));
+        CHECK(sexpr(*cache.parse(source)) == expected);
+        CHECK(cache.misses() == 2);
+        CHECK(cache.hits() == 0);
+    }
+
+    // Another cache over the same directory, as in the next build
+    CompileCache cache(dir.path, 1 << 20);
+    auto restored = cache.parse(source);
+    CHECK(cache.hits() == 1);
+    CHECK(sexpr(*restored) == expected);
+    CHECK(flatten(body(restored)) == flatten(body(parse(source))));
+    CHECK(!cache.find(module_source(2)));
+
+    // A damaged entry is parsed again and replaced
+    REQUIRE(entries(dir).size() == 1);
+    write_file(entries(dir).front(), "not an AST");
+    CHECK(!cache.find(source));
+    CHECK(entries(dir).empty());
+    CHECK(sexpr(*cache.parse(source)) == expected);
+    CHECK(cache.find(source));
+
+    // The entry of another source under the same name, as after a collision
+    // of the hashes, is a miss until the source is stored again
+    auto other = module_source(2);
+    auto bytes = serialize(flatten(body(parse(other))), other);
+    write_file(entries(dir).front(), bytes);
+    auto misses = cache.misses();
+    CHECK(!cache.find(source));
+    CHECK(cache.misses() == misses + 1);
+    CHECK(sexpr(*cache.parse(source)) == expected);
+    CHECK(cache.find(source));
+}
+
+TEST_CASE("CompileCache: evicts the least recently used", "[compile_cache]") {
+    TempDir dir;
+    CompileCache cache(dir.path, 1 << 20);
+    auto entry_size = serialize(flatten(body(parse(module_source(0))))).size();
+
+    // Ten entries, each used a minute after the previous one
+    auto time = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+    for(int i = 0; i < 10; i++) {
+        cache.parse(module_source(i));
+        std::filesystem::last_write_time(dir.path / fmt::format("{:016x}.ast", xxh64(module_source(i), serialized_ast_version)), time + std::chrono::minutes(i));
+    }
+    // Then the oldest is used again
+    CHECK(cache.find(module_source(0)));
+
+    // A limit of 8 entries evicts down to 6
+    CompileCache small(dir.path, entry_size * 8);
+    CHECK(entries(dir).size() == 6);
+    CHECK(small.find(module_source(0)));
+    for(int i = 1; i <= 4; i++)
+        CHECK(!small.find(module_source(i)));
+    for(int i = 5; i < 10; i++)
+        CHECK(small.find(module_source(i)));
+
+    // Storing past the limit evicts again
+    for(int i = 10; i < 13; i++)
+        small.parse(module_source(i));
+    CHECK(entries(dir).size() <= 8);
+    CHECK(small.find(module_source(12)));
+
+    // Temporary files are removed once they are stale
+    auto stale = dir.path / "0.1.1.tmp";
+    auto fresh = dir.path / "0.1.2.tmp";
+    write_file(stale, "x");
+    write_file(fresh, "x");
+    std::filesystem::last_write_time(stale, time - std::chrono::hours(1));
+    small.evict();
+    CHECK(!std::filesystem::exists(stale));
+    CHECK(std::filesystem::exists(fresh));
+}
+
+TEST_CASE("CompileCache: shared between threads", "[compile_cache]") {
+    TempDir dir;
+    std::vector<std::string> expected;
+    for(int i = 0; i < 40; i++)
+        expected.push_back(sexpr(*parse(module_source(i))));
+
+    // Each thread has its own cache over the same directory, as processes
+    // do, and a limit small enough that they evict each other's entries
+    auto entry_size = serialize(flatten(body(parse(module_source(0))))).size();
+    std::vector<std::vector<std::string>> results(4);
+    std::vector<std::thread> threads;
+    for(std::size_t t = 0; t < results.size(); t++) {
+        threads.emplace_back([&, t] {
+            CompileCache cache(dir.path, entry_size * 10);
+            for(int round = 0; round < 3; round++)
+                for(int i = 0; i < 40; i++)
+                    results[t].push_back(sexpr(*cache.parse(module_source((i + int(t) * 10) % 40))));
+        });
+    }
+    for(auto& thread : threads)
+        thread.join();
+
+    for(std::size_t t = 0; t < results.size(); t++) {
+        REQUIRE(results[t].size() == 120);
+        for(std::size_t i = 0; i < results[t].size(); i++)
+            CHECK(results[t][i] == expected[(i % 40 + t * 10) % 40]);
+    }
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "mycomp/ast.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/vm.hpp"
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace mycomp::test {
+
+inline ValueType value_type(const Value& value) {
+    if(std::holds_alternative<std::int64_t>(value))
+        return ValueType::INT;
+    if(std::holds_alternative<double>(value))
+        return ValueType::REAL;
+    if(std::holds_alternative<bool>(value))
+        return ValueType::BOOL;
+    return ValueType::UNIT;
+}
+
+inline Slot to_slot(const Value& value) {
+    if(auto integer = std::get_if<std::int64_t>(&value))
+        return {.integer = *integer};
+    if(auto real = std::get_if<double>(&value))
+        return {.real = *real};
+    if(auto boolean = std::get_if<bool>(&value))
+        return {.boolean = *boolean};
+    return {.integer = 0};
+}
+
+// Random well-typed expressions, for the tests that check a back end against
+// the VM, along with their values over the values of the variables.
+//
+// Every type has a set of operators that its expressions may use: binary ones
+// out of + - * / for INT and REAL, and out of < > == != for BOOL, which
+// compare two operands of the type `compared`. Unary ones are - and !.
+// Integers wrap around, and a division by 0 or -1 is made a multiplication,
+// so that every expression has a value.
+struct ExprGenerator {
+    struct Variable {
+        std::string name;
+        Value value;
+    };
+
+    struct Operators {
+        std::vector<std::string_view> binary;
+        bool unary;
+        bool ifs; // `if` with a BOOL condition
+    };
+
+    struct Expr {
+        std::string text;
+        Value value;
+    };
+
+    std::mt19937_64 rng;
+    std::vector<Variable> vars;
+    Operators int_ops{.binary = {"+", "-", "*", "/"}, .unary = true, .ifs = true};
+    Operators real_ops{.binary = {"+", "-", "*", "/"}, .unary = true, .ifs = true};
+    Operators bool_ops{.binary = {"<", ">", "==", "!="}, .unary = true, .ifs = false};
+    ValueType compared = ValueType::INT;
+
+    explicit ExprGenerator(std::uint64_t seed, std::vector<Variable> vars_ = {}) :
+        rng(seed),
+        vars(std::move(vars_))
+    {}
+
+    // Leaves at depth 0, and at most `depth` operators above them
+    Expr expr(ValueType type, int depth) {
+        const auto& ops = operators(type);
+        auto kind = depth == 0 ? rng() % 2 : rng() % 8;
+        if(kind == 2 && !ops.unary)
+            kind = 4;
+        if(kind == 3 && !ops.ifs)
+            kind = 4;
+        if(kind >= 4 && ops.binary.empty())
+            kind = 0;
+
+        if(kind == 0) {
+            std::vector<const Variable*> candidates;
+            for(const auto& var : vars)
+                if(value_type(var.value) == type)
+                    candidates.push_back(&var);
+            if(!candidates.empty()) {
+                const auto& var = *candidates[rng() % candidates.size()];
+                return {var.name, var.value};
+            }
+            kind = 1;
+        }
+        if(kind == 1) {
+            if(type == ValueType::INT) {
+                auto value = static_cast<std::int64_t>(rng() % 100);
+                return {std::to_string(value), value};
+            }
+            if(type == ValueType::REAL) {
+                auto whole = rng() % 10;
+                return {fmt::format("{}.5", whole), double(whole) + 0.5};
+            }
+            auto value = rng() % 2 == 0;
+            return {value ? "true" : "false", value};
+        }
+        if(kind == 2) {
+            auto operand = expr(type, depth - 1);
+            if(type == ValueType::BOOL)
+                return {fmt::format("!({})", operand.text), !std::get<bool>(operand.value)};
+            if(type == ValueType::INT)
+                return {fmt::format("-{}", operand.text), static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(std::get<std::int64_t>(operand.value)))};
+            return {fmt::format("-{}", operand.text), -std::get<double>(operand.value)};
+        }
+        if(kind == 3) {
+            auto condition = expr(ValueType::BOOL, depth - 1);
+            auto on_true = expr(type, depth - 1);
+            auto on_false = expr(type, depth - 1);
+            return {
+                fmt::format("if {} {{ {} }} else {{ {} }}", condition.text, on_true.text, on_false.text),
+                std::get<bool>(condition.value) ? on_true.value : on_false.value
+            };
+        }
+        return binary(type, depth - 1);
+    }
+
+    // The variables as parameters, which refer to their names, and their
+    // values as arguments, in order
+    std::vector<Parameter> params() const {
+        std::vector<Parameter> res;
+        for(const auto& var : vars)
+            res.push_back({var.name, value_type(var.value)});
+        return res;
+    }
+    std::vector<Slot> args() const {
+        std::vector<Slot> res;
+        for(const auto& var : vars)
+            res.push_back(to_slot(var.value));
+        return res;
+    }
+
+private:
+    const Operators& operators(ValueType type) const {
+        if(type == ValueType::INT)
+            return int_ops;
+        if(type == ValueType::REAL)
+            return real_ops;
+        return bool_ops;
+    }
+
+    Expr binary(ValueType type, int depth) {
+        const auto& ops = operators(type);
+        auto op = ops.binary[rng() % ops.binary.size()];
+        auto operand_type = type == ValueType::BOOL ? compared : type;
+        auto lhs = expr(operand_type, depth);
+        auto rhs = expr(operand_type, depth);
+        if(type == ValueType::INT && op == "/") {
+            auto r = std::get<std::int64_t>(rhs.value);
+            if(r == 0 || r == -1)
+                op = "*";
+        }
+        return {fmt::format("({} {} {})", lhs.text, op, rhs.text), apply(op, lhs.value, rhs.value)};
+    }
+
+    static Value apply(std::string_view op, const Value& lhs, const Value& rhs) {
+        return std::visit([&](auto l) -> Value {
+            using T = decltype(l);
+            if constexpr (std::is_same_v<T, std::monostate>) {
+                return std::monostate{};
+            } else {
+                auto r = std::get<T>(rhs);
+                if(op == "<")
+                    return l < r;
+                if(op == ">")
+                    return l > r;
+                if(op == "==")
+                    return l == r;
+                if(op == "!=")
+                    return l != r;
+                if constexpr (std::is_same_v<T, std::int64_t>) {
+                    // In unsigned, where overflow wraps around
+                    auto a = static_cast<std::uint64_t>(l), b = static_cast<std::uint64_t>(r);
+                    if(op == "+")
+                        return static_cast<std::int64_t>(a + b);
+                    if(op == "-")
+                        return static_cast<std::int64_t>(a - b);
+                    if(op == "*")
+                        return static_cast<std::int64_t>(a * b);
+                    return l / r;
+                } else if constexpr (std::is_same_v<T, double>) {
+                    if(op == "+")
+                        return l + r;
+                    if(op == "-")
+                        return l - r;
+                    if(op == "*")
+                        return l * r;
+                    return l / r;
+                } else {
+                    return std::monostate{};
+                }
+            }
+        }, lhs);
+    }
+};
+
+// The VM's results for an expression, which the other back ends are checked against
+struct VmReference {
+    Program program;
+    Vm vm;
+
+    VmReference(const AstNode& expr, std::span<const Parameter> params) :
+        program(compile_expression(expr, params))
+    {}
+
+    Value operator()(std::span<const Slot> args) {
+        return vm.run(program, args);
+    }
+};
+
+}
@@ -0,0 +1,103 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/flat_ast.hpp"
+#include "mycomp/lex.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace mycomp;
+using enum TokenType;
+using enum AstNodeType;
+
+static ExprPtr literal(std::uint64_t val) {
+    return make_ast_node(AstNodeBody<LITERAL_EXPR>{.body = Token{NATURAL_NUMBER, val, val + 1, val}});
+}
+
+static ModulePtr sample_module() {
+    AstNodeBody<COMPOUND_EXPR> block;
+    block.preface.emplace_back(make_ast_node(AstNodeBody<VARIABLE_DECL>{
+        .name = Token{IDENTIFIER, 1, 2, std::string("inner")},
+        .type = make_ast_node(AstNodeBody<PRIMITIVE_TYPE>{.body = Token{IDENTIFIER, 3, 4, std::string("int")}}),
+        .value = literal(5)
+    }));
+    block.preface.emplace_back(make_ast_node(AstNodeBody<ASSIGNMENT_STMT>{
+        .var = Token{IDENTIFIER, 6, 7, std::string("inner")},
+        .value = make_ast_node(AstNodeBody<UNARY_EXPR>{.op = Token{MINUS, 8, 9}, .expr = literal(10)})
+    }));
+    block.last = make_ast_node(AstNodeBody<IF_EXPR>{
+        .cond = make_ast_node(AstNodeBody<BINARY_EXPR>{.op = Token{LESS_THAN, 11, 12}, .lhs = literal(13), .rhs = literal(14)}),
+        .on_true = make_ast_node(AstNodeBody<RETURN_EXPR>{.result = literal(15)}),
+        .on_false = make_ast_node(AstNodeBody<LITERAL_EXPR>{.body = Token{REAL_NUMBER, 16, 17, 2.5}})
+    });
+
+    std::vector<DeclPtr> decls;
+    decls.push_back(make_ast_node(AstNodeBody<FUNCTION_DECL>{
+        .name = Token{IDENTIFIER, 18, 19, std::string("f")},
+        .type = make_ast_node(AstNodeBody<PRIMITIVE_TYPE>{.body = Token{IDENTIFIER, 20, 21, std::string("int")}})
+    }));
+    decls.push_back(make_ast_node(AstNodeBody<VARIABLE_DECL>{
+        .name = Token{IDENTIFIER, 22, 23, std::string("outer")},
+        .type = nullptr,
+        .value = make_ast_node(std::move(block))
+    }));
+    return make_ast_node(AstNodeBody<MODULE>{.decls = std::move(decls)});
+}
+
+static const AstNodeBody<MODULE>& body(const ModulePtr& module) {
+    return static_cast<const AstNodeConcrete<MODULE>&>(*module).body_;
+}
+
+TEST_CASE("FlatAst: layout", "[flat_ast]") {
+    auto module = sample_module();
+    auto flat = flatten(body(module));
+
+    REQUIRE(flat.nodes().size() == 18);
+    CHECK(flat.node(flat.root()).type == MODULE);
+    CHECK(flat.list(flat.node(flat.root())).size() == 2);
+
+    // children come before their parents
+    for(std::size_t i = 0; i < flat.nodes().size(); i++)
+        for(auto child : flat.nodes()[i].children)
+            if(child != std::uint32_t(FlatNodeId::NONE) && flat.nodes()[i].type != MODULE && flat.nodes()[i].type != COMPOUND_EXPR)
+                CHECK(child < i);
+
+    // a whole-module analysis as a linear scan
+    std::size_t literals = 0;
+    for(const auto& node : flat.nodes())
+        literals += node.type == LITERAL_EXPR;
+    CHECK(literals == 6);
+
+    const auto& var = flat.node(flat.list(flat.node(flat.root()))[1]);
+    CHECK(var.type == VARIABLE_DECL);
+    CHECK(flat.token(var) == Token{IDENTIFIER, 22, 23, std::string("outer")});
+    CHECK(var.child(0) == FlatNodeId::NONE);
+}
+
+TEST_CASE("FlatAst: round trip", "[flat_ast]") {
+    auto module = sample_module();
+    auto flat = flatten(body(module));
+
+    auto restored = unflatten(flat);
+    CHECK(!restored.get_deleter().in_arena);
+    CHECK(body(restored).arena != nullptr);
+    CHECK(body(restored).decls.front().get_deleter().in_arena);
+
+    CHECK(flatten(body(restored)) == flat);
+}
+
+TEST_CASE("FlatAst: empty", "[flat_ast]") {
+    FlatAst empty;
+    auto module = unflatten(empty);
+    CHECK(body(module).decls.empty());
+
+    // An empty module still has its own node
+    auto flat = flatten(body(module));
+    REQUIRE(flat.nodes().size() == 1);
+    CHECK(flat.node(flat.root()).type == MODULE);
+    CHECK(flat.list(flat.node(flat.root())).empty());
+}
@@ -0,0 +1,134 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/jit.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/vm.hpp"
+
+#include "expr_generator.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <fmt/core.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace mycomp;
+using namespace mycomp::test;
+
+#if defined(__x86_64__)
+constexpr bool native = true;
+#else
+constexpr bool native = false;
+#endif
+
+static JitFunction jit(std::string_view code, std::vector<Parameter> params) {
+    AstArena arena;
+    return jit_compile(*parse_expr(code, arena), params);
+}
+
+// The VM's result, for comparison
+static Slot interpret(std::string_view code, const std::vector<Parameter>& params, const std::vector<Slot>& args) {
+    AstArena arena;
+    return to_slot(VmReference(*parse_expr(code, arena), params)(args));
+}
+
+TEST_CASE("JIT: arithmetic", "[jit]") {
+    auto real = jit("a * 2.0 + b / 4.0 - -a", {{"a", ValueType::REAL}, {"b", ValueType::REAL}});
+    CHECK(real.isNative() == native);
+    CHECK(real.resultType() == ValueType::REAL);
+    CHECK(real(std::vector<Slot>{{.real = 1.5}, {.real = 2.0}}).real == 5.0);
+    CHECK(real(std::vector<Slot>{{.real = -1.0}, {.real = 0.0}}).real == -3.0);
+
+    auto integer = jit("x * x - 3 * y + -(x - 7)", {{"x", ValueType::INT}, {"y", ValueType::INT}});
+    CHECK(integer.isNative() == native);
+    CHECK(integer.resultType() == ValueType::INT);
+    CHECK(integer(std::vector<Slot>{{.integer = 5}, {.integer = 2}}).integer == 21);
+
+    // Integers wrap around as in the VM
+    constexpr auto max = std::numeric_limits<std::int64_t>::max();
+    auto wrap = jit("x + 1", {{"x", ValueType::INT}});
+    CHECK(wrap(std::vector<Slot>{{.integer = max}}).integer == std::numeric_limits<std::int64_t>::min());
+
+    // -0.0 is negated by its sign bit
+    auto negate = jit("-x", {{"x", ValueType::REAL}});
+    CHECK(std::signbit(negate(std::vector<Slot>{{.real = 0.0}}).real));
+
+    // Unused parameters of other types are fine
+    auto constant = jit("2.5", {{"b", ValueType::BOOL}});
+    CHECK(constant.isNative() == native);
+    CHECK(constant(std::vector<Slot>{{.boolean = true}}).real == 2.5);
+
+    CHECK_THROWS_AS(real(std::vector<Slot>{{.real = 1.0}}), std::invalid_argument);
+}
+
+TEST_CASE("JIT: falls back to the VM", "[jit]") {
+    auto abs = jit("if x < 0 { -x } else { x }", {{"x", ValueType::INT}});
+    CHECK(!abs.isNative());
+    CHECK(abs(std::vector<Slot>{{.integer = -4}}).integer == 4);
+
+    auto divide = jit("x / y", {{"x", ValueType::INT}, {"y", ValueType::INT}});
+    CHECK(!divide.isNative());
+    CHECK(divide(std::vector<Slot>{{.integer = 7}, {.integer = 2}}).integer == 3);
+    CHECK_THROWS_AS(divide(std::vector<Slot>{{.integer = 7}, {.integer = 0}}), RuntimeException);
+
+    auto compare = jit("x > 1.0", {{"x", ValueType::REAL}});
+    CHECK(!compare.isNative());
+    CHECK(compare.resultType() == ValueType::BOOL);
+    CHECK(compare(std::vector<Slot>{{.real = 2.0}}).boolean);
+
+    // Moving keeps the code working
+    auto moved = std::move(divide);
+    CHECK(moved(std::vector<Slot>{{.integer = 9}, {.integer = 3}}).integer == 3);
+
+    CHECK_THROWS_AS(jit("x + 1.0", {{"x", ValueType::INT}}), CompileException);
+    CHECK_THROWS_AS(jit("y", {{"x", ValueType::INT}}), CompileException);
+}
+
+TEST_CASE("JIT: spilling", "[jit]") {
+    // Every (x - c) is live until the innermost one is computed, far more than fit in registers
+    for(auto [type, zero] : {std::pair{ValueType::INT, "0"}, std::pair{ValueType::REAL, "0.5"}}) {
+        std::string code = "x";
+        for(int i = 0; i < 40; i++)
+            code = fmt::format("(x - {}) * ({})", zero, code);
+        code = fmt::format("{} + ({})", code, code);
+        std::vector<Parameter> params{{"x", type}};
+        std::vector<Slot> args{type == ValueType::INT ? Slot{.integer = 3} : Slot{.real = 1.25}};
+
+        auto function = jit(code, params);
+        CHECK(function.isNative() == native);
+        CHECK(function(args).integer == interpret(code, params, args).integer);
+    }
+}
+
+TEST_CASE("JIT: same results as the VM", "[jit]") {
+    for(auto type : {ValueType::INT, ValueType::REAL}) {
+        ExprGenerator gen(21, {{"p0", {}}, {"p1", {}}, {"p2", {}}, {"p3", {}}});
+        // What is compiled natively: no ifs, and no division of integers
+        gen.int_ops = {.binary = {"+", "-", "*"}, .unary = true, .ifs = false};
+        gen.real_ops = {.binary = {"+", "-", "*", "/"}, .unary = true, .ifs = false};
+        for(int i = 0; i < 300; i++) {
+            for(auto& var : gen.vars) {
+                if(type == ValueType::INT)
+                    var.value = std::int64_t(gen.rng() % 100) - 50;
+                else
+                    var.value = double(gen.rng() % 100) / 8 - 6;
+            }
+            auto code = gen.expr(type, 6).text;
+            auto params = gen.params();
+            auto args = gen.args();
+
+            auto function = jit(code, params);
+            REQUIRE(function.isNative() == native);
+            // Bitwise, so that NaNs compare too
+            INFO(code);
+            REQUIRE(function(args).integer == interpret(code, params, args).integer);
+        }
+    }
+}
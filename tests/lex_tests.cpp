@@ -1,12 +1,18 @@
 #include "mycomp/lex.hpp"
+#include "mycomp/utils/char_class.hpp"
 #include "mycomp/utils/token_to_string.hpp"
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_translate_exception.hpp>
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <cctype>
+#include <charconv>
 #include <cstdint>
 #include <exception>
+#include <random>
 #include <stdexcept>
 #include <string_view>
 #include <type_traits>
@@ -195,3 +201,260 @@ TEST_CASE("Hexadecimal chicanery", "[lex]") {
     CHECK(l.next().value() == mycomp::Token{REAL_NUMBER, 15, 21, double{0x1p2}});
     CHECK(!l.next().has_value());
 }
+
+TEST_CASE("Maximal munch", "[lex]") {
+    auto l = mycomp::Lexer("!==!=<>=");
+    CHECK(l.next().value() == mycomp::Token{NOT_EQ, 0, 2});
+    CHECK(l.next().value() == mycomp::Token{ASSIGN, 2, 3});
+    CHECK(l.next().value() == mycomp::Token{NOT_EQ, 3, 5});
+    CHECK(l.next().value() == mycomp::Token{LESS_THAN, 5, 6});
+    CHECK(l.next().value() == mycomp::Token{GREATER_THAN, 6, 7});
+    CHECK(l.next().value() == mycomp::Token{ASSIGN, 7, 8});
+    CHECK(!l.next().has_value());
+
+    CHECK_THROWS(mycomp::lex("a . b"));
+    CHECK_THROWS(mycomp::lex("@"));
+    CHECK_THROWS(mycomp::lex("\x80"));
+}
+
+TEST_CASE("Character classes match <cctype>", "[lex]") {
+    using namespace mycomp::char_class;
+    for(int i = 0; i < 256; i++) {
+        auto c = static_cast<char>(i);
+        auto u = static_cast<unsigned char>(i);
+        INFO("character " << i);
+        CHECK(mycomp::has_char_class(c, DIGIT) == bool(std::isdigit(u)));
+        CHECK(mycomp::has_char_class(c, HEX_DIGIT) == bool(std::isxdigit(u)));
+        CHECK(mycomp::has_char_class(c, WORD_START) == (c == '_' || std::isalpha(u)));
+        CHECK(mycomp::has_char_class(c, WORD) == (c == '_' || std::isalnum(u)));
+        CHECK(mycomp::has_char_class(c, SPACE) == bool(std::isspace(u)));
+        CHECK(mycomp::has_char_class(c, PUNCT) == bool(std::ispunct(u)));
+    }
+}
+
+TEST_CASE("Parallel lexing", "[lex]") {
+    // Lines that make chunk boundaries fall inside multi-line comments and strings
+    constexpr std::array<std::string_view, 6> pieces = {
+        "var x = 1.5e3 + y; // a comment\n",
+        "/* a comment\nspanning\nlines var z = 2; */\n",
+        "\"a string\nwith newlines\nvar w = 3;\"\n",
+        "fn f(a, b) { return a != b }\n",
+        "\n\n\n",
+        "x==y ",
+    };
+    std::string code;
+    for(std::size_t i = 0; code.size() < 3 * 512 * 1024; i++)
+        code += pieces[(i * 7 + i / 5) % pieces.size()];
+
+    auto expected = mycomp::lex(code);
+    for(unsigned threads : {1u, 2u, 3u, 8u, 16u})
+        CHECK(mycomp::lex_parallel(code, threads) == expected);
+
+    // The first error is reported, wherever the chunks start
+    for(auto error : {"/* unterminated", "\"unterminated", "*/", "\\"}) {
+        auto broken = code;
+        broken.insert(broken.find("var x", broken.size() / 3), error);
+        broken.insert(broken.find("var x", broken.size() / 3 * 2), "\\");
+
+        mycomp::LexException expected_error{}, actual_error{};
+        try {
+            mycomp::lex(broken);
+        } catch(mycomp::LexException& e) {
+            expected_error = e;
+        }
+        try {
+            mycomp::lex_parallel(broken, 8);
+        } catch(mycomp::LexException& e) {
+            actual_error = e;
+        }
+        CHECK(actual_error.begin_pos == expected_error.begin_pos);
+        CHECK(actual_error.end_pos == expected_error.end_pos);
+        CHECK(actual_error.error == expected_error.error);
+        CHECK(!expected_error.error.empty());
+    }
+}
+
+TEST_CASE("Incremental relexing", "[lex]") {
+    constexpr std::array<std::string_view, 12> pieces = {
+        "var", " ", "x", "1", ".5", "e", "=", "!", "\n", "/*", "*/", "//",
+    };
+    std::mt19937 gen(7);
+    auto random_text = [&](std::size_t pieces_count) {
+        std::string res;
+        for(std::size_t i = 0; i < pieces_count; i++)
+            res += pieces[gen() % pieces.size()];
+        return res;
+    };
+
+    std::string code = "var x = 1.5e3 + y; // a comment\nfn f(a, b) { return \"s\" != a }\n";
+    auto tokens = mycomp::lex(code);
+    for(int iter = 0; iter < 20000; iter++) {
+        auto offset = gen() % (code.size() + 1);
+        auto removed = std::min<std::size_t>(gen() % 4, code.size() - offset);
+        auto inserted = random_text(gen() % 3);
+        auto new_code = code.substr(0, offset) + inserted + code.substr(offset + removed);
+
+        std::vector<mycomp::Token> expected;
+        try {
+            expected = mycomp::lex(new_code);
+        } catch(mycomp::LexException&) {
+            auto before = tokens;
+            CHECK_THROWS_AS(mycomp::relex(tokens, new_code, {offset, removed, inserted}), mycomp::LexException);
+            CHECK(tokens == before);
+            continue;
+        }
+        mycomp::relex(tokens, new_code, {offset, removed, inserted});
+        REQUIRE(tokens == expected);
+        code = std::move(new_code);
+    }
+}
+
+TEST_CASE("Batches of tokens", "[lex]") {
+    constexpr std::string_view code =
+        "var abc = 0x10 + 1.5e3; // comment\n"
+        "fn f(a_very_long_identifier_that_does_not_fit_into_sso, b) {\n"
+        "    return \"a string literal\" != abc\n"
+        "}";
+    auto expected = mycomp::lex(code);
+
+    for(std::size_t batch_size : {1, 2, 5, 100}) {
+        std::vector<mycomp::Token> buf(batch_size);
+        // Starting from stale contents, as when the buffer is reused
+        for(int pass = 0; pass < 2; pass++) {
+            std::vector<mycomp::Token> actual;
+            mycomp::Lexer lexer(code);
+            while(true) {
+                auto count = lexer.nextBatch(buf);
+                actual.insert(actual.end(), buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(count));
+                if(count < buf.size())
+                    break;
+            }
+            CHECK(actual == expected);
+        }
+    }
+    CHECK(mycomp::lex("").empty());
+}
+
+TEST_CASE("Lexing with diagnostics", "[lex]") {
+    auto res = mycomp::lex_with_diagnostics("var 012 = 1.2.3; \"a\\b\" \x01 x */ y /* z");
+
+    std::vector<mycomp::TokenType> types;
+    for(const auto& tok : res.tokens)
+        types.push_back(tok.tokenType);
+    CHECK(types == std::vector{VAR, ERROR, ASSIGN, ERROR, SEMICOLON, ERROR, ERROR, IDENTIFIER, ERROR, IDENTIFIER, ERROR});
+
+    REQUIRE(res.diagnostics.size() == 6);
+    CHECK(res.diagnostics[0].error == "Leading zero in a number!");
+    CHECK(res.diagnostics[1].error == "Unexpected point in a number!");
+    CHECK(res.diagnostics[2].error == "Escape sequences inside strings are not supported yet!");
+    CHECK(res.diagnostics[3].error == "Unrecognized character!");
+    CHECK(res.diagnostics[4].error == "Unexpected inline comment terminator encountered!");
+    CHECK(res.diagnostics[5].error == "Inline comment not terminated!");
+
+    // ERROR tokens cover the malformed code
+    CHECK(res.tokens[1].begin_pos == 4);
+    CHECK(res.tokens[1].end_pos == 7);
+    CHECK(res.tokens[3].end_pos == 15);
+    CHECK(res.tokens.back().end_pos == 36);
+}
+
+TEST_CASE("Diagnostics agree with exceptions", "[lex]") {
+    constexpr std::array<std::string_view, 15> pieces = {
+        " ", "x", "1", "0", ".", "e", "\"", "\\", "#", "\x01", "/*", "*/", "=", "!", "\n",
+    };
+    std::mt19937 gen(3);
+    for(int iter = 0; iter < 20000; iter++) {
+        std::string code;
+        for(auto len = gen() % 12; len > 0; len--)
+            code += pieces[gen() % pieces.size()];
+
+        auto res = mycomp::lex_with_diagnostics(code);
+        auto errors = std::ranges::count(res.tokens, ERROR, &mycomp::Token::tokenType);
+        CHECK(static_cast<std::size_t>(errors) == res.diagnostics.size());
+        try {
+            auto tokens = mycomp::lex(code);
+            CHECK(tokens == res.tokens);
+        } catch(mycomp::LexException& e) {
+            // Up to the first error, both agree
+            REQUIRE(!res.diagnostics.empty());
+            CHECK(res.diagnostics[0].begin_pos == e.begin_pos);
+            CHECK(res.diagnostics[0].end_pos == e.end_pos);
+            CHECK(res.diagnostics[0].error == e.error);
+        }
+    }
+}
+
+TEST_CASE("Decimal fast path agrees with from_chars", "[lex]") {
+    std::mt19937 gen(16);
+    auto digits = [&](std::size_t count) {
+        std::string res;
+        for(std::size_t i = 0; i < count; i++)
+            res += static_cast<char>('0' + gen() % 10);
+        return res;
+    };
+
+    for(int iter = 0; iter < 100000; iter++) {
+        auto int_part = digits(gen() % 24);
+        auto literal = int_part;
+        bool is_real = int_part.empty() || gen() % 2;
+        if(is_real)
+            literal += "." + digits(gen() % 24 + (int_part.empty() ? 1 : 0));
+        bool leading_zero = int_part.size() > 1 && int_part[0] == '0';
+
+        INFO(literal);
+        mycomp::Token tok{};
+        try {
+            tok = mycomp::lex(literal + ";").at(0);
+        } catch(mycomp::LexException&) {
+            CHECK((leading_zero || !is_real));
+            continue;
+        }
+        CHECK(!leading_zero);
+        CHECK(tok.end_pos == literal.size());
+        if(is_real) {
+            double expected = 0;
+            std::from_chars(literal.data(), literal.data() + literal.size(), expected);
+            CHECK(tok == mycomp::Token{REAL_NUMBER, 0, literal.size(), expected});
+        } else {
+            uint64_t expected = 0;
+            std::from_chars(literal.data(), literal.data() + literal.size(), expected);
+            CHECK(tok == mycomp::Token{NATURAL_NUMBER, 0, literal.size(), expected});
+        }
+    }
+}
+
+TEST_CASE("Span tokens", "[lex]") {
+    constexpr std::string_view code =
+        "var abc = 0x10 + 1.5e3 * 17; // comment\n"
+        "fn f(a, b) { return \"a string\" != abc }";
+    auto expected = mycomp::lex(code);
+    auto spans = mycomp::lex_spans(code);
+
+    REQUIRE(spans.size() == expected.size());
+    for(std::size_t i = 0; i < spans.size(); i++) {
+        CHECK(spans[i] == mycomp::SpanToken{expected[i].tokenType, expected[i].begin_pos, expected[i].end_pos});
+        CHECK(mycomp::decode(code, spans[i]) == expected[i]);
+    }
+    CHECK(mycomp::token_text(code, spans[1]) == "abc");
+    CHECK(mycomp::decode_natural(code, spans[3]) == 16);
+    CHECK(mycomp::decode_real(code, spans[5]) == 1500.0);
+
+    // Too large numbers are reported once they are decoded
+    constexpr std::string_view huge = "123456789012345678901234567890";
+    auto huge_spans = mycomp::lex_spans(huge);
+    REQUIRE(huge_spans.size() == 1);
+    CHECK(huge_spans[0].tokenType == NATURAL_NUMBER);
+    CHECK_THROWS_AS(mycomp::decode_natural(huge, huge_spans[0]), mycomp::LexException);
+
+    CHECK_THROWS_AS(mycomp::lex_spans("1 01"), mycomp::LexException);
+    // Malformed numbers are reported while lexing, as lex() does
+    for(auto malformed : {"0x", "1e", "1e+", "1.5e", "0x1p", "0x1p-", "0x1pA", "0x.p1"}) {
+        INFO(malformed);
+        CHECK_THROWS_AS(mycomp::lex(malformed), mycomp::LexException);
+        CHECK_THROWS_AS(mycomp::lex_spans(malformed), mycomp::LexException);
+    }
+    // Long decimals are only scanned
+    auto long_real = mycomp::lex_spans("123456789012345678901234.5678901234567890123");
+    REQUIRE(long_real.size() == 1);
+    CHECK(long_real[0] == mycomp::SpanToken{REAL_NUMBER, 0, 44});
+}
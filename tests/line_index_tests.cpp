@@ -0,0 +1,68 @@
+#include "mycomp/lex.hpp"
+#include "mycomp/utils/line_index.hpp"
+#include "mycomp/utils/simd.hpp"
+#include "mycomp/utils/token_to_string.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <random>
+#include <string>
+#include <string_view>
+
+using mycomp::SourceLocation;
+
+TEST_CASE("LineIndex: lookups", "[line_index]") {
+    mycomp::LineIndex lines("ab\n\ncd\n");
+
+    CHECK(lines.lineCount() == 4);
+    CHECK(lines.location(0) == SourceLocation{1, 1});
+    CHECK(lines.location(2) == SourceLocation{1, 3});
+    CHECK(lines.location(3) == SourceLocation{2, 1});
+    CHECK(lines.location(5) == SourceLocation{3, 2});
+    CHECK(lines.location(7) == SourceLocation{4, 1});
+    CHECK(lines.location(100) == SourceLocation{4, 1});
+
+    CHECK(lines.lineRange(1).begin == 0);
+    CHECK(lines.lineRange(1).end == 2);
+    CHECK(lines.lineRange(2).begin == lines.lineRange(2).end);
+    CHECK(lines.lineRange(3).begin == 4);
+    CHECK(lines.lineRange(3).end == 6);
+    CHECK(lines.lineRange(4).begin == 7);
+    CHECK(lines.lineRange(4).end == 7);
+
+    CHECK(mycomp::LineIndex("").lineCount() == 1);
+}
+
+TEST_CASE("LineIndex: every SimdLevel agrees with a rescan", "[line_index]") {
+    std::mt19937 gen(5);
+    for(int iter = 0; iter < 200; iter++) {
+        std::string code;
+        for(auto len = gen() % 300; len > 0; len--)
+            code += gen() % 4 == 0 ? '\n' : 'x';
+
+        for(auto simd : {mycomp::SimdLevel::SCALAR, mycomp::SimdLevel::SSE42, mycomp::SimdLevel::AVX2}) {
+            if(simd > mycomp::detect_simd_level())
+                continue;
+            mycomp::LineIndex lines(code, simd);
+            SourceLocation expected{1, 1};
+            for(std::size_t pos = 0; pos <= code.size(); pos++) {
+                REQUIRE(lines.location(pos) == expected);
+                if(pos < code.size() && code[pos] == '\n')
+                    expected = {expected.line + 1, 1};
+                else
+                    expected.column++;
+            }
+        }
+    }
+}
+
+TEST_CASE("LineIndex: formatting", "[line_index]") {
+    constexpr std::string_view code = "var x = 1;\n  x = y $";
+    mycomp::LineIndex lines(code);
+
+    auto tokens = mycomp::lex_with_diagnostics(code);
+    CHECK(mycomp::token_to_string(tokens.tokens[4], lines) == "SEMICOLON() at 1:10-1:11");
+    CHECK(mycomp::token_to_string(tokens.tokens[5], lines) == "IDENTIFIER(x) at 2:3-2:4");
+    REQUIRE(tokens.diagnostics.size() == 1);
+    CHECK(mycomp::lex_error_to_string(tokens.diagnostics[0], lines) == "2:9: Unexpected sequence of special characters");
+}
@@ -0,0 +1,51 @@
+#include "mycomp/lex.hpp"
+#include "mycomp/mapped_source.hpp"
+
+#include "temp_dir.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+using namespace mycomp::test;
+
+TEST_CASE("MappedSource: file contents", "[mapped_source]") {
+    TempDir dir;
+    write_file(dir.path / "test.txt", "var x = 1;");
+    mycomp::MappedSource source(dir.path / "test.txt");
+    CHECK(source.text() == "var x = 1;");
+
+    auto moved = std::move(source);
+    CHECK(moved.text() == "var x = 1;");
+    CHECK(source.text().empty());
+
+    write_file(dir.path / "empty.txt", "");
+    CHECK(mycomp::MappedSource(dir.path / "empty.txt").size() == 0);
+
+    CHECK_THROWS_AS(mycomp::MappedSource("/nonexistent/mycomp/file"), std::system_error);
+}
+
+TEST_CASE("lex_file: same tokens as lex()", "[mapped_source]") {
+    constexpr std::string_view code =
+        "var abc = 0x10 + 1.5e3; // comment\n"
+        "fn f(a, b) { return \"a string\" != abc }";
+    TempDir dir;
+    write_file(dir.path / "test.txt", code);
+
+    auto lexed = mycomp::lex_file(dir.path / "test.txt");
+    auto expected = mycomp::lex(code);
+
+    REQUIRE(lexed.tokens.size() == expected.size());
+    for(std::size_t i = 0; i < expected.size(); i++) {
+        CHECK(lexed.tokens[i].tokenType == expected[i].tokenType);
+        CHECK(lexed.tokens[i].begin_pos == expected[i].begin_pos);
+        CHECK(lexed.tokens[i].end_pos == expected[i].end_pos);
+        if(auto* text = std::get_if<std::string>(&expected[i].payload))
+            CHECK(lexed.text(lexed.tokens[i]) == *text);
+        else
+            CHECK(lexed.tokens[i].payload == expected[i].payload);
+    }
+}
@@ -0,0 +1,150 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+#include "mycomp/lex.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/utils/print_ast.hpp"
+
+#include "sexpr.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_translate_exception.hpp>
+
+#include <fmt/core.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+using namespace mycomp;
+using namespace mycomp::test;
+using enum AstNodeType;
+
+CATCH_TRANSLATE_EXCEPTION(const ParseException& e) {
+    return e.error;
+}
+
+namespace {
+
+std::string expr(std::string_view code) {
+    AstArena arena;
+    return sexpr(*parse_expr(code, arena));
+}
+
+std::string module(std::string_view code) {
+    return sexpr(*parse(code));
+}
+
+}
+
+TEST_CASE("Parser: precedence and associativity", "[parser]") {
+    CHECK(expr("1") == "(LITERAL_EXPR 1)");
+    CHECK(expr("1 + 2 * 3") == "(BINARY_EXPR PLUS (LITERAL_EXPR 1) (BINARY_EXPR STAR (LITERAL_EXPR 2) (LITERAL_EXPR 3)))");
+    CHECK(expr("1 - 2 - 3") == "(BINARY_EXPR MINUS (BINARY_EXPR MINUS (LITERAL_EXPR 1) (LITERAL_EXPR 2)) (LITERAL_EXPR 3))");
+    CHECK(expr("(1 - 2) * x") == "(BINARY_EXPR STAR (BINARY_EXPR MINUS (LITERAL_EXPR 1) (LITERAL_EXPR 2)) (LITERAL_EXPR x))");
+    CHECK(expr("a < b == c > d") ==
+        "(BINARY_EXPR EQUALS (BINARY_EXPR LESS_THAN (LITERAL_EXPR a) (LITERAL_EXPR b))"
+        " (BINARY_EXPR GREATER_THAN (LITERAL_EXPR c) (LITERAL_EXPR d)))");
+    CHECK(expr("-a * !!b") ==
+        "(BINARY_EXPR STAR (UNARY_EXPR MINUS (LITERAL_EXPR a)) (UNARY_EXPR NOT (UNARY_EXPR NOT (LITERAL_EXPR b))))");
+    CHECK(expr("!(a + b)") == "(UNARY_EXPR NOT (BINARY_EXPR PLUS (LITERAL_EXPR a) (LITERAL_EXPR b)))");
+    CHECK(expr("1.5 != \"s\"") == "(BINARY_EXPR NOT_EQ (LITERAL_EXPR 1.5) (LITERAL_EXPR s))");
+}
+
+TEST_CASE("Parser: compound, if and return", "[parser]") {
+    CHECK(expr("{}") == "(COMPOUND_EXPR _)");
+    CHECK(expr("{ var int x = 1; x = x + 1; f; x }") ==
+        "(COMPOUND_EXPR (VARIABLE_DECL x (PRIMITIVE_TYPE int) (LITERAL_EXPR 1))"
+        " (ASSIGNMENT_STMT x (BINARY_EXPR PLUS (LITERAL_EXPR x) (LITERAL_EXPR 1)))"
+        " (EXPR_STMT (LITERAL_EXPR f)) (LITERAL_EXPR x))");
+    CHECK(expr("{ return; }") == "(COMPOUND_EXPR (EXPR_STMT (RETURN_EXPR _)) _)");
+    CHECK(expr("if a { 1 } else if b { 2 } else { return 3 }") ==
+        "(IF_EXPR (LITERAL_EXPR a) (COMPOUND_EXPR (LITERAL_EXPR 1))"
+        " (IF_EXPR (LITERAL_EXPR b) (COMPOUND_EXPR (LITERAL_EXPR 2))"
+        " (COMPOUND_EXPR (RETURN_EXPR (LITERAL_EXPR 3)))))");
+    CHECK(expr("if a { 1 }") == "(IF_EXPR (LITERAL_EXPR a) (COMPOUND_EXPR (LITERAL_EXPR 1)) _)");
+    CHECK(expr("1 + if a { 2 } else { 3 } * 4") ==
+        "(BINARY_EXPR PLUS (LITERAL_EXPR 1) (BINARY_EXPR STAR"
+        " (IF_EXPR (LITERAL_EXPR a) (COMPOUND_EXPR (LITERAL_EXPR 2)) (COMPOUND_EXPR (LITERAL_EXPR 3))) (LITERAL_EXPR 4)))");
+}
+
+TEST_CASE("Parser: printing missing children", "[parser]") {
+    // `if` without `else`, a block without a value and a bare `return`
+    auto module = parse(
+        "var int x = if a { 1 };\n"
+        "var int y = { x = 2; };\n"
+        "var int z = { return; };\n"
+    );
+    auto file = std::unique_ptr<std::FILE, int(*)(std::FILE*)>(std::tmpfile(), &std::fclose);
+    REQUIRE(file);
+    module->acceptVisitor(*make_ast_printer(file.get()));
+    std::string printed(static_cast<std::size_t>(std::ftell(file.get())), '\0');
+    std::rewind(file.get());
+    REQUIRE(std::fread(printed.data(), 1, printed.size(), file.get()) == printed.size());
+    CHECK(printed ==
+        "└Module\n"
+        "  └VariableDecl\n"
+        "    └Type\n"
+        "      └IDENTIFIER(int) at [4, 7)\n"
+        "    └IDENTIFIER(x) at [8, 9)\n"
+        "    └IfExpr\n"
+        "      └LiteralExpr\n"
+        "        └IDENTIFIER(a) at [15, 16)\n"
+        "      └CompoundExpr\n"
+        "        └LiteralExpr\n"
+        "          └NATURAL_NUMBER(1) at [19, 20)\n"
+        "  └VariableDecl\n"
+        "    └Type\n"
+        "      └IDENTIFIER(int) at [28, 31)\n"
+        "    └IDENTIFIER(y) at [32, 33)\n"
+        "    └CompoundExpr\n"
+        "      └AssignmentStmt\n"
+        "        └IDENTIFIER(x) at [38, 39)\n"
+        "        └LiteralExpr\n"
+        "          └NATURAL_NUMBER(2) at [42, 43)\n"
+        "  └VariableDecl\n"
+        "    └Type\n"
+        "      └IDENTIFIER(int) at [52, 55)\n"
+        "    └IDENTIFIER(z) at [56, 57)\n"
+        "    └CompoundExpr\n"
+        "      └ExprStmt\n"
+        "        └ReturnExpr\n");
+}
+
+TEST_CASE("Parser: modules", "[parser]") {
+    CHECK(module("") == "(MODULE)");
+    CHECK(module("var int x = 1; fn int f(); var float y = { x };") ==
+        "(MODULE (VARIABLE_DECL x (PRIMITIVE_TYPE int) (LITERAL_EXPR 1))"
+        " (FUNCTION_DECL f (PRIMITIVE_TYPE int))"
+        " (VARIABLE_DECL y (PRIMITIVE_TYPE float) (COMPOUND_EXPR (LITERAL_EXPR x))))");
+
+    // The module owns the arena its nodes are in
+    auto parsed = parse("var int x = 1 + 2;");
+    CHECK(!parsed.get_deleter().in_arena);
+    visit_ast_node(*parsed, []<AstNodeType type>(const AstNodeBody<type>& body) {
+        if constexpr (type == MODULE) {
+            REQUIRE(body.arena);
+            CHECK(body.arena->size() == 5);
+            CHECK(body.decls.front().get_deleter().in_arena);
+        }
+    });
+}
+
+TEST_CASE("Parser: errors", "[parser]") {
+    auto error = [](std::string_view code) -> std::string {
+        try {
+            parse(code);
+        } catch(ParseException& e) {
+            return fmt::format("{}-{}: {}", e.begin_pos, e.end_pos, e.error);
+        }
+        return "";
+    };
+    CHECK(error("var int x = 1") == "13-13: Expected SEMICOLON");
+    CHECK(error("var x = 1;") == "6-7: Expected IDENTIFIER");
+    CHECK(error("1;") == "0-1: Expected a declaration");
+    CHECK(error("var int x = 1 +;") == "15-16: Expected an expression");
+    CHECK(error("var int x = { 1 2 };") == "16-17: Expected SEMICOLON or RIGHT_BRACE");
+    CHECK(error("var int x = (1;") == "14-15: Expected RIGHT_PAREN");
+    CHECK_THROWS_AS(parse("var int x = 01;"), LexException);
+}
@@ -0,0 +1,217 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/passes.hpp"
+#include "mycomp/vm.hpp"
+
+#include "sexpr.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace mycomp;
+using namespace mycomp::test;
+using enum AstNodeType;
+
+static AstNodeBody<MODULE>& body(const ModulePtr& module) {
+    return static_cast<AstNodeConcrete<MODULE>&>(*module).body_;
+}
+
+// The folded code, as an s-expression
+static std::string folded(std::string_view code) {
+    auto module = parse(code);
+    fold_constants(body(module));
+    return sexpr(*module);
+}
+
+static std::string parsed(std::string_view code) {
+    return sexpr(*parse(code));
+}
+
+TEST_CASE("Constant folding: operators", "[passes]") {
+    CHECK(folded("var int x = 1 + 2 * 3 - 4 / 2;") == parsed("var int x = 5;"));
+    CHECK(folded("var int x = 2 - 5;") == parsed("var int x = -3;"));
+    CHECK(folded("var int x = -(2 - 5) * -(-4);") == parsed("var int x = 12;"));
+    CHECK(folded("var real x = 1.5 * 2.0 - -0.5;") == parsed("var real x = 3.5;"));
+    CHECK(folded("var bool b = !true;") == parsed("var bool b = false;"));
+    CHECK(folded("var bool b = 1 < 2 == (2.5 > 3.0);") == parsed("var bool b = false;"));
+    CHECK(folded("var int x = y + 2 * 3;") == parsed("var int x = y + 6;"));
+    CHECK(folded("var int x = { var int y = 1 + 1; y * (3 - 1) };") == parsed("var int x = { var int y = 2; y * 2 };"));
+
+    // Left to fail or be rejected as the VM would
+    CHECK(folded("var int x = 1 / 0;") == parsed("var int x = 1 / 0;"));
+    CHECK(folded("var int x = 1 + 2.0;") == parsed("var int x = 1 + 2.0;"));
+    CHECK(folded("var int x = !1;") == parsed("var int x = !1;"));
+    CHECK(folded("var int x = 9223372036854775807 + 1;") == parsed("var int x = 9223372036854775807 + 1;"));
+    CHECK(folded("var int x = 9223372036854775808 - 1;") == parsed("var int x = 9223372036854775808 - 1;"));
+
+    // The literal covers the folded expression
+    auto module = parse("var int x = (1 + 2) * 3;");
+    fold_constants(body(module));
+    const auto& value = static_cast<const AstNodeConcrete<LITERAL_EXPR>&>(
+        *static_cast<const AstNodeConcrete<VARIABLE_DECL>&>(*body(module).decls[0]).body_.value
+    ).body_.body;
+    CHECK(value.begin_pos == 13);
+    CHECK(value.end_pos == 23);
+}
+
+TEST_CASE("Constant folding: identities", "[passes]") {
+    CHECK(folded("var int y = x + 0 - 0;") == parsed("var int y = x;"));
+    CHECK(folded("var int y = 0 + x * 1;") == parsed("var int y = x;"));
+    CHECK(folded("var int y = 1 * x / 1;") == parsed("var int y = x;"));
+    CHECK(folded("var int y = -(-x) + x * 0;") == parsed("var int y = x;"));
+    CHECK(folded("var int y = 0 * { x = 1; x };") == parsed("var int y = 0 * { x = 1; x };"));
+    CHECK(folded("var real y = x * 1.0 - 0.0;") == parsed("var real y = x;"));
+    CHECK(folded("var real y = x + 0.0;") == parsed("var real y = x + 0.0;"));
+    CHECK(folded("var real y = x - -0.0;") != parsed("var real y = x;"));
+    CHECK(folded("var bool y = !!(b == true) != false;") == parsed("var bool y = b;"));
+}
+
+TEST_CASE("Constant folding: ifs", "[passes]") {
+    CHECK(folded("var int x = if 1 < 2 { a } else { b };") == parsed("var int x = { a };"));
+    CHECK(folded("var int x = if false { a } else if true { b } else { c };") == parsed("var int x = { b };"));
+    CHECK(folded("var int x = if c { 1 + 1 } else { 2 };") == parsed("var int x = if c { 2 } else { 2 };"));
+    CHECK(folded("var int x = { if false { y = 1; }; y };") == parsed("var int x = { {}; y };"));
+    CHECK(folded("var int x = { if !false { y = 1; 2 }; y };") == parsed("var int x = { { y = 1; 2; }; y };"));
+}
+
+TEST_CASE("Constant folding: in place", "[passes]") {
+    auto module = parse("var int x = (1 + 2) * 3 - 4; var bool b = !(x > 2 == true);");
+    auto nodes = body(module).arena->size();
+    CHECK(fold_constants(body(module)));
+    CHECK(body(module).arena->size() == nodes);
+
+    // Folding again finds nothing to do
+    CHECK(!fold_constants(body(module)));
+}
+
+namespace {
+
+// Random integer code with many constant subexpressions
+struct CodeGenerator {
+    std::mt19937_64 rng;
+    std::size_t vars = 0;
+
+    std::string expr(int depth) {
+        auto kind = depth == 0 ? rng() % 3 : rng() % 9;
+        if(kind == 0 && vars > 0)
+            return fmt::format("v{}", rng() % vars);
+        if(kind <= 1)
+            return fmt::format("{}", rng() % 4);
+        if(kind == 2)
+            return "1";
+        if(kind == 3)
+            return fmt::format("-{}", expr(depth - 1));
+        if(kind == 4)
+            return fmt::format("if {} < {} {{ {} }} else {{ {} }}", expr(depth - 1), expr(depth - 1), expr(depth - 1), expr(depth - 1));
+        if(kind == 5)
+            return fmt::format("if !({} == {}) {{ {} }} else {{ {} }}", expr(depth - 1), expr(depth - 1), expr(depth - 1), expr(depth - 1));
+        static constexpr const char* ops[] = {"+", "-", "*"};
+        return fmt::format("({} {} {})", expr(depth - 1), ops[rng() % 3], expr(depth - 1));
+    }
+};
+
+}
+
+TEST_CASE("Constant folding: same results", "[passes]") {
+    CodeGenerator gen{.rng = std::mt19937_64(20)};
+    std::string code;
+    for(int i = 0; i < 200; i++) {
+        code += fmt::format("var int v{} = {};\n", i, gen.expr(4));
+        gen.vars++;
+    }
+
+    auto module = parse(code);
+    auto before = compile(body(module));
+    CHECK(fold_constants(body(module)));
+    auto after = compile(body(module));
+    CHECK(after.code.size() < before.code.size());
+
+    Vm vm_before, vm_after;
+    vm_before.run(before);
+    vm_after.run(after);
+    for(int i = 0; i < 200; i++) {
+        auto name = fmt::format("v{}", i);
+        REQUIRE(vm_before.variable(before, name) == vm_after.variable(after, name));
+    }
+}
+
+TEST_CASE("Constant folding: in parallel", "[passes]") {
+    CodeGenerator gen{.rng = std::mt19937_64(25)};
+    std::string code;
+    for(int i = 0; i < 100; i++) {
+        code += fmt::format("var int v{} = {};\n", i, gen.expr(4));
+        gen.vars++;
+    }
+    // A block large enough to be split into tasks too
+    code += "var int big = {";
+    for(int i = 0; i < 300; i++)
+        code += fmt::format(" var int b{} = {};", i, gen.expr(3));
+    code += " 1 + 2 };\n";
+
+    auto sequential = parse(code);
+    CHECK(fold_constants(body(sequential)));
+    auto expected = sexpr(*sequential);
+
+    for(unsigned threads : {1u, 2u, 3u, 8u}) {
+        INFO(threads);
+        TaskScheduler scheduler(threads);
+        auto module = parse(code);
+        auto nodes = body(module).arena->size();
+        CHECK(fold_constants(body(module), scheduler));
+        CHECK(sexpr(*module) == expected);
+        // The nodes that folding created are owned by the module
+        CHECK(body(module).arena->size() > nodes);
+        CHECK(!fold_constants(body(module), scheduler));
+
+        // The module arena now holds nodes of every worker, which own and are
+        // owned by nodes of the other arenas; destroying it must not look at
+        // nodes that are already destroyed (checked in the sanitizer build)
+        module.reset();
+    }
+
+    TaskScheduler scheduler(4);
+    auto module = parse(code);
+    CHECK(default_passes(scheduler).run(body(module)));
+    CHECK(sexpr(*module) == expected);
+}
+
+TEST_CASE("Pass manager", "[passes]") {
+    auto module = parse("var int x = 1 + 2;");
+
+    // Puts `1 + 2` back twice, so that folding has to run again
+    int undone = 0;
+    PassManager passes = default_passes();
+    passes.add("unfold", [&](AstNodeBody<MODULE>& m) {
+        auto& decl = static_cast<AstNodeConcrete<VARIABLE_DECL>&>(*m.decls[0]).body_;
+        if(undone == 2 || decl.value->type() != LITERAL_EXPR)
+            return false;
+        undone++;
+        decl.value = parse_expr("1 + 2", *m.arena);
+        return true;
+    });
+
+    CHECK(passes.run(body(module)));
+    CHECK(sexpr(*module) == parsed("var int x = 3;"));
+    REQUIRE(passes.statistics().size() == 2);
+    CHECK(passes.statistics()[0].name == "fold_constants");
+    CHECK(passes.statistics()[0].runs == 4);
+    CHECK(passes.statistics()[0].changes == 3);
+    CHECK(passes.statistics()[1].runs == 4);
+    CHECK(passes.statistics()[1].changes == 2);
+
+    CHECK(!passes.run(body(module)));
+
+    // Passes that never settle are stopped
+    PassManager endless;
+    endless.add("endless", [](AstNodeBody<MODULE>&) { return true; });
+    CHECK(endless.run(body(module), 5));
+    CHECK(endless.statistics()[0].runs == 5);
+}
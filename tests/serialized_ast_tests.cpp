@@ -0,0 +1,163 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/flat_ast.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/serialized_ast.hpp"
+
+#include "sexpr.hpp"
+#include "temp_dir.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace mycomp;
+using namespace mycomp::test;
+using enum AstNodeType;
+
+namespace {
+
+constexpr const char* code =
+    "var int x = 1 + 2 * y;\n"
+    "fn int f();\n"
+    "var real r = { var bool b = !(x > 2) == (1.5 != \"s\"); x = -x; f; if b { return 2.5; } else { r } };\n"
+    "var int z = if x < 0 { x } else if y { 0 };\n";
+
+const AstNodeBody<MODULE>& body(const ModulePtr& module) {
+    return static_cast<const AstNodeConcrete<MODULE>&>(*module).body_;
+}
+
+}
+
+TEST_CASE("SerializedAst: round trip", "[serialized_ast]") {
+    auto module = parse(code);
+    auto flat = flatten(body(module));
+    auto bytes = serialize(flat);
+
+    SerializedAst ast(bytes);
+    REQUIRE(ast.nodes().size() == flat.nodes().size());
+    CHECK(ast.node(ast.root()).type == MODULE);
+    CHECK(ast.list(ast.node(ast.root())).size() == 4);
+
+    // Read in place
+    CHECK(static_cast<const void*>(ast.nodes().data()) >= bytes.data());
+    CHECK(static_cast<const void*>(ast.nodes().data() + ast.nodes().size()) <= bytes.data() + bytes.size());
+    const auto& decl = ast.node(ast.list(ast.node(ast.root()))[0]);
+    CHECK(ast.text(ast.tokens()[decl.token]) == "x");
+    CHECK(static_cast<const void*>(ast.text(ast.tokens()[decl.token]).data()) > bytes.data());
+
+    // Exactly the same tree, token positions and payloads included
+    auto restored = unflatten(ast);
+    CHECK(flatten(body(restored)) == flat);
+    CHECK(sexpr(*restored) == sexpr(*module));
+    CHECK(body(restored).decls.front().get_deleter().in_arena);
+
+    // And the same bytes again
+    CHECK(serialize(flatten(body(restored))) == bytes);
+
+    CHECK(flatten(body(unflatten(SerializedAst(serialize(flatten(body(parse(""))))))))  == flatten(body(parse(""))));
+}
+
+TEST_CASE("SerializedAst: mapped file", "[serialized_ast]") {
+    auto module = parse(code);
+    TempDir dir;
+    auto path = dir.path / "module.ast";
+    write_file(path, serialize(flatten(body(module))));
+
+    MappedAst mapped(path);
+    CHECK(sexpr(*unflatten(mapped.ast())) == sexpr(*module));
+
+    CHECK_THROWS_AS(MappedAst(dir.path / "missing.ast"), std::system_error);
+    write_file(path, "");
+    CHECK_THROWS_AS(MappedAst(path), SerializedAstError);
+}
+
+TEST_CASE("SerializedAst: malformed", "[serialized_ast]") {
+    auto bytes = serialize(flatten(body(parse(code))));
+
+    auto damaged = [&](auto damage) {
+        auto copy = bytes;
+        damage(copy);
+        return copy;
+    };
+    CHECK_THROWS_AS(SerializedAst(damaged([](auto& b) { b.resize(100); })), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(damaged([](auto& b) { b.pop_back(); })), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(damaged([](auto& b) { b[0] = std::byte{'M'}; })), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(damaged([](auto& b) { std::ranges::reverse(b.begin() + 8, b.begin() + 12); })), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(damaged([](auto& b) { b[12] = std::byte{serialized_ast_version + 1}; })), SerializedAstError);
+
+    // Nodes and their children as unflatten() and the tree's readers could not take
+    SerializedAst ast(bytes);
+    auto patched = [&](AstNodeType type, std::size_t field, std::uint32_t value) {
+        auto node = std::ranges::find(ast.nodes(), type, &FlatNode::type);
+        REQUIRE(node != ast.nodes().end());
+        auto offset = static_cast<std::size_t>(reinterpret_cast<const std::byte*>(&*node) - bytes.data()) + field;
+        return damaged([&](auto& b) {
+            std::memcpy(b.data() + offset, &value, sizeof(value));
+        });
+    };
+    auto child = [](std::size_t ind) {
+        return offsetof(FlatNode, children) + ind * sizeof(std::uint32_t);
+    };
+    auto first_binary = static_cast<std::uint32_t>(std::ranges::find(ast.nodes(), BINARY_EXPR, &FlatNode::type) - ast.nodes().begin());
+    auto none = std::uint32_t(FlatNodeId::NONE);
+
+    // A child that is not before its parent
+    CHECK_THROWS_AS(SerializedAst(patched(BINARY_EXPR, child(0), first_binary)), SerializedAstError);
+    // Missing children that are required
+    CHECK_THROWS_AS(SerializedAst(patched(BINARY_EXPR, child(0), none)), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(BINARY_EXPR, child(1), none)), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(UNARY_EXPR, child(0), none)), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(IF_EXPR, child(0), none)), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(IF_EXPR, child(1), none)), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(VARIABLE_DECL, child(0), none)), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(EXPR_STMT, child(0), none)), SerializedAstError);
+    // A child where the node has none
+    CHECK_THROWS_AS(SerializedAst(patched(LITERAL_EXPR, child(0), 0)), SerializedAstError);
+    // Missing tokens
+    for(auto type : {LITERAL_EXPR, BINARY_EXPR, UNARY_EXPR, VARIABLE_DECL, FUNCTION_DECL, PRIMITIVE_TYPE, ASSIGNMENT_STMT})
+        CHECK_THROWS_AS(SerializedAst(patched(type, offsetof(FlatNode, token), no_flat_token)), SerializedAstError);
+    // Tokens of the wrong kind, such as a number for a name
+    auto token_of = [&](TokenType type) {
+        auto token = std::ranges::find(ast.tokens(), type, &CompactToken::tokenType);
+        REQUIRE(token != ast.tokens().end());
+        return static_cast<std::uint32_t>(token - ast.tokens().begin());
+    };
+    for(auto type : {VARIABLE_DECL, FUNCTION_DECL, PRIMITIVE_TYPE, ASSIGNMENT_STMT, UNARY_EXPR, BINARY_EXPR})
+        CHECK_THROWS_AS(SerializedAst(patched(type, offsetof(FlatNode, token), token_of(TokenType::NATURAL_NUMBER))), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(LITERAL_EXPR, offsetof(FlatNode, token), token_of(TokenType::PLUS))), SerializedAstError);
+    CHECK_THROWS_AS(SerializedAst(patched(BINARY_EXPR, offsetof(FlatNode, token), token_of(TokenType::NOT))), SerializedAstError);
+    // A child with two parents
+    CHECK_THROWS_AS(SerializedAst(patched(BINARY_EXPR, child(1), ast.nodes()[first_binary].children[0])), SerializedAstError);
+    // An `else` dropped, which leaves its block outside the tree
+    CHECK_THROWS_AS(SerializedAst(patched(IF_EXPR, child(2), none)), SerializedAstError);
+
+    // Not at an 8-aligned address
+    std::vector<std::byte> shifted(bytes.size() + 1);
+    std::ranges::copy(bytes, shifted.begin() + 1);
+    CHECK_THROWS_AS(SerializedAst(std::span(shifted).subspan(1)), std::invalid_argument);
+
+    // Whatever byte is damaged, the file is rejected or read safely
+    for(std::size_t i = 0; i < bytes.size(); i++) {
+        for(auto bits : {0x01, 0x80, 0xff}) {
+            auto copy = bytes;
+            copy[i] ^= std::byte(bits);
+            try {
+                auto module = unflatten(SerializedAst(copy));
+                sexpr(*module);
+                compile(body(module));
+            } catch(const SerializedAstError&) {
+            } catch(const CompileException&) {
+            }
+        }
+    }
+}
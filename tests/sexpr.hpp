@@ -0,0 +1,82 @@
+#pragma once
+
+#include "mycomp/ast.hpp"
+#include "mycomp/ast_static_visitor.hpp"
+
+#include <fmt/core.h>
+#include <magic_enum.hpp>
+
+#include <cstdint>
+#include <string>
+#include <variant>
+
+namespace mycomp::test {
+
+// The tree as an s-expression, with tokens as their text
+struct SExpr : StaticAstVisitor<SExpr> {
+    std::string res;
+
+    void token(const Token& tok) {
+        if(auto* text = std::get_if<std::string>(&tok.payload))
+            res += *text;
+        else if(auto* natural = std::get_if<std::uint64_t>(&tok.payload))
+            res += std::to_string(*natural);
+        else if(auto* real = std::get_if<double>(&tok.payload))
+            res += fmt::format("{}", *real);
+        else
+            res += magic_enum::enum_name(tok.tokenType);
+    }
+
+    template<AstNodeType type>
+    void visit(const AstNodeBody<type>& body) {
+        res += res.empty() ? "(" : " (";
+        res += magic_enum::enum_name(type);
+        if constexpr (requires { body.op; }) {
+            res += " ";
+            token(body.op);
+        }
+        if constexpr (requires { body.name; }) {
+            res += " ";
+            token(body.name);
+        }
+        if constexpr (requires { body.var; }) {
+            res += " ";
+            token(body.var);
+        }
+        if constexpr (type == AstNodeType::LITERAL_EXPR || type == AstNodeType::PRIMITIVE_TYPE) {
+            res += " ";
+            token(body.body);
+        }
+        if constexpr (type == AstNodeType::IF_EXPR || type == AstNodeType::RETURN_EXPR || type == AstNodeType::COMPOUND_EXPR) {
+            // Missing children are shown, so that they are not confused with each other
+            auto child = [&](const ExprPtr& ptr) {
+                if(ptr)
+                    visitNode(ptr);
+                else
+                    res += " _";
+            };
+            if constexpr (type == AstNodeType::IF_EXPR) {
+                visitNode(body.cond);
+                visitNode(body.on_true);
+                child(body.on_false);
+            } else if constexpr (type == AstNodeType::RETURN_EXPR) {
+                child(body.result);
+            } else {
+                for(const auto& elem : body.preface)
+                    std::visit([this](const auto& ptr) { visitNode(ptr); }, elem);
+                child(body.last);
+            }
+        } else {
+            visitChildren(body);
+        }
+        res += ")";
+    }
+};
+
+inline std::string sexpr(const AstNode& node) {
+    SExpr printer;
+    printer.visitNode(node);
+    return printer.res;
+}
+
+}
@@ -0,0 +1,115 @@
+#include "mycomp/lex.hpp"
+#include "mycomp/utils/simd.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+using mycomp::SimdLevel;
+
+static std::vector<SimdLevel> supported_levels() {
+    std::vector<SimdLevel> res;
+    for(auto level : {SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2})
+        if(level <= mycomp::detect_simd_level())
+            res.push_back(level);
+    return res;
+}
+
+// Either the position we stopped at or the error we stopped with
+using SkipOutcome = std::variant<std::size_t, mycomp::LexException>;
+
+static SkipOutcome skip(std::string_view code, std::size_t pos, SimdLevel level) {
+    try {
+        return mycomp::skip_whitespace_and_comments(code, pos, level);
+    } catch(const mycomp::LexException& e) {
+        return e;
+    }
+}
+
+static bool same(const SkipOutcome& l, const SkipOutcome& r) {
+    if(l.index() != r.index())
+        return false;
+    if(auto* pos = std::get_if<std::size_t>(&l))
+        return *pos == std::get<std::size_t>(r);
+    auto& el = std::get<mycomp::LexException>(l);
+    auto& er = std::get<mycomp::LexException>(r);
+    return el.begin_pos == er.begin_pos && el.end_pos == er.end_pos && el.error == er.error;
+}
+
+// Long runs of a few characters, so that comments and whitespace cross vector boundaries
+static std::string random_code(std::mt19937& rng) {
+    static constexpr std::string_view pieces[] = {
+        " ", "\t", "\n", "\r\n", "\v\f", "\x08", "\x0e", "\x1f!", "/", "*", "//", "/*", "*/", "**", "a", "1", "+", "\"", "\x80"
+    };
+    std::uniform_int_distribution<std::size_t> piece(0, std::size(pieces) - 1);
+    std::uniform_int_distribution<std::size_t> repeat(1, 40);
+    std::uniform_int_distribution<std::size_t> length(0, 30);
+
+    std::string res;
+    for(auto n = length(rng); n > 0; n--) {
+        auto p = pieces[piece(rng)];
+        for(auto k = repeat(rng); k > 0; k--)
+            res += p;
+    }
+    return res;
+}
+
+TEST_CASE("Skip: SIMD paths agree with the scalar one", "[skip]") {
+    std::mt19937 rng(20230417);
+    auto levels = supported_levels();
+
+    for(int iter = 0; iter < 2000; iter++) {
+        auto code = random_code(rng);
+        for(std::size_t pos = 0; pos <= code.size(); pos += 1 + pos / 8) {
+            auto expected = skip(code, pos, SimdLevel::SCALAR);
+            for(auto level : levels) {
+                INFO("code: \"" << code << "\", pos: " << pos << ", level: " << static_cast<int>(level));
+                CHECK(same(skip(code, pos, level), expected));
+            }
+        }
+    }
+}
+
+TEST_CASE("Skip: lexers with different SIMD levels produce the same tokens", "[skip]") {
+    std::mt19937 rng(7);
+    auto levels = supported_levels();
+
+    auto lex_all = [](std::string_view code, SimdLevel level) -> std::variant<std::vector<mycomp::Token>, std::string> {
+        std::vector<mycomp::Token> res;
+        mycomp::Lexer lexer(code, level);
+        try {
+            while(auto tok = lexer.next())
+                res.push_back(*tok);
+        } catch(const mycomp::LexException& e) {
+            return e.error;
+        }
+        return res;
+    };
+
+    for(int iter = 0; iter < 500; iter++) {
+        auto code = random_code(rng);
+        auto expected = lex_all(code, SimdLevel::SCALAR);
+        for(auto level : levels) {
+            INFO("code: \"" << code << "\", level: " << static_cast<int>(level));
+            CHECK(lex_all(code, level) == expected);
+        }
+    }
+}
+
+TEST_CASE("Skip: corner cases", "[skip]") {
+    for(auto level : supported_levels()) {
+        CHECK(same(skip("", 0, level), std::size_t{0}));
+        CHECK(same(skip("   ", 0, level), std::size_t{3}));
+        CHECK(same(skip("/**/", 0, level), std::size_t{4}));
+        CHECK(same(skip(std::string(100, ' ') + "// x", 0, level), std::size_t{104}));
+        CHECK(std::holds_alternative<mycomp::LexException>(skip("/*/", 0, level)));
+        CHECK(std::holds_alternative<mycomp::LexException>(skip(std::string(64, ' ') + "*/", 0, level)));
+        CHECK(std::holds_alternative<mycomp::LexException>(skip("/*" + std::string(64, '*'), 0, level)));
+    }
+}
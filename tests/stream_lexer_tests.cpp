@@ -0,0 +1,118 @@
+#include "mycomp/lex.hpp"
+#include "mycomp/stream_lexer.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+struct Lexed {
+    std::vector<mycomp::Token> tokens;
+    std::optional<mycomp::LexException> error;
+};
+
+template<typename F>
+Lexed collect(F&& next) {
+    Lexed res;
+    try {
+        while(auto tok = next())
+            res.tokens.push_back(*tok);
+    } catch(mycomp::LexException& e) {
+        res.error = e;
+    }
+    return res;
+}
+
+}
+
+TEST_CASE("StreamLexer: same tokens as lex()", "[stream_lexer]") {
+    // Every piece crosses a chunk boundary with some of the chunk sizes
+    constexpr std::array<std::string_view, 16> pieces = {
+        " ", "\n", "identifier", "12345", "1.5e+3", "0x1F", "\"a string\"", "//", "/*", "*/",
+        "/* comment */", "// comment\n", "==", "!=", "=", "var",
+    };
+    std::mt19937 gen(12);
+
+    for(int iter = 0; iter < 2000; iter++) {
+        std::string code;
+        for(auto len = gen() % 40; len > 0; len--)
+            code += pieces[gen() % pieces.size()];
+
+        Lexed expected = collect([lexer = mycomp::Lexer(code)]() mutable { return lexer.next(); });
+        for(std::size_t chunk_size : {1, 2, 3, 7, 64}) {
+            std::istringstream in(code);
+            mycomp::StreamLexer lexer(in, chunk_size);
+            auto actual = collect([&] { return lexer.next(); });
+
+            INFO(code);
+            INFO(chunk_size);
+            REQUIRE(actual.tokens == expected.tokens);
+            REQUIRE(actual.error.has_value() == expected.error.has_value());
+            if(expected.error) {
+                CHECK(actual.error->begin_pos == expected.error->begin_pos);
+                CHECK(actual.error->end_pos == expected.error->end_pos);
+                CHECK(actual.error->error == expected.error->error);
+            }
+        }
+    }
+}
+
+TEST_CASE("StreamLexer: bounded memory", "[stream_lexer]") {
+    constexpr std::size_t chunk_size = 256;
+    constexpr std::string_view line = "var x = 12345 + y; /* a comment */ // and another one\n";
+    constexpr std::size_t repeat = 4096;
+
+    // Large input from a generator, with a comment much longer than a chunk in the middle
+    std::size_t produced = 0;
+    std::string comment = "/*" + std::string(100 * chunk_size, '*') + "*/\n";
+    std::size_t total = line.size() * repeat + comment.size();
+    auto input_at = [&](std::size_t pos) {
+        auto half = line.size() * repeat / 2;
+        if(pos < half)
+            return line[pos % line.size()];
+        if(pos < half + comment.size())
+            return comment[pos - half];
+        return line[(pos - half - comment.size()) % line.size()];
+    };
+    mycomp::StreamLexer lexer([&](std::span<char> buf) {
+        std::size_t res = 0;
+        for(; res < buf.size() && produced < total; res++, produced++)
+            buf[res] = input_at(produced);
+        return res;
+    }, chunk_size);
+
+    std::size_t tokens = 0;
+    std::size_t last_end = 0;
+    while(auto tok = lexer.next()) {
+        tokens++;
+        last_end = tok->end_pos;
+        CHECK(lexer.memoryUsage() <= 4 * chunk_size);
+    }
+    CHECK(tokens == 7 * repeat);
+    CHECK(last_end == total - line.size() + line.find(';') + 1);
+}
+
+TEST_CASE("StreamLexer: file descriptor", "[stream_lexer]") {
+    constexpr std::string_view code = "var x = \"from a pipe\"; /* comment */ x != 1.5";
+    std::array<int, 2> fds{};
+    REQUIRE(::pipe(fds.data()) == 0);
+    REQUIRE(::write(fds[1], code.data(), code.size()) == static_cast<ssize_t>(code.size()));
+    ::close(fds[1]);
+
+    mycomp::StreamLexer lexer(fds[0], 4);
+    auto actual = collect([&] { return lexer.next(); });
+    ::close(fds[0]);
+
+    CHECK(actual.tokens == mycomp::lex(code));
+    CHECK(!actual.error);
+}
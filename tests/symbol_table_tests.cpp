@@ -0,0 +1,78 @@
+#include "mycomp/symbol_table.hpp"
+#include "mycomp/utils/arena.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("SymbolTable: interning", "[symbols]") {
+    mycomp::SymbolTable symbols;
+
+    auto foo = symbols.intern("foo");
+    auto bar = symbols.intern("bar");
+    auto empty = symbols.intern("");
+
+    CHECK(foo != bar);
+    CHECK(symbols.intern(std::string("foo")) == foo);
+    CHECK(symbols.intern("") == empty);
+    CHECK(symbols.size() == 3);
+
+    CHECK(symbols.name(foo) == "foo");
+    CHECK(symbols.name(bar) == "bar");
+    CHECK(symbols.name(empty).empty());
+
+    CHECK(symbols.find("bar") == bar);
+    CHECK(!symbols.find("baz").has_value());
+}
+
+TEST_CASE("SymbolTable: ids and names are stable", "[symbols]") {
+    mycomp::SymbolTable symbols;
+    std::vector<mycomp::SymbolId> ids;
+    std::vector<std::string_view> names;
+
+    for(int i = 0; i < 10000; i++) {
+        auto name = "name_" + std::to_string(i) + std::string(static_cast<std::size_t>(i % 100), 'x');
+        ids.push_back(symbols.intern(name));
+        names.push_back(symbols.name(ids.back()));
+    }
+
+    CHECK(symbols.size() == 10000);
+    for(int i = 0; i < 10000; i++) {
+        auto ind = static_cast<std::size_t>(i);
+        auto name = "name_" + std::to_string(i) + std::string(ind % 100, 'x');
+        CHECK(static_cast<std::size_t>(ids[ind]) == ind);
+        CHECK(symbols.intern(name) == ids[ind]);
+        CHECK(symbols.name(ids[ind]).data() == names[ind].data());
+    }
+}
+
+// A SymbolTable keeps its names in an Arena, so it moves as well as the arena does
+TEST_CASE("Arena: moves", "[symbols]") {
+    mycomp::Arena arena(256);
+    auto* first = static_cast<std::uint64_t*>(arena.allocate(sizeof(std::uint64_t)));
+    *first = 42;
+
+    mycomp::Arena moved(std::move(arena));
+    CHECK(*first == 42);
+    CHECK(moved.memoryUsage() == 256);
+    // The source is empty, and allocates blocks of its own again
+    CHECK(arena.memoryUsage() == 0);
+    CHECK(arena.allocate(8) != nullptr);
+    CHECK(arena.memoryUsage() == 256);
+
+    // The rest of the moved block is still used, not a new one
+    CHECK(moved.allocate(8) != nullptr);
+    CHECK(moved.memoryUsage() == 256);
+
+    mycomp::Arena assigned;
+    assigned = std::move(moved);
+    CHECK(*first == 42);
+    CHECK(assigned.memoryUsage() == 256);
+    CHECK(moved.memoryUsage() == 0);
+    CHECK(moved.allocate(8) != nullptr);
+    CHECK(assigned.allocate(8) != nullptr);
+    CHECK(assigned.memoryUsage() == 256);
+}
@@ -0,0 +1,85 @@
+#include "mycomp/utils/task_scheduler.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mycomp;
+
+TEST_CASE("TaskScheduler: runs every index once", "[task_scheduler]") {
+    for(unsigned threads : {1u, 2u, 4u, 8u}) {
+        TaskScheduler scheduler(threads);
+        CHECK(scheduler.workerCount() == threads);
+        for(std::size_t count : {0, 1, 7, 1000}) {
+            std::vector<std::atomic<int>> runs(count);
+            std::atomic<bool> bad_worker = false;
+            scheduler.parallelFor(count, [&](std::size_t i, unsigned worker) {
+                runs[i]++;
+                if(worker >= threads)
+                    bad_worker = true;
+            });
+            for(const auto& r : runs)
+                CHECK(r == 1);
+            CHECK(!bad_worker);
+        }
+    }
+
+    // One thread is the caller, which goes in order
+    TaskScheduler single(1);
+    std::vector<std::size_t> order;
+    auto caller = std::this_thread::get_id();
+    single.parallelFor(5, [&](std::size_t i, unsigned worker) {
+        CHECK(std::this_thread::get_id() == caller);
+        CHECK(worker == 0);
+        order.push_back(i);
+    });
+    CHECK(order == std::vector<std::size_t>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE("TaskScheduler: nested tasks", "[task_scheduler]") {
+    TaskScheduler scheduler(4);
+    std::vector<std::vector<std::size_t>> sums(50, std::vector<std::size_t>(50));
+    scheduler.parallelFor(sums.size(), [&](std::size_t i, unsigned) {
+        scheduler.parallelFor(sums[i].size(), [&](std::size_t j, unsigned) {
+            std::vector<std::size_t> inner(j);
+            scheduler.parallelFor(j, [&](std::size_t k, unsigned) {
+                inner[k] = i + k;
+            });
+            sums[i][j] = std::accumulate(inner.begin(), inner.end(), std::size_t(0));
+        });
+    });
+    for(std::size_t i = 0; i < sums.size(); i++)
+        for(std::size_t j = 0; j < sums[i].size(); j++)
+            REQUIRE(sums[i][j] == i * j + j * (j - 1) / 2);
+}
+
+TEST_CASE("TaskScheduler: exceptions", "[task_scheduler]") {
+    for(unsigned threads : {1u, 3u, 8u}) {
+        TaskScheduler scheduler(threads);
+        // The lowest index that throws, whichever throws first
+        for(int repeat = 0; repeat < 20; repeat++) {
+            try {
+                scheduler.parallelFor(200, [](std::size_t i, unsigned) {
+                    if(i % 50 == 17)
+                        throw std::runtime_error(std::to_string(i));
+                });
+                FAIL("no exception");
+            } catch(const std::runtime_error& e) {
+                CHECK(std::string(e.what()) == "17");
+            }
+        }
+
+        // Still usable afterwards
+        std::atomic<std::size_t> sum = 0;
+        scheduler.parallelFor(100, [&](std::size_t i, unsigned) {
+            sum += i;
+        });
+        CHECK(sum == 4950);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <stdlib.h>
+
+namespace mycomp::test {
+
+// A new empty directory in the temporary directory, removed with its contents
+// at the end of the test. Its name is unique, so that concurrent test runs do
+// not use each other's files.
+struct TempDir {
+    std::filesystem::path path;
+
+    TempDir() {
+        auto name = (std::filesystem::temp_directory_path() / "mycomp_test_XXXXXX").string();
+        if(!::mkdtemp(name.data()))
+            throw std::system_error(errno, std::generic_category(), "mkdtemp " + name);
+        path = name;
+    }
+    ~TempDir() {
+        std::error_code ignored;
+        std::filesystem::remove_all(path, ignored);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+};
+
+// Creates or replaces the file
+inline void write_file(const std::filesystem::path& path, std::string_view contents) {
+    std::ofstream(path, std::ios::binary).write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
+inline void write_file(const std::filesystem::path& path, std::span<const std::byte> bytes) {
+    write_file(path, std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+}
+
+}
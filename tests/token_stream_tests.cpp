@@ -0,0 +1,84 @@
+#include "mycomp/lex.hpp"
+#include "mycomp/token_stream.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using enum mycomp::TokenType;
+
+TEST_CASE("TokenStream: same tokens as lex()", "[token_stream]") {
+    constexpr std::string_view code =
+        "var abc = 0x10 + 1.5e3; // comment\n"
+        "fn f(a_very_long_identifier_that_does_not_fit_into_sso, b) {\n"
+        "    return \"a string literal that is too long for small strings\" != abc\n"
+        "}";
+
+    auto expected = mycomp::lex(code);
+    auto stream = mycomp::lex_compact(code);
+
+    REQUIRE(stream.size() == expected.size());
+    for(std::size_t i = 0; i < stream.size(); i++)
+        CHECK(stream[i] == expected[i]);
+    CHECK(stream.toTokens() == expected);
+}
+
+TEST_CASE("TokenStream: payload accessors", "[token_stream]") {
+    auto stream = mycomp::lex_compact("x 42 2.5 \"s\" x");
+    auto tokens = stream.tokens();
+
+    REQUIRE(tokens.size() == 5);
+    CHECK(stream.text(tokens[0]) == "x");
+    CHECK(stream.natural(tokens[1]) == 42);
+    CHECK(stream.real(tokens[2]) == 2.5);
+    CHECK(stream.text(tokens[3]) == "s");
+    CHECK(tokens[4] == mycomp::CompactToken{13, 14, tokens[4].payload, IDENTIFIER});
+    CHECK(stream.symbol(tokens[4]) == stream.symbol(tokens[0]));
+}
+
+TEST_CASE("TokenStream: pushing tokens with their payloads", "[token_stream]") {
+    std::string_view code = "var x = \"s\" + 1;";
+    mycomp::TokenStream stream;
+    for(const auto& token : mycomp::lex(code))
+        stream.push_back(token);
+    CHECK(stream.toTokens() == mycomp::lex(code));
+    CHECK(stream.text(stream.tokens()[1]) == "x");
+    CHECK(stream.text(stream.tokens()[3]) == "s");
+
+    // Positions are kept in 32 bits, rather than cut off
+    mycomp::Token far{.tokenType = IDENTIFIER, .begin_pos = 1ull << 32, .end_pos = (1ull << 32) + 1, .payload = std::string("y")};
+    CHECK_THROWS_AS(stream.push_back(far), std::length_error);
+    far.begin_pos = 0;
+    CHECK_THROWS_AS(stream.push_back(far), std::length_error);
+    CHECK(stream.size() == mycomp::lex(code).size());
+}
+
+TEST_CASE("TokenStream: streams can share symbols", "[token_stream]") {
+    auto symbols = std::make_shared<mycomp::SymbolTable>();
+    auto first = mycomp::lex_compact("foo = bar", symbols);
+    auto second = mycomp::lex_compact("bar = \"foo\"", symbols);
+
+    CHECK(symbols->size() == 2);
+    CHECK(first.symbol(first.tokens()[0]) == second.symbol(second.tokens()[2]));
+    CHECK(first.symbol(first.tokens()[2]) == second.symbol(second.tokens()[0]));
+}
+
+TEST_CASE("TokenStream: uses less memory than a vector of tokens", "[token_stream]") {
+    std::string code;
+    for(int i = 0; i < 1000; i++)
+        code += "var some_variable_name = other_name + 12345 * (3.25 - \"text\");\n";
+
+    auto tokens = mycomp::lex(code);
+    auto stream = mycomp::lex_compact(code);
+
+    std::size_t vector_usage = tokens.capacity() * sizeof(mycomp::Token);
+    for(const auto& tok : tokens)
+        if(auto* str = std::get_if<std::string>(&tok.payload); str && str->capacity() > 15)
+            vector_usage += str->capacity() + 1;
+
+    CHECK(stream.memoryUsage() * 3 <= vector_usage);
+}
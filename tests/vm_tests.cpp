@@ -0,0 +1,185 @@
+#include "mycomp/ast.hpp"
+#include "mycomp/bytecode.hpp"
+#include "mycomp/parser.hpp"
+#include "mycomp/vm.hpp"
+
+#include "expr_generator.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_translate_exception.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace mycomp;
+using namespace mycomp::test;
+using enum AstNodeType;
+
+CATCH_TRANSLATE_EXCEPTION(const CompileException& e) {
+    return e.error;
+}
+
+CATCH_TRANSLATE_EXCEPTION(const RuntimeException& e) {
+    return e.error;
+}
+
+static Program compile_code(std::string_view code) {
+    auto module = parse(code);
+    return compile(static_cast<const AstNodeConcrete<MODULE>&>(*module).body_);
+}
+
+// The value of the variable after running the code
+static Value eval(std::string_view code, std::string_view variable) {
+    auto program = compile_code(code);
+    Vm vm;
+    vm.run(program);
+    return vm.variable(program, variable);
+}
+
+static bool uses(const Program& program, OpCode op) {
+    return std::ranges::any_of(program.code, [op](const Instruction& ins) { return ins.op == op; });
+}
+
+TEST_CASE("VM: arithmetic", "[vm]") {
+    CHECK(eval("var int x = 1 + 2 * 3 - 8 / 2;", "x") == Value(std::int64_t(3)));
+    CHECK(eval("var int x = -(7 - 10) / 2;", "x") == Value(std::int64_t(1)));
+    CHECK(eval("var int x = 0 - 7 / 2;", "x") == Value(std::int64_t(-3)));
+    CHECK(eval("var real x = 1.5 * 2.0 - 0.5 / 0.25;", "x") == Value(1.0));
+    CHECK(eval("var bool b = 1 < 2 == !(2.5 > 3.0);", "b") == Value(true));
+    CHECK(eval("var bool b = true != false == false;", "b") == Value(false));
+
+    // Integers wrap around instead of overflowing
+    constexpr auto min = std::numeric_limits<std::int64_t>::min();
+    CHECK(eval("var int x = 9223372036854775807 + 1;", "x") == Value(min));
+    CHECK(eval("var int m = -9223372036854775807 - 1; var int x = m / -1;", "x") == Value(min));
+}
+
+TEST_CASE("VM: variables, blocks and ifs", "[vm]") {
+    std::string_view code =
+        "var int x = 1;\n"
+        "var int y = { var int x = 10; x = x + 5; x * 2 };\n"
+        "var int z = { x = x + 1; x };\n"
+        "var int w = if x > 1 { var int t = 3; t * 3 } else { 0 };\n"
+        "var int v = if z < 0 { 1 } else if z == 2 { 2 } else { 3 };\n"
+        "var int u = { if w > 5 { x = 100; }; x };\n";
+    auto program = compile_code(code);
+    Vm vm;
+    CHECK(vm.run(program) == Value());
+    CHECK(vm.variable(program, "x") == Value(std::int64_t(100)));
+    CHECK(vm.variable(program, "y") == Value(std::int64_t(30)));
+    CHECK(vm.variable(program, "z") == Value(std::int64_t(2)));
+    CHECK(vm.variable(program, "w") == Value(std::int64_t(9)));
+    CHECK(vm.variable(program, "v") == Value(std::int64_t(2)));
+    CHECK(vm.variable(program, "u") == Value(std::int64_t(100)));
+    CHECK_THROWS_AS(vm.variable(program, "t"), std::out_of_range);
+
+    // Operands are evaluated from left to right, even if a variable is read in place
+    CHECK(eval("var int x = 1; var int y = x + { x = 10; x };", "y") == Value(std::int64_t(11)));
+    CHECK(eval("var int x = 1; var int y = { x = 10; x } + x;", "y") == Value(std::int64_t(20)));
+
+    // Running again starts from scratch
+    CHECK(vm.run(program) == Value());
+    CHECK(vm.variable(program, "x") == Value(std::int64_t(100)));
+}
+
+TEST_CASE("VM: return", "[vm]") {
+    auto program = compile_code(
+        "var int a = 1;\n"
+        "var int b = if a > 0 { return a + 41 } else { 2 };\n"
+        "var int c = { return 3 };\n"
+    );
+    CHECK(program.result_type == ValueType::INT);
+    Vm vm;
+    CHECK(vm.run(program) == Value(std::int64_t(42)));
+
+    CHECK(Vm().run(compile_code("var real x = { return 2.5 };")) == Value(2.5));
+    CHECK(Vm().run(compile_code("var int x = { return; 1 };")) == Value());
+}
+
+TEST_CASE("VM: type-specialized code", "[vm]") {
+    auto ints = compile_code("var int x = 7 + 7 * 7;");
+    CHECK(uses(ints, OpCode::ADD_INT));
+    CHECK(uses(ints, OpCode::MUL_INT));
+    CHECK(!uses(ints, OpCode::ADD_REAL));
+    CHECK(ints.constants.size() == 1);
+
+    auto reals = compile_code("var real x = 7.0 + 7.0; var bool b = x < 1.0;");
+    CHECK(uses(reals, OpCode::ADD_REAL));
+    CHECK(uses(reals, OpCode::LT_REAL));
+    CHECK(!uses(reals, OpCode::ADD_INT));
+
+    // Variables are read where they are, without moving them to temporaries
+    auto vars = compile_code("var int x = 1; var int y = x * x + x;");
+    CHECK(!uses(vars, OpCode::MOVE));
+    CHECK(vars.register_count == 3);
+}
+
+TEST_CASE("VM: errors", "[vm]") {
+    auto compile_error = [](std::string_view code) {
+        try {
+            compile_code(code);
+        } catch(CompileException& e) {
+            return std::pair{e.begin_pos, e.end_pos};
+        }
+        FAIL("No CompileException");
+        return std::pair<std::size_t, std::size_t>{};
+    };
+
+    CHECK(compile_error("var int x = 1 + 2.0;") == std::pair<std::size_t, std::size_t>{12, 19});
+    CHECK(compile_error("var int x = y;") == std::pair<std::size_t, std::size_t>{12, 13});
+    CHECK(compile_error("var int x = 1.0;") == std::pair<std::size_t, std::size_t>{12, 15});
+    CHECK(compile_error("var str x = 1;") == std::pair<std::size_t, std::size_t>{4, 7});
+    CHECK(compile_error("var int x = if 1 { 1 } else { 2 };") == std::pair<std::size_t, std::size_t>{15, 16});
+    CHECK(compile_error("var int x = if true { 1 } else { 2.0 };") == std::pair<std::size_t, std::size_t>{15, 36});
+    CHECK(compile_error("var int x = { var int y = 1; y = true; y };") == std::pair<std::size_t, std::size_t>{33, 37});
+    CHECK(compile_error("var int x = { return 1 }; var int y = { return 1.0 };") == std::pair<std::size_t, std::size_t>{47, 50});
+    CHECK(compile_error("var int x = -true;") == std::pair<std::size_t, std::size_t>{12, 17});
+    CHECK(compile_error("var int x = \"text\";") == std::pair<std::size_t, std::size_t>{12, 18});
+    CHECK(compile_error("var int x = 9223372036854775808;") == std::pair<std::size_t, std::size_t>{12, 31});
+
+    auto program = compile_code("var int zero = 0;\nvar int x = 1 / zero;");
+    try {
+        Vm().run(program);
+        FAIL("No RuntimeException");
+    } catch(RuntimeException& e) {
+        CHECK(e.begin_pos == 32);
+        CHECK(e.end_pos == 33);
+        CHECK(e.error == "Division by zero");
+    }
+}
+
+TEST_CASE("VM: arguments", "[vm]") {
+    AstArena arena;
+    std::vector<Parameter> params{{"a", ValueType::INT}, {"b", ValueType::INT}};
+    auto program = compile_expression(*parse_expr("a - b", arena), params);
+    CHECK(program.parameter_count == 2);
+    Vm vm;
+    CHECK(vm.run(program, std::vector<Slot>{{.integer = 5}, {.integer = 3}}) == Value(std::int64_t(2)));
+    CHECK_THROWS_AS(vm.run(program, std::vector<Slot>{{.integer = 5}}), std::invalid_argument);
+    CHECK_THROWS_AS(vm.run(program), std::invalid_argument);
+    CHECK_THROWS_AS(vm.run(compile_code("var int x = 1;"), std::vector<Slot>{{.integer = 1}}), std::invalid_argument);
+}
+
+TEST_CASE("VM: random expressions", "[vm]") {
+    ExprGenerator gen(19, {{"v0", std::int64_t(1)}});
+    std::string code = "var int v0 = 1;\n";
+    for(int i = 1; i < 300; i++) {
+        auto [text, value] = gen.expr(ValueType::INT, 4);
+        code += fmt::format("var int v{} = {};\n", i, text);
+        gen.vars.push_back({fmt::format("v{}", i), value});
+    }
+
+    auto program = compile_code(code);
+    Vm vm;
+    vm.run(program);
+    for(const auto& var : gen.vars)
+        REQUIRE(vm.variable(program, var.name) == var.value);
+}